@@ -1,43 +1,82 @@
 #include <linux/cdev.h>
 #include <linux/device.h>
 #include <linux/fs.h>
-#include <linux/gpio.h>
+#include <linux/i2c.h>
 #include <linux/kernel.h>
+#include <linux/kfifo.h>
+#include <linux/list.h>
 #include <linux/module.h>
 #include <linux/types.h>
 #include <linux/uaccess.h>
 #include <linux/delay.h>
 #include <linux/slab.h>
 #include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/poll.h>
+#include <linux/rwsem.h>
+#include <linux/seqlock.h>
+#include <linux/spinlock.h>
+#include <linux/timekeeping.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 
-#define BME280_ADDR        0xEC
+#include "bme280.h"
+
+#define DRIVER_NAME        "bme280"
 #define BME280_CHIP_ID_REG 0xD0
 #define BME280_CTRL_HUM    0xF2
+#define BME280_STATUS      0xF3
+#define BME280_STATUS_MEASURING 0x08
 #define BME280_CTRL_MEAS   0xF4
 #define BME280_CONFIG      0xF5
 #define BME280_PRESS_MSB   0xF7
-#define SCL_GPIO           36
-#define SDA_GPIO           61
-
-/* 校准参数结构体 */
-struct bme280_calib {
-    u16 dig_T1;
-    s16 dig_T2, dig_T3;
-    u16 dig_P1;
-    s16 dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
-    u8  dig_H1;
-    s16 dig_H2;
-    u8  dig_H3;
-    s16 dig_H4, dig_H5;
-    u8  dig_H6;
-    s32 t_fine;
-};
+
+/* 后台采样周期，与传感器默认的1000ms待机时间一致 */
+static unsigned int odr_ms = 1000;
+module_param(odr_ms, uint, 0444);
+MODULE_PARM_DESC(odr_ms, "后台采样周期(ms)");
 
 /* 设备数据结构 */
 struct bme280_dev {
-    struct mutex lock;
-    struct bme280_calib calib;
-    bool calib_valid; 
+    struct bme280_calib_data calib;
+    bool calib_valid;
+    struct i2c_client *client;  /* 总线互斥由I2C适配器完成 */
+    /*
+     * 解绑后已打开的文件还在，状态是静态的不会被释放，但总线已经不可用：
+     * ioctl持读锁，remove持写锁置removed，之后的文件操作返回ENODEV
+     */
+    struct rw_semaphore remove_sem;
+    bool removed;
+
+    /* 测量参数，cfg_lock同时串行化forced模式的触发与读取 */
+    struct mutex cfg_lock;
+    struct bme280_config cfg;
+    u32 profile;
+
+    /* 后台采样：每个周期只做一次总线读取和补偿，结果发布为快照 */
+    struct delayed_work sample_work;
+    unsigned int odr_ms;
+    seqlock_t snap_lock;
+    struct bme280_data snap;    /* snap.seq为0表示还没有样本 */
+    wait_queue_head_t wq;
+    struct mutex open_lock;     /* 保护users，与采样线程的启停配对 */
+    int users;
+
+    /* 批量模式的文件，采样线程向每个文件的kfifo投递记录 */
+    spinlock_t batch_lock;
+    struct list_head batch_files;
+};
+
+/* 每个打开的文件记录自己读到的最后一个序号 */
+struct bme280_file {
+    u32 last_seq;
+    u32 mode;
+    u32 watermark;
+    bool overflow;              /* 有记录被丢弃，下一条记录带上标志 */
+    bool raw;                   /* 原始输出：本文件的批量记录只带ADC原始值 */
+    struct mutex read_lock;     /* kfifo的唯一消费者，同时保护模式切换 */
+    DECLARE_KFIFO_PTR(fifo, struct bme280_record);
+    struct list_head node;
 };
 
 static int major;
@@ -47,137 +86,61 @@ static struct device *i2c_device;
 static struct cdev i2c_cdev;
 static struct bme280_dev dev;
 
-/* GPIO操作 */
-#define SDA_HIGH()  gpio_set_value(SDA_GPIO, 1)
-#define SDA_LOW()   gpio_set_value(SDA_GPIO, 0)
-#define SCL_HIGH()  gpio_set_value(SCL_GPIO, 1)
-#define SCL_LOW()   gpio_set_value(SCL_GPIO, 0)
-#define SDA_READ()  gpio_get_value(SDA_GPIO)
+/* 内核内的订阅者(如sgp30湿度补偿)，每个新样本通知一次，见 bme280.h */
+static BLOCKING_NOTIFIER_HEAD(bme280_notifier);
 
+/* 多字节读写，硬件控制器和soft_i2c(i2c-algo-bit)模拟总线都走这里 */
+static int bme280_write_reg(u8 reg, u8 value) {
+    struct i2c_client *client = dev.client;
+    u8 buf[2] = {reg, value};
+    struct i2c_msg msg = {
+        .addr = client->addr,
+        .flags = 0,
+        .len = 2,
+        .buf = buf
+    };
+    int ret;
 
-static void i2c_delay(void) {
-    udelay(5);
-}
-static void i2c_stop(void) {
-    SDA_LOW();
-    SCL_HIGH();
-    i2c_delay();
-    SDA_HIGH();
-    i2c_delay();
-}
-/* 总线恢复函数 */
-static void i2c_recover(void) {
-    int i;
-    gpio_direction_output(SCL_GPIO, 1);
-    for (i = 0; i < 9; i++) {
-        SCL_HIGH();
-        i2c_delay();
-        SCL_LOW();
-        i2c_delay();
-    }
-    i2c_stop();
-}
+    if (i2c_check_functionality(client->adapter, I2C_FUNC_I2C))
+        ret = i2c_transfer(client->adapter, &msg, 1) == 1 ? 0 : -EIO;
+    else
+        ret = i2c_smbus_write_byte_data(client, reg, value);
 
-static void i2c_start(void) {
-    SDA_HIGH();
-    SCL_HIGH();
-    i2c_delay();
-    SDA_LOW();
-    i2c_delay();
-    SCL_LOW();
+    if (ret)
+        dev_err(&client->dev, "写寄存器失败 0x%02X: %d\n", reg, ret);
+    return ret;
 }
 
-static u8 i2c_write_byte(u8 data) {
-    int i;
-    u8 ack;
-    for (i = 7; i >= 0; i--) {
-        SCL_LOW();
-        (data & (1 << i)) ? SDA_HIGH() : SDA_LOW();
-        i2c_delay();
-        SCL_HIGH();
-        i2c_delay();
-    }
-    SCL_LOW();
-    SDA_HIGH(); 
-    i2c_delay();
-    SCL_HIGH();
-    i2c_delay();
-    ack = SDA_READ();
-    SCL_LOW();
-    return ack;
-}
+static int bme280_read_regs(u8 reg, u8 *buf, int len) {
+    struct i2c_client *client = dev.client;
+    struct i2c_msg msg[2] = {
+        {
+            .addr = client->addr,
+            .flags = 0,
+            .len = 1,
+            .buf = &reg
+        },
+        {
+            .addr = client->addr,
+            .flags = I2C_M_RD,
+            .len = len,
+            .buf = buf
+        }
+    };
+    int ret;
 
-static u8 i2c_read_byte(u8 ack) {
-    int i;
-    u8 data = 0;
-    SDA_HIGH(); 
-    gpio_direction_input(SDA_GPIO);
-    for (i = 7; i >= 0; i--) {
-        SCL_LOW();
-        i2c_delay();
-        SCL_HIGH();
-        data |= (SDA_READ() << i);
-        i2c_delay();
+    /* 一次带重复起始位的组合传输；只支持SMBus的适配器(如i2c-stub)走块读 */
+    if (i2c_check_functionality(client->adapter, I2C_FUNC_I2C)) {
+        ret = i2c_transfer(client->adapter, msg, 2);
+        ret = ret == 2 ? len : (ret < 0 ? ret : -EIO);
+    } else {
+        ret = i2c_smbus_read_i2c_block_data(client, reg, len, buf);
+        if (ret >= 0 && ret != len)
+            ret = -EIO;
     }
-    SCL_LOW();
-    gpio_direction_output(SDA_GPIO, 1);
-    ack ? SDA_LOW() : SDA_HIGH();
-    i2c_delay();
-    SCL_HIGH();
-    i2c_delay();
-    SCL_LOW();
-    SDA_HIGH();
-    return data;
-}
-
-/* 多字节读写 */
-static int i2c_write_reg(u8 reg, u8 value) {
-    int ret = -EIO;
-    mutex_lock(&dev.lock);
-    
-    i2c_start();
-    if (i2c_write_byte(BME280_ADDR & 0xFE)) 
-        goto exit;
-    if (i2c_write_byte(reg)) 
-        goto exit;
-    if (i2c_write_byte(value)) 
-        goto exit;
-    ret = 0;
-
-exit:
-    i2c_stop();
-    if (ret) {
-        printk(KERN_ERR "BME280写寄存器失败 0x%02X\n", reg);
-        i2c_recover();
-    }
-    mutex_unlock(&dev.lock);
-    return ret;
-}
 
-static int i2c_read_regs(u8 reg, u8 *buf, int len) {
-    int i, ret = -EIO;
-    mutex_lock(&dev.lock);
-    
-    i2c_start();
-    if (i2c_write_byte(BME280_ADDR & 0xFE))
-        goto exit;
-    if (i2c_write_byte(reg)) 
-        goto exit;
-    i2c_start();
-    if (i2c_write_byte(BME280_ADDR | 0x01)) 
-        goto exit;
-    
-    for (i = 0; i < len; i++)
-        buf[i] = i2c_read_byte(i == len-1 ? 0 : 1);
-    ret = len;
-
-exit:
-    i2c_stop();
-    if (ret < 0) {
-        printk(KERN_ERR "BME280读寄存器失败 0x%02X\n", reg);
-        i2c_recover();
-    }
-    mutex_unlock(&dev.lock);
+    if (ret < 0)
+        dev_err(&client->dev, "读寄存器失败 0x%02X: %d\n", reg, ret);
     return ret;
 }
 
@@ -185,21 +148,21 @@ exit:
 static int bme280_read_calib(void) {
     u8 data[33] = {0};
     int ret;
-    
+
     dev.calib_valid = false;
-    
+
     // 读取温度压力校准参数
-    ret = i2c_read_regs(0x88, data, 24);
+    ret = bme280_read_regs(0x88, data, 24);
     if (ret != 24)
         return -EIO;
-    
+
     // 读取H1
-    ret = i2c_read_regs(0xA1, &data[24], 1);
+    ret = bme280_read_regs(0xA1, &data[24], 1);
     if (ret != 1)
         return -EIO;
-    
+
     // 读取H2-H6
-    ret = i2c_read_regs(0xE1, &data[25], 7);
+    ret = bme280_read_regs(0xE1, &data[25], 7);
     if (ret != 7)
         return -EIO;
 
@@ -207,7 +170,7 @@ static int bme280_read_calib(void) {
     dev.calib.dig_T1 = (data[1] << 8) | data[0];
     dev.calib.dig_T2 = (s16)((data[3] << 8) | data[2]);
     dev.calib.dig_T3 = (s16)((data[5] << 8) | data[4]);
-    
+
     dev.calib.dig_P1 = (data[7] << 8) | data[6];
     dev.calib.dig_P2 = (s16)((data[9] << 8) | data[8]);
     dev.calib.dig_P3 = (s16)((data[11] << 8) | data[10]);
@@ -217,46 +180,52 @@ static int bme280_read_calib(void) {
     dev.calib.dig_P7 = (s16)((data[19] << 8) | data[18]);
     dev.calib.dig_P8 = (s16)((data[21] << 8) | data[20]);
     dev.calib.dig_P9 = (s16)((data[23] << 8) | data[22]);
-    
+
     dev.calib.dig_H1 = data[24];
     dev.calib.dig_H2 = (s16)((data[26] << 8) | data[25]);
     dev.calib.dig_H3 = data[27];
-    dev.calib.dig_H4 = (s16)((data[28] << 4) | (data[29] & 0x0F));
-    dev.calib.dig_H5 = (s16)((data[30] << 4) | ((data[29] >> 4) & 0x0F));
+    /* H4/H5的高8位(0xE4/0xE6)是有符号数 */
+    dev.calib.dig_H4 = (s16)(((s8)data[28] * 16) | (data[29] & 0x0F));
+    dev.calib.dig_H5 = (s16)(((s8)data[30] * 16) | ((data[29] >> 4) & 0x0F));
     dev.calib.dig_H6 = (s8)data[31];
-    
+
     dev.calib_valid = true;
     return 0;
 }
 
-/* 数据补偿算法 */
-static s32 compensate_temp(s32 adc_T) {
-    if (!dev.calib_valid) return 0;
-    
+/* 数据补偿算法
+ * t_fine由调用者保存并传给气压/湿度补偿，校准参数初始化后只读，
+ * 因此补偿过程不需要加锁。
+ */
+static s32 compensate_temp(s32 adc_T, s32 *t_fine) {
     s32 var1, var2;
-    var1 = (((adc_T >> 3) - ((s32)dev.calib.dig_T1 << 1)) * 
+
+    if (!dev.calib_valid) return 0;
+
+    var1 = (((adc_T >> 3) - ((s32)dev.calib.dig_T1 << 1)) *
            (s32)dev.calib.dig_T2) >> 11;
-    var2 = (((((adc_T >> 4) - (s32)dev.calib.dig_T1) * 
-            ((adc_T >> 4) - (s32)dev.calib.dig_T1)) >> 12) * 
+    var2 = (((((adc_T >> 4) - (s32)dev.calib.dig_T1) *
+            ((adc_T >> 4) - (s32)dev.calib.dig_T1)) >> 12) *
             (s32)dev.calib.dig_T3) >> 14;
-    dev.calib.t_fine = var1 + var2;
-    return (dev.calib.t_fine * 5 + 128) >> 8;
+    *t_fine = var1 + var2;
+    return (*t_fine * 5 + 128) >> 8;
 }
 
-static u32 compensate_press(s32 adc_P) {
-    if (!dev.calib_valid) return 0;
-    
+static u32 compensate_press(s32 adc_P, s32 t_fine) {
     s64 var1, var2, p;
-    var1 = (s64)dev.calib.t_fine - 128000;
+
+    if (!dev.calib_valid) return 0;
+
+    var1 = (s64)t_fine - 128000;
     var2 = var1 * var1 * (s64)dev.calib.dig_P6;
     var2 += ((var1 * (s64)dev.calib.dig_P5) << 17);
     var2 += ((s64)dev.calib.dig_P4 << 35);
-    var1 = ((var1 * var1 * (s64)dev.calib.dig_P3) >> 8) + 
+    var1 = ((var1 * var1 * (s64)dev.calib.dig_P3) >> 8) +
            ((var1 * (s64)dev.calib.dig_P2) << 12);
     var1 = ((((s64)1 << 47) + var1) * (s64)dev.calib.dig_P1) >> 33;
-    
+
     if (var1 == 0) return 0;
-    
+
     p = 1048576 - adc_P;
     p = (((p << 31) - var2) * 3125) / var1;
     var1 = ((s64)dev.calib.dig_P9 * (p >> 13) * (p >> 13)) >> 25;
@@ -264,16 +233,18 @@ static u32 compensate_press(s32 adc_P) {
     return (u32)((p + var1 + var2) >> 8) + ((s64)dev.calib.dig_P7 << 4);
 }
 
-static u32 compensate_hum(s32 adc_H) {
+static u32 compensate_hum(s32 adc_H, s32 t_fine) {
+    s32 var;
+
     if (!dev.calib_valid) return 0;
-    
-    s32 var = dev.calib.t_fine - 76800;
-    var = ((((adc_H << 14) - ((s32)dev.calib.dig_H4 << 20) - 
-          (dev.calib.dig_H5 * var)) + 16384) >> 15) * 
-          (((((((var * dev.calib.dig_H6) >> 10) * 
-          ((var * dev.calib.dig_H3) >> 11 + 32768)) >> 10) + 2097152) * 
+
+    var = t_fine - 76800;
+    var = ((((adc_H << 14) - ((s32)dev.calib.dig_H4 << 20) -
+          (dev.calib.dig_H5 * var)) + 16384) >> 15) *
+          (((((((var * dev.calib.dig_H6) >> 10) *
+          (((var * dev.calib.dig_H3) >> 11) + 32768)) >> 10) + 2097152) *
           dev.calib.dig_H2 + 8192) >> 14);
-    
+
     var -= (((var >> 15) * (var >> 15)) >> 7) * dev.calib.dig_H1 >> 4;
     var = var < 0 ? 0 : (var > 419430400 ? 419430400 : var);
     return var >> 12;
@@ -282,120 +253,622 @@ static u32 compensate_hum(s32 adc_H) {
 /* 数据读取 */
 static int bme280_read_raw(s32 *temp, s32 *press, s32 *hum) {
     u8 data[8];
-    int ret = i2c_read_regs(BME280_PRESS_MSB, data, 8);
+    int ret = bme280_read_regs(BME280_PRESS_MSB, data, 8);
     if (ret != 8)
         return -EIO;
-    
+
     *press = (data[0] << 12) | (data[1] << 4) | (data[2] >> 4);
     *temp = (data[3] << 12) | (data[4] << 4) | (data[5] >> 4);
     *hum = (data[6] << 8) | data[7];
     return 0;
 }
 
-struct bme280_data {
-    s32 temp;    // ℃ 
-    u32 press;   // Pa
-    u32 hum;     // % 
-    
+struct bme280_profile_desc {
+    const char *name;
+    struct bme280_config cfg;
+    u32 odr_ms;
+};
+
+static const struct bme280_profile_desc bme280_profiles[BME280_PROFILE_NR] = {
+    [BME280_PROFILE_DEFAULT] = {
+        "default",     { 5, 5, 5, 0, 5, BME280_MODE_NORMAL }, 1000 },
+    [BME280_PROFILE_LOW_LATENCY] = {
+        "low-latency", { 1, 1, 1, 0, 0, BME280_MODE_NORMAL }, 10 },
+    [BME280_PROFILE_WEATHER] = {
+        "weather",     { 1, 1, 1, 0, 0, BME280_MODE_FORCED }, 60000 },
+    [BME280_PROFILE_INDOOR_NAV] = {
+        "indoor-navigation", { 2, 5, 1, 4, 0, BME280_MODE_NORMAL }, 40 },
 };
 
+static int bme280_set_odr(u32 ms) {
+    if (ms < BME280_ODR_MIN_MS || ms > BME280_ODR_MAX_MS)
+        return -EINVAL;
+    WRITE_ONCE(dev.odr_ms, ms);
+
+    /*
+     * 采样线程在运行时按新周期重新排期，避免从慢档切换过来要等一整个旧周期。
+     * 解绑后还有文件或订阅者时users不为0，client为NULL时不能再排期
+     */
+    mutex_lock(&dev.open_lock);
+    if (dev.users && dev.client)
+        mod_delayed_work(system_wq, &dev.sample_work, msecs_to_jiffies(ms));
+    mutex_unlock(&dev.open_lock);
+    return 0;
+}
+
+static bool bme280_config_valid(const struct bme280_config *cfg) {
+    return cfg->osrs_t >= 1 && cfg->osrs_t <= 5 &&
+           cfg->osrs_p <= 5 && cfg->osrs_h <= 5 &&
+           cfg->filter <= 4 && cfg->t_sb <= 7 &&
+           (cfg->mode == BME280_MODE_FORCED || cfg->mode == BME280_MODE_NORMAL);
+}
+
+/* 过采样编码对应的采样次数 */
+static unsigned int bme280_osrs_count(u8 osrs) {
+    return osrs ? 1U << (osrs - 1) : 0;
+}
+
+/* 数据手册附录B：最大测量时间(us) */
+static unsigned int bme280_meas_time_us(const struct bme280_config *cfg) {
+    unsigned int t = 1250 + 2300 * bme280_osrs_count(cfg->osrs_t);
+
+    if (cfg->osrs_p)
+        t += 2300 * bme280_osrs_count(cfg->osrs_p) + 575;
+    if (cfg->osrs_h)
+        t += 2300 * bme280_osrs_count(cfg->osrs_h) + 575;
+    return t;
+}
+
+static u8 bme280_ctrl_meas(const struct bme280_config *cfg, u8 mode) {
+    return (cfg->osrs_t << 5) | (cfg->osrs_p << 2) | mode;
+}
+
+/*
+ * 写入测量参数。config只在sleep模式下保证生效，ctrl_hum要在ctrl_meas之后
+ * 才生效，因此先进入sleep，最后写ctrl_meas。forced模式下停在sleep，
+ * 由每次采样单独触发。调用者持有cfg_lock。
+ */
+static int bme280_apply_config(const struct bme280_config *cfg) {
+    u8 mode = cfg->mode == BME280_MODE_NORMAL ? BME280_MODE_NORMAL :
+                                                BME280_MODE_SLEEP;
+
+    if (bme280_write_reg(BME280_CTRL_MEAS, BME280_MODE_SLEEP) ||
+        bme280_write_reg(BME280_CONFIG, (cfg->t_sb << 5) | (cfg->filter << 2)) ||
+        bme280_write_reg(BME280_CTRL_HUM, cfg->osrs_h) ||
+        bme280_write_reg(BME280_CTRL_MEAS, bme280_ctrl_meas(cfg, mode)))
+        return -EIO;
+
+    dev.cfg = *cfg;
+    return 0;
+}
+
+static int bme280_set_config(const struct bme280_config *cfg, u32 profile) {
+    int ret;
+
+    if (!bme280_config_valid(cfg))
+        return -EINVAL;
+
+    mutex_lock(&dev.cfg_lock);
+    ret = bme280_apply_config(cfg);
+    if (!ret)
+        dev.profile = profile;
+    mutex_unlock(&dev.cfg_lock);
+    return ret;
+}
+
+static int bme280_set_profile(u32 profile) {
+    int ret;
+
+    if (profile >= BME280_PROFILE_NR)
+        return -EINVAL;
+
+    ret = bme280_set_config(&bme280_profiles[profile].cfg, profile);
+    if (!ret)
+        bme280_set_odr(bme280_profiles[profile].odr_ms);
+    return ret;
+}
+
+/* forced模式：触发一次转换，等待状态寄存器的measuring位清零 */
+static int bme280_trigger_forced(void) {
+    unsigned int t_us = bme280_meas_time_us(&dev.cfg);
+    int tries;
+    u8 status;
+
+    if (bme280_write_reg(BME280_CTRL_MEAS,
+                         bme280_ctrl_meas(&dev.cfg, BME280_MODE_FORCED)))
+        return -EIO;
+
+    usleep_range(t_us, t_us + t_us / 4);
+    for (tries = 0; tries < 10; tries++) {
+        if (bme280_read_regs(BME280_STATUS, &status, 1) != 1)
+            return -EIO;
+        if (!(status & BME280_STATUS_MEASURING))
+            return 0;
+        usleep_range(500, 1000);
+    }
+    return -ETIMEDOUT;
+}
+
+/* 完成一次总线读取并补偿，记录读取完成的时间 */
+static int bme280_measure(struct bme280_record *rec) {
+    s32 t_fine = 0;
+    int ret = 0;
+
+    mutex_lock(&dev.cfg_lock);
+    if (dev.cfg.mode == BME280_MODE_FORCED)
+        ret = bme280_trigger_forced();
+    if (!ret)
+        ret = bme280_read_raw(&rec->raw_temp, &rec->raw_press, &rec->raw_hum);
+    mutex_unlock(&dev.cfg_lock);
+    if (ret < 0)
+        return ret;
+
+    rec->timestamp_ns = ktime_get_boottime_ns();
+    rec->flags = 0;
+    rec->temp = compensate_temp(rec->raw_temp, &t_fine);
+    rec->press = compensate_press(rec->raw_press, t_fine);
+    rec->hum = compensate_hum(rec->raw_hum, t_fine);
+    return 0;
+}
+
+static void bme280_record_to_data(const struct bme280_record *rec,
+                                  struct bme280_data *data) {
+    data->temp = rec->temp;
+    data->press = rec->press;
+    data->hum = rec->hum;
+    data->seq = rec->seq;
+}
+
+static u32 bme280_snap_seq(void) {
+    return READ_ONCE(dev.snap.seq);
+}
+
+static void bme280_snap_get(struct bme280_data *data) {
+    unsigned int seq;
+
+    do {
+        seq = read_seqbegin(&dev.snap_lock);
+        *data = dev.snap;
+    } while (read_seqretry(&dev.snap_lock, seq));
+}
+
+/*
+ * 向批量模式的文件投递记录；缓冲区满时丢弃新记录，不去动消费者一侧。
+ * 开了原始输出的文件只拿到ADC原始值，快照和其他文件不受影响
+ */
+static void bme280_batch_push(struct bme280_record *rec) {
+    struct bme280_file *f;
+    struct bme280_record r;
+
+    spin_lock(&dev.batch_lock);
+    list_for_each_entry(f, &dev.batch_files, node) {
+        if (kfifo_is_full(&f->fifo)) {
+            f->overflow = true;
+            continue;
+        }
+        r = *rec;
+        if (READ_ONCE(f->raw)) {
+            r.flags |= BME280_REC_RAW;
+            r.temp = 0;
+            r.press = 0;
+            r.hum = 0;
+        }
+        if (f->overflow)
+            r.flags |= BME280_REC_OVERFLOW;
+        f->overflow = false;
+        kfifo_put(&f->fifo, r);
+    }
+    spin_unlock(&dev.batch_lock);
+}
+
+/* 通知内核订阅者 */
+static void bme280_notify(struct bme280_data *data) {
+    blocking_notifier_call_chain(&bme280_notifier, BME280_EVENT_SAMPLE, data);
+}
+
+/* 后台采样线程 */
+static void bme280_sample_work(struct work_struct *work) {
+    struct bme280_record rec;
+    struct bme280_data data;
+
+    if (bme280_measure(&rec) == 0) {
+        write_seqlock(&dev.snap_lock);
+        rec.seq = dev.snap.seq + 1;
+        if (rec.seq == 0)       /* 跳过0，0保留为"无样本" */
+            rec.seq = 1;
+        bme280_record_to_data(&rec, &data);
+        dev.snap = data;
+        write_sequnlock(&dev.snap_lock);
+        bme280_batch_push(&rec);
+        wake_up_interruptible(&dev.wq);
+        bme280_notify(&data);
+    }
+
+    schedule_delayed_work(&dev.sample_work,
+                          msecs_to_jiffies(READ_ONCE(dev.odr_ms)));
+}
+
 static int i2c_open(struct inode *inode, struct file *filp) {
+    struct bme280_file *f;
+
+    f = kzalloc(sizeof(*f), GFP_KERNEL);
+    if (!f)
+        return -ENOMEM;
+    f->mode = BME280_READ_SNAPSHOT;
+    f->watermark = 1;
+    mutex_init(&f->read_lock);
+    INIT_LIST_HEAD(&f->node);
+    filp->private_data = f;
+
+    /* 第一个读者打开时启动采样，最后一个关闭时停止 */
+    mutex_lock(&dev.open_lock);
+    if (dev.users++ == 0 && dev.client)
+        mod_delayed_work(system_wq, &dev.sample_work, 0);
+    mutex_unlock(&dev.open_lock);
     return 0;
 }
 
+/*
+ * 内核订阅者与打开的文件一样算一个用户，保证没有应用打开设备时也在采样。
+ * 订阅时传感器可能还没probe，此时只计数，probe成功后再启动采样。
+ */
+int bme280_register_notifier(struct notifier_block *nb) {
+    int ret = blocking_notifier_chain_register(&bme280_notifier, nb);
+
+    if (ret)
+        return ret;
+    mutex_lock(&dev.open_lock);
+    if (dev.users++ == 0 && dev.client)
+        mod_delayed_work(system_wq, &dev.sample_work, 0);
+    mutex_unlock(&dev.open_lock);
+    return 0;
+}
+EXPORT_SYMBOL_GPL(bme280_register_notifier);
+
+int bme280_unregister_notifier(struct notifier_block *nb) {
+    int ret = blocking_notifier_chain_unregister(&bme280_notifier, nb);
+
+    if (ret)
+        return ret;
+    mutex_lock(&dev.open_lock);
+    if (--dev.users == 0)
+        cancel_delayed_work_sync(&dev.sample_work);
+    mutex_unlock(&dev.open_lock);
+    return 0;
+}
+EXPORT_SYMBOL_GPL(bme280_unregister_notifier);
+
 static int i2c_release(struct inode *inode, struct file *filp) {
+    struct bme280_file *f = filp->private_data;
+
+    mutex_lock(&dev.open_lock);
+    if (--dev.users == 0)
+        cancel_delayed_work_sync(&dev.sample_work);
+    mutex_unlock(&dev.open_lock);
+
+    spin_lock(&dev.batch_lock);
+    list_del(&f->node);
+    spin_unlock(&dev.batch_lock);
+    kfifo_free(&f->fifo);
+    kfree(f);
     return 0;
 }
 
-static ssize_t i2c_read(struct file *filp, char __user *buf, 
+static int bme280_set_read_mode(struct bme280_file *f, u32 mode) {
+    int ret = 0;
+
+    if (mode != BME280_READ_SNAPSHOT && mode != BME280_READ_BATCH)
+        return -EINVAL;
+
+    mutex_lock(&f->read_lock);
+    if (mode == f->mode)
+        goto out;
+
+    if (mode == BME280_READ_BATCH) {
+        if (!f->fifo.kfifo.data &&
+            (ret = kfifo_alloc(&f->fifo, BME280_FIFO_RECORDS, GFP_KERNEL)) != 0)
+            goto out;
+        kfifo_reset(&f->fifo);
+        f->overflow = false;
+        spin_lock(&dev.batch_lock);
+        list_add_tail(&f->node, &dev.batch_files);
+        spin_unlock(&dev.batch_lock);
+    } else {
+        spin_lock(&dev.batch_lock);
+        list_del_init(&f->node);
+        spin_unlock(&dev.batch_lock);
+    }
+    f->mode = mode;
+out:
+    mutex_unlock(&f->read_lock);
+    return ret;
+}
+
+static bool bme280_batch_ready(struct bme280_file *f) {
+    return kfifo_len(&f->fifo) >= READ_ONCE(f->watermark);
+}
+
+/* 批量模式：一次取走缓冲中能放进用户缓冲区的全部记录 */
+static ssize_t bme280_read_batch(struct file *filp, struct bme280_file *f,
+                                 char __user *buf, size_t count) {
+    unsigned int copied;
+    int ret;
+
+    if (count < sizeof(struct bme280_record))
+        return -EINVAL;
+
+    if (filp->f_flags & O_NONBLOCK) {
+        if (kfifo_is_empty(&f->fifo))
+            return -EAGAIN;
+    } else {
+        ret = wait_event_interruptible(dev.wq, bme280_batch_ready(f) ||
+                                       READ_ONCE(dev.removed));
+        if (ret)
+            return ret;
+        if (READ_ONCE(dev.removed))
+            return -ENODEV;
+    }
+
+    if (mutex_lock_interruptible(&f->read_lock))
+        return -ERESTARTSYS;
+    if (f->mode != BME280_READ_BATCH) {
+        mutex_unlock(&f->read_lock);
+        return -EINVAL;
+    }
+    count = rounddown(count, sizeof(struct bme280_record));
+    ret = kfifo_to_user(&f->fifo, buf, count, &copied);
+    mutex_unlock(&f->read_lock);
+
+    return ret ? ret : copied;
+}
+
+/* 返回缓存的快照；没有新样本时阻塞，O_NONBLOCK下返回-EAGAIN */
+static ssize_t i2c_read(struct file *filp, char __user *buf,
                        size_t count, loff_t *fpos) {
+    struct bme280_file *f = filp->private_data;
     struct bme280_data data;
-    s32 raw_temp, raw_press, raw_hum;
     int ret;
-    
-    if (!dev.calib_valid)
+
+    if (READ_ONCE(dev.removed) || !dev.calib_valid)
         return -ENODEV;
-    
-    ret = bme280_read_raw(&raw_temp, &raw_press, &raw_hum);
-    if (ret < 0)
-        return ret;
-    
-    data.temp = compensate_temp(raw_temp);
-    data.press = compensate_press(raw_press);
-    data.hum = compensate_hum(raw_hum);
-    
+    if (READ_ONCE(f->mode) == BME280_READ_BATCH)
+        return bme280_read_batch(filp, f, buf, count);
+    if (count < sizeof(data))
+        return -EINVAL;
+
+    if (bme280_snap_seq() == f->last_seq) {
+        if (filp->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(dev.wq,
+                                       bme280_snap_seq() != f->last_seq ||
+                                       READ_ONCE(dev.removed));
+        if (ret)
+            return ret;
+        if (READ_ONCE(dev.removed))
+            return -ENODEV;
+    }
+
+    bme280_snap_get(&data);
+    f->last_seq = data.seq;
+
     if (copy_to_user(buf, &data, sizeof(data)))
         return -EFAULT;
-    
+
     return sizeof(data);
 }
 
+static __poll_t i2c_poll(struct file *filp, poll_table *wait) {
+    struct bme280_file *f = filp->private_data;
+
+    poll_wait(filp, &dev.wq, wait);
+    if (READ_ONCE(dev.removed))
+        return EPOLLERR | EPOLLHUP;
+    if (READ_ONCE(f->mode) == BME280_READ_BATCH)
+        return bme280_batch_ready(f) ? EPOLLIN | EPOLLRDNORM : 0;
+    return bme280_snap_seq() != f->last_seq ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
+/* 调用者持有remove_sem读锁，dev.client在此期间有效 */
+static long bme280_do_ioctl(struct bme280_file *f, unsigned int cmd, unsigned long arg) {
+    void __user *argp = (void __user *)arg;
+    struct bme280_config cfg;
+    struct bme280_record rec;
+    struct bme280_data data;
+    u32 val;
+    int ret;
+
+    switch (cmd) {
+    case BME280_IOC_SET_ODR:
+        if (get_user(val, (u32 __user *)argp))
+            return -EFAULT;
+        return bme280_set_odr(val);
+    case BME280_IOC_GET_ODR:
+        return put_user(READ_ONCE(dev.odr_ms), (u32 __user *)argp);
+    case BME280_IOC_READ_NOW:
+        ret = bme280_measure(&rec);
+        if (ret)
+            return ret;
+        rec.seq = 0;
+        bme280_record_to_data(&rec, &data);
+        if (copy_to_user(argp, &data, sizeof(data)))
+            return -EFAULT;
+        return 0;
+    case BME280_IOC_SET_PROFILE:
+        if (get_user(val, (u32 __user *)argp))
+            return -EFAULT;
+        return bme280_set_profile(val);
+    case BME280_IOC_GET_PROFILE:
+        return put_user(READ_ONCE(dev.profile), (u32 __user *)argp);
+    case BME280_IOC_SET_CONFIG:
+        if (copy_from_user(&cfg, argp, sizeof(cfg)))
+            return -EFAULT;
+        return bme280_set_config(&cfg, BME280_PROFILE_CUSTOM);
+    case BME280_IOC_GET_CONFIG:
+        mutex_lock(&dev.cfg_lock);
+        cfg = dev.cfg;
+        mutex_unlock(&dev.cfg_lock);
+        if (copy_to_user(argp, &cfg, sizeof(cfg)))
+            return -EFAULT;
+        return 0;
+    case BME280_IOC_GET_CALIB:
+        if (!dev.calib_valid)
+            return -ENODEV;
+        if (copy_to_user(argp, &dev.calib, sizeof(dev.calib)))
+            return -EFAULT;
+        return 0;
+    case BME280_IOC_SET_RAW:
+        if (get_user(val, (u32 __user *)argp))
+            return -EFAULT;
+        WRITE_ONCE(f->raw, !!val);
+        return 0;
+    case BME280_IOC_SET_READ_MODE:
+        if (get_user(val, (u32 __user *)argp))
+            return -EFAULT;
+        return bme280_set_read_mode(f, val);
+    case BME280_IOC_SET_WATERMARK:
+        if (get_user(val, (u32 __user *)argp))
+            return -EFAULT;
+        if (val < 1 || val > BME280_FIFO_RECORDS)
+            return -EINVAL;
+        WRITE_ONCE(f->watermark, val);
+        wake_up_interruptible(&dev.wq);
+        return 0;
+    default:
+        return -ENOTTY;
+    }
+}
+
+static long i2c_ioctl(struct file *filp, unsigned int cmd, unsigned long arg) {
+    long ret;
+
+    down_read(&dev.remove_sem);
+    ret = dev.removed ? -ENODEV : bme280_do_ioctl(filp->private_data, cmd, arg);
+    up_read(&dev.remove_sem);
+    return ret;
+}
+
 static const struct file_operations i2c_fops = {
     .owner = THIS_MODULE,
     .open = i2c_open,
     .release = i2c_release,
     .read = i2c_read,
+    .poll = i2c_poll,
+    .unlocked_ioctl = i2c_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
 };
 
-/* 模块初始化 */
-static int __init bme280_init(void) {
+/* 当前所在的I2C适配器，供基准测试区分硬件控制器和soft_i2c */
+static ssize_t backend_show(struct device *d, struct device_attribute *attr,
+                            char *buf) {
+    return sprintf(buf, "%s\n", dev.client ? dev.client->adapter->name : "none");
+}
+static DEVICE_ATTR_RO(backend);
+
+static ssize_t odr_ms_show(struct device *d, struct device_attribute *attr,
+                           char *buf) {
+    return sprintf(buf, "%u\n", READ_ONCE(dev.odr_ms));
+}
+
+static ssize_t odr_ms_store(struct device *d, struct device_attribute *attr,
+                            const char *buf, size_t count) {
+    u32 ms;
+    int ret;
+
+    if ((ret = kstrtou32(buf, 0, &ms)) != 0)
+        return ret;
+    if ((ret = bme280_set_odr(ms)) != 0)
+        return ret;
+    return count;
+}
+static DEVICE_ATTR_RW(odr_ms);
+
+/* 列出所有档位，当前档位用方括号标出 */
+static ssize_t profile_show(struct device *d, struct device_attribute *attr,
+                            char *buf) {
+    u32 cur = READ_ONCE(dev.profile);
+    ssize_t len = 0;
+    int i;
+
+    for (i = 0; i < BME280_PROFILE_NR; i++)
+        len += sysfs_emit_at(buf, len, i == cur ? "[%s] " : "%s ",
+                             bme280_profiles[i].name);
+    if (cur == BME280_PROFILE_CUSTOM)
+        len += sysfs_emit_at(buf, len, "[custom] ");
+    buf[len - 1] = '\n';
+    return len;
+}
+
+static ssize_t profile_store(struct device *d, struct device_attribute *attr,
+                             const char *buf, size_t count) {
+    int i, ret;
+
+    for (i = 0; i < BME280_PROFILE_NR; i++) {
+        if (sysfs_streq(buf, bme280_profiles[i].name)) {
+            ret = bme280_set_profile(i);
+            return ret ? ret : count;
+        }
+    }
+    return -EINVAL;
+}
+static DEVICE_ATTR_RW(profile);
+
+static struct attribute *bme280_attrs[] = {
+    &dev_attr_backend.attr,
+    &dev_attr_odr_ms.attr,
+    &dev_attr_profile.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(bme280);
+
+/* 传感器初始化并注册字符设备 */
+static int bme280_setup(struct device *parent) {
     int ret;
-    u8 chip_id;
-    
-    mutex_init(&dev.lock);
+    u8 chip_id = 0;
+
     dev.calib_valid = false;
-    
-    /* 申请GPIO */
-    if ((ret = gpio_request(SCL_GPIO, "BME280_SCL")) != 0)
-        goto fail;
-    if ((ret = gpio_request(SDA_GPIO, "BME280_SDA")) != 0)
-        goto free_scl;
-    
-    /* 配置GPIO方向 */
-    if ((ret = gpio_direction_output(SCL_GPIO, 1)) != 0 ||
-        (ret = gpio_direction_output(SDA_GPIO, 1)) != 0)
-        goto free_gpio;
-    
+
     /* 检查芯片ID */
-    if (i2c_read_regs(BME280_CHIP_ID_REG, &chip_id, 1) != 1 || 
+    if (bme280_read_regs(BME280_CHIP_ID_REG, &chip_id, 1) != 1 ||
         chip_id != 0x60) {
         printk(KERN_ERR "无效的BME280芯片ID: 0x%02X\n", chip_id);
-        ret = -ENODEV;
-        goto free_gpio;
-    }
-    
-    /* 初始化传感器 */
-    if (i2c_write_reg(BME280_CTRL_HUM, 0x05) ||
-        i2c_write_reg(BME280_CTRL_MEAS, 0xB7) ||
-        i2c_write_reg(BME280_CONFIG, 0xA0)) {
-        ret = -EIO;
-        goto free_gpio;
+        return -ENODEV;
     }
-    
+
+    /* 初始化传感器：默认档位即原先的 CTRL_HUM=0x05/CTRL_MEAS=0xB7/CONFIG=0xA0 */
+    mutex_lock(&dev.cfg_lock);
+    ret = bme280_apply_config(&bme280_profiles[BME280_PROFILE_DEFAULT].cfg);
+    dev.profile = BME280_PROFILE_DEFAULT;
+    mutex_unlock(&dev.cfg_lock);
+    if (ret)
+        return ret;
+
     /* 读取校准参数 */
     if ((ret = bme280_read_calib()) != 0)
-        goto free_gpio;
-    
+        return ret;
+
     /* 注册字符设备 */
-    if ((ret = alloc_chrdev_region(&i2c_dev, 0, 1, "bme280")) != 0)
-        goto free_gpio;
+    if ((ret = alloc_chrdev_region(&i2c_dev, 0, 1, DRIVER_NAME)) != 0)
+        return ret;
     major = MAJOR(i2c_dev);
-    
-    if ((i2c_class = class_create(THIS_MODULE, "bme280")) == NULL) {
-        ret = -ENOMEM;
+
+    i2c_class = class_create(THIS_MODULE, DRIVER_NAME);
+    if (IS_ERR(i2c_class)) {
+        ret = PTR_ERR(i2c_class);
         goto unreg_chrdev;
     }
-    
-    if ((i2c_device = device_create(i2c_class, NULL, i2c_dev, NULL, "bme280")) == NULL) {
-        ret = -ENOMEM;
+
+    i2c_device = device_create_with_groups(i2c_class, parent, i2c_dev, NULL,
+                                           bme280_groups, DRIVER_NAME);
+    if (IS_ERR(i2c_device)) {
+        ret = PTR_ERR(i2c_device);
         goto destroy_class;
     }
-    
+
     cdev_init(&i2c_cdev, &i2c_fops);
     if ((ret = cdev_add(&i2c_cdev, i2c_dev, 1)) != 0)
         goto destroy_device;
-    
-    printk(KERN_INFO "BME280驱动加载成功\n");
+
+    printk(KERN_INFO "BME280驱动加载成功(%s)\n", dev.client->adapter->name);
     return 0;
 
 destroy_device:
@@ -404,23 +877,133 @@ destroy_class:
     class_destroy(i2c_class);
 unreg_chrdev:
     unregister_chrdev_region(i2c_dev, 1);
-free_gpio:
-    gpio_free(SCL_GPIO);
-    gpio_free(SDA_GPIO);
-free_scl:
-    gpio_free(SCL_GPIO);
-fail:
     return ret;
 }
 
-static void __exit bme280_exit(void) {
-    cdev_del(&i2c_cdev);
+/*
+ * 先删掉sysfs属性和设备节点，不再有新的打开和属性写入；
+ * 再等进行中的ioctl结束后置removed，唤醒阻塞的读者和poll
+ */
+static void bme280_teardown(void) {
     device_destroy(i2c_class, i2c_dev);
+    cdev_del(&i2c_cdev);
+
+    down_write(&dev.remove_sem);
+    WRITE_ONCE(dev.removed, true);
+    dev.calib_valid = false;
+    up_write(&dev.remove_sem);
+
+    /*
+     * 排期采样线程的地方(open、设置周期、订阅)都在open_lock内检查client，
+     * 在同一个临界区里停掉线程并清client，之后不会再被排期
+     */
+    mutex_lock(&dev.open_lock);
+    cancel_delayed_work_sync(&dev.sample_work);
+    dev.client = NULL;
+    mutex_unlock(&dev.open_lock);
+    wake_up_all(&dev.wq);
+
     class_destroy(i2c_class);
     unregister_chrdev_region(i2c_dev, 1);
-    gpio_free(SCL_GPIO);
-    gpio_free(SDA_GPIO);
-    printk(KERN_INFO "BME280驱动卸载\n");
+}
+
+/* 探测函数 */
+static int bme280_probe(struct i2c_client *client, const struct i2c_device_id *id) {
+    int ret;
+
+    /* 同一时间只支持一个传感器实例 */
+    if (dev.client)
+        return -EBUSY;
+
+    if (!i2c_check_functionality(client->adapter, I2C_FUNC_I2C) &&
+        !i2c_check_functionality(client->adapter,
+                                 I2C_FUNC_SMBUS_BYTE_DATA |
+                                 I2C_FUNC_SMBUS_READ_I2C_BLOCK)) {
+        dev_err(&client->dev, "适配器不支持所需的I2C功能\n");
+        return -EOPNOTSUPP;
+    }
+
+    mutex_lock(&dev.open_lock);
+    dev.client = client;
+    mutex_unlock(&dev.open_lock);
+    WRITE_ONCE(dev.removed, false);
+    ret = bme280_setup(&client->dev);
+    if (ret) {
+        WRITE_ONCE(dev.removed, true);
+        /* 初始化期间订阅者可能已经排期了采样线程，与remove一样在锁内停掉 */
+        mutex_lock(&dev.open_lock);
+        cancel_delayed_work_sync(&dev.sample_work);
+        dev.client = NULL;
+        mutex_unlock(&dev.open_lock);
+        return ret;
+    }
+
+    i2c_set_clientdata(client, &dev);
+
+    /* probe之前已经有内核订阅者 */
+    mutex_lock(&dev.open_lock);
+    if (dev.users)
+        mod_delayed_work(system_wq, &dev.sample_work, 0);
+    mutex_unlock(&dev.open_lock);
+    return 0;
+}
+
+static int bme280_remove(struct i2c_client *client) {
+    bme280_teardown();
+    dev_info(&client->dev, "BME280驱动卸载\n");
+    return 0;
+}
+
+/* 设备树匹配表 */
+static const struct of_device_id bme280_dt_ids[] = {
+    { .compatible = "bosch,bme280" },
+    {}
+};
+MODULE_DEVICE_TABLE(of, bme280_dt_ids);
+
+static const struct i2c_device_id bme280_id[] = {
+    { DRIVER_NAME, 0 },
+    {}
+};
+MODULE_DEVICE_TABLE(i2c, bme280_id);
+
+static struct i2c_driver bme280_driver = {
+    .driver = {
+        .name = DRIVER_NAME,
+        .of_match_table = bme280_dt_ids,
+    },
+    .probe = bme280_probe,
+    .remove = bme280_remove,
+    .id_table = bme280_id,
+};
+
+/* 模块初始化 */
+static int __init bme280_init(void) {
+    mutex_init(&dev.open_lock);
+    mutex_init(&dev.cfg_lock);
+    init_rwsem(&dev.remove_sem);
+    dev.removed = true;         /* probe之前没有可用的传感器 */
+    seqlock_init(&dev.snap_lock);
+    spin_lock_init(&dev.batch_lock);
+    INIT_LIST_HEAD(&dev.batch_files);
+    init_waitqueue_head(&dev.wq);
+    INIT_DELAYED_WORK(&dev.sample_work, bme280_sample_work);
+    dev.calib_valid = false;
+
+    if (bme280_set_odr(odr_ms)) {
+        printk(KERN_WARNING "BME280采样周期%ums无效，使用1000ms\n", odr_ms);
+        dev.odr_ms = 1000;
+    }
+
+    /*
+     * 通过设备树绑定到硬件I2C控制器；没有可用控制器时，
+     * 由soft_i2c模块在GPIO 36/61上注册模拟总线并实例化本设备。
+     */
+    return i2c_add_driver(&bme280_driver);
+}
+
+static void __exit bme280_exit(void) {
+    i2c_del_driver(&bme280_driver);
 }
 
 module_init(bme280_init);
@@ -428,4 +1011,4 @@ module_exit(bme280_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Alen");
-MODULE_DESCRIPTION("BME280 I2C Sensor Driver");
\ No newline at end of file
+MODULE_DESCRIPTION("BME280 I2C Sensor Driver");
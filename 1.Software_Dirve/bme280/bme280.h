@@ -0,0 +1,125 @@
+/*
+ * BME280 驱动与应用程序共用的数据结构和ioctl定义
+ */
+#ifndef __BME280_H
+#define __BME280_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/* read() 返回的最新快照 */
+struct bme280_data {
+    __s32 temp;    /* 0.01 ℃ */
+    __u32 press;   /* Pa，Q24.8 */
+    __u32 hum;     /* %RH，Q22.10 */
+    __u32 seq;     /* 采样序号，每产生一个新样本加1 */
+};
+
+/* 批量读取模式下 read() 一次返回多条的记录 */
+struct bme280_record {
+    __u64 timestamp_ns;     /* 总线读取完成时刻，CLOCK_BOOTTIME */
+    __u32 seq;              /* 与 bme280_data.seq 同一序号空间 */
+    __u32 flags;            /* BME280_REC_* */
+    __s32 temp;             /* 补偿后的值，单位同 bme280_data */
+    __u32 press;
+    __u32 hum;
+    __s32 raw_temp;         /* 20位ADC原始值 */
+    __s32 raw_press;
+    __s32 raw_hum;          /* 16位ADC原始值 */
+};
+
+/* 本记录之前有记录因缓冲区满被丢弃 */
+#define BME280_REC_OVERFLOW     0x01
+/* 文件开了原始输出，补偿字段为0，需在用户态用校准参数补偿 */
+#define BME280_REC_RAW          0x02
+
+/* 芯片出厂校准参数(0x88-0xA1, 0xE1-0xE7)解析后的值 */
+struct bme280_calib_data {
+    __u16 dig_T1;
+    __s16 dig_T2, dig_T3;
+    __u16 dig_P1;
+    __s16 dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
+    __u8  dig_H1;
+    __u8  dig_H3;
+    __s8  dig_H6;
+    __u8  reserved;
+    __s16 dig_H2, dig_H4, dig_H5;
+};
+
+/* read() 模式 */
+#define BME280_READ_SNAPSHOT    0   /* 每次返回一个 bme280_data */
+#define BME280_READ_BATCH       1   /* 每次返回尽可能多的 bme280_record */
+
+/* 每个文件的记录缓冲深度，1Hz采样可以缓存4分钟以上 */
+#define BME280_FIFO_RECORDS     256
+
+/* 工作模式，与 ctrl_meas[1:0] 编码一致 */
+#define BME280_MODE_SLEEP   0
+#define BME280_MODE_FORCED  1
+#define BME280_MODE_NORMAL  3
+
+/*
+ * 测量参数，均为数据手册中的寄存器编码：
+ *   osrs_*: 0=跳过 1=x1 2=x2 3=x4 4=x8 5=x16 (温度不可跳过)
+ *   filter: IIR系数 0=关闭 1=2 2=4 3=8 4=16
+ *   t_sb:   待机时间 0=0.5ms 1=62.5ms 2=125ms 3=250ms 4=500ms 5=1000ms 6=10ms 7=20ms
+ */
+struct bme280_config {
+    __u8 osrs_t;
+    __u8 osrs_p;
+    __u8 osrs_h;
+    __u8 filter;
+    __u8 t_sb;
+    __u8 mode;     /* BME280_MODE_FORCED 或 BME280_MODE_NORMAL */
+    __u16 reserved;
+};
+
+/* 预置档位，参考数据手册3.5节推荐设置 */
+enum bme280_profile {
+    BME280_PROFILE_DEFAULT = 0,     /* 全部x16，normal模式，1000ms待机 */
+    BME280_PROFILE_LOW_LATENCY,     /* 全部x1，normal模式，0.5ms待机，约100Hz */
+    BME280_PROFILE_WEATHER,         /* 全部x1，forced模式，每分钟一次 */
+    BME280_PROFILE_INDOOR_NAV,      /* P x16/T x2/H x1，IIR 16，0.5ms待机，25Hz */
+    BME280_PROFILE_NR,
+};
+#define BME280_PROFILE_CUSTOM   0xff    /* 通过 SET_CONFIG 手动设置 */
+
+/* 采样周期范围(ms) */
+#define BME280_ODR_MIN_MS   5
+#define BME280_ODR_MAX_MS   60000
+
+#define BME280_IOC_MAGIC    'B'
+/* 设置/读取后台采样周期(ms) */
+#define BME280_IOC_SET_ODR  _IOW(BME280_IOC_MAGIC, 1, __u32)
+#define BME280_IOC_GET_ODR  _IOR(BME280_IOC_MAGIC, 2, __u32)
+/* 绕过缓存，同步完成一次总线读取和补偿 */
+#define BME280_IOC_READ_NOW _IOR(BME280_IOC_MAGIC, 3, struct bme280_data)
+/* 切换预置档位(同时更新采样周期)，或直接设置测量参数 */
+#define BME280_IOC_SET_PROFILE  _IOW(BME280_IOC_MAGIC, 4, __u32)
+#define BME280_IOC_GET_PROFILE  _IOR(BME280_IOC_MAGIC, 5, __u32)
+#define BME280_IOC_SET_CONFIG   _IOW(BME280_IOC_MAGIC, 6, struct bme280_config)
+#define BME280_IOC_GET_CONFIG   _IOR(BME280_IOC_MAGIC, 7, struct bme280_config)
+/* 选择本文件的 read() 模式；批量模式下阻塞读取/poll 等到至少 watermark 条记录 */
+#define BME280_IOC_SET_READ_MODE _IOW(BME280_IOC_MAGIC, 8, __u32)
+#define BME280_IOC_SET_WATERMARK _IOW(BME280_IOC_MAGIC, 9, __u32)
+/* 导出校准参数；开启原始输出后本文件的批量记录只带原始值(每个文件单独设置) */
+#define BME280_IOC_GET_CALIB    _IOR(BME280_IOC_MAGIC, 10, struct bme280_calib_data)
+#define BME280_IOC_SET_RAW      _IOW(BME280_IOC_MAGIC, 11, __u32)
+
+#ifdef __KERNEL__
+/*
+ * 内核内订阅：采样线程每产生一个样本，以 BME280_EVENT_SAMPLE 和
+ * 指向 struct bme280_data 的指针调用订阅者，总是补偿后的值。
+ * 回调在采样线程里执行，可以睡眠，但不要做耗时的总线操作。
+ * 订阅期间即使没有应用打开设备也保持采样。
+ * 其他模块用 symbol_get() 获取这两个函数，不对bme280产生硬依赖。
+ */
+struct notifier_block;
+
+#define BME280_EVENT_SAMPLE     1
+
+int bme280_register_notifier(struct notifier_block *nb);
+int bme280_unregister_notifier(struct notifier_block *nb);
+#endif
+
+#endif /* __BME280_H */
@@ -0,0 +1,146 @@
+/*
+ * BME280 用户态批量补偿库，说明见 bme280_comp.h
+ *
+ * 编译：
+ *   riscv64-buildroot-linux-gnu-gcc -O3 -c bme280_comp.c
+ *
+ * VF2(JH7110/U74)为RV64GC，没有V扩展，批量路径在板上是展开后的标量代码；
+ * 在带RVV或SIMD的目标上同一份源码由编译器自动向量化。
+ */
+#include "bme280_comp.h"
+
+/* 每块样本数，t_fine暂存在栈上 */
+#define BME280_COMP_BLOCK 256
+
+static inline int32_t comp_t_fine(const struct bme280_calib_data *c, int32_t adc_T)
+{
+    int32_t var1, var2;
+
+    var1 = (((adc_T >> 3) - ((int32_t)c->dig_T1 << 1)) *
+           (int32_t)c->dig_T2) >> 11;
+    var2 = (((((adc_T >> 4) - (int32_t)c->dig_T1) *
+            ((adc_T >> 4) - (int32_t)c->dig_T1)) >> 12) *
+            (int32_t)c->dig_T3) >> 14;
+    return var1 + var2;
+}
+
+static inline int32_t comp_temp(int32_t t_fine)
+{
+    return (t_fine * 5 + 128) >> 8;
+}
+
+static inline uint32_t comp_press(const struct bme280_calib_data *c,
+                                  int32_t adc_P, int32_t t_fine)
+{
+    int64_t var1, var2, p;
+
+    var1 = (int64_t)t_fine - 128000;
+    var2 = var1 * var1 * (int64_t)c->dig_P6;
+    var2 += ((var1 * (int64_t)c->dig_P5) * ((int64_t)1 << 17));
+    var2 += ((int64_t)c->dig_P4 * ((int64_t)1 << 35));
+    var1 = ((var1 * var1 * (int64_t)c->dig_P3) >> 8) +
+           ((var1 * (int64_t)c->dig_P2) * ((int64_t)1 << 12));
+    var1 = ((((int64_t)1 << 47) + var1) * (int64_t)c->dig_P1) >> 33;
+
+    if (var1 == 0)
+        return 0;
+
+    p = 1048576 - adc_P;
+    p = ((p * ((int64_t)1 << 31)) - var2) * 3125 / var1;
+    var1 = ((int64_t)c->dig_P9 * (p >> 13) * (p >> 13)) >> 25;
+    var2 = ((int64_t)c->dig_P8 * p) >> 19;
+    return (uint32_t)(((p + var1 + var2) >> 8) + ((int64_t)c->dig_P7 * 16));
+}
+
+static inline uint32_t comp_hum(const struct bme280_calib_data *c,
+                                int32_t adc_H, int32_t t_fine)
+{
+    int32_t v;
+
+    v = t_fine - 76800;
+    v = (((((adc_H << 14) - ((int32_t)c->dig_H4 * (1 << 20)) -
+          ((int32_t)c->dig_H5 * v)) + 16384) >> 15) *
+          (((((((v * (int32_t)c->dig_H6) >> 10) *
+          (((v * (int32_t)c->dig_H3) >> 11) + 32768)) >> 10) + 2097152) *
+          (int32_t)c->dig_H2 + 8192) >> 14));
+    v -= (((((v >> 15) * (v >> 15)) >> 7) * (int32_t)c->dig_H1) >> 4);
+    v = v < 0 ? 0 : v;
+    v = v > 419430400 ? 419430400 : v;
+    return (uint32_t)(v >> 12);
+}
+
+void bme280_comp_scalar(const struct bme280_calib_data *calib,
+                        const int32_t *adc_t, const int32_t *adc_p,
+                        const int32_t *adc_h, size_t n,
+                        int32_t *temp, uint32_t *press, uint32_t *hum)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        int32_t t_fine = comp_t_fine(calib, adc_t[i]);
+
+        if (temp)
+            temp[i] = comp_temp(t_fine);
+        if (adc_p && press)
+            press[i] = comp_press(calib, adc_p[i], t_fine);
+        if (adc_h && hum)
+            hum[i] = comp_hum(calib, adc_h[i], t_fine);
+    }
+}
+
+/* 气压：只与t_fine相关的中间量按样本算，除零保护改为选择而不是分支 */
+static void comp_press_block(const struct bme280_calib_data *restrict c,
+                             const int32_t *restrict adc_p,
+                             const int32_t *restrict t_fine, size_t n,
+                             uint32_t *restrict press)
+{
+    const int64_t P1 = c->dig_P1, P2 = c->dig_P2, P3 = c->dig_P3;
+    const int64_t P4 = c->dig_P4, P5 = c->dig_P5, P6 = c->dig_P6;
+    const int64_t P7 = c->dig_P7, P8 = c->dig_P8, P9 = c->dig_P9;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        int64_t var1, var2, div, p;
+
+        var1 = (int64_t)t_fine[i] - 128000;
+        var2 = var1 * var1 * P6 + var1 * P5 * ((int64_t)1 << 17) +
+               P4 * ((int64_t)1 << 35);
+        var1 = ((var1 * var1 * P3) >> 8) + var1 * P2 * ((int64_t)1 << 12);
+        var1 = ((((int64_t)1 << 47) + var1) * P1) >> 33;
+        div = var1 ? var1 : 1;
+
+        p = 1048576 - adc_p[i];
+        p = ((p * ((int64_t)1 << 31)) - var2) * 3125 / div;
+        p = ((p + ((P9 * (p >> 13) * (p >> 13)) >> 25) + ((P8 * p) >> 19)) >> 8) +
+            P7 * 16;
+        press[i] = var1 ? (uint32_t)p : 0;
+    }
+}
+
+void bme280_comp_batch(const struct bme280_calib_data *calib,
+                       const int32_t *adc_t, const int32_t *adc_p,
+                       const int32_t *adc_h, size_t n,
+                       int32_t *temp, uint32_t *press, uint32_t *hum)
+{
+    const struct bme280_calib_data c = *calib;
+    int32_t t_fine[BME280_COMP_BLOCK];
+    size_t base, i, m;
+
+    for (base = 0; base < n; base += m) {
+        m = n - base < BME280_COMP_BLOCK ? n - base : BME280_COMP_BLOCK;
+
+        for (i = 0; i < m; i++)
+            t_fine[i] = comp_t_fine(&c, adc_t[base + i]);
+
+        if (temp)
+            for (i = 0; i < m; i++)
+                temp[base + i] = comp_temp(t_fine[i]);
+
+        if (adc_h && hum)
+            for (i = 0; i < m; i++)
+                hum[base + i] = comp_hum(&c, adc_h[base + i], t_fine[i]);
+
+        if (adc_p && press)
+            comp_press_block(&c, adc_p + base, t_fine, m, press + base);
+    }
+}
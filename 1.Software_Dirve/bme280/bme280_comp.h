@@ -0,0 +1,35 @@
+/*
+ * BME280 用户态批量补偿库
+ *
+ * 配合驱动的原始输出模式(BME280_IOC_SET_RAW)和校准参数导出
+ * (BME280_IOC_GET_CALIB)使用，用于快速回放长时间记录的原始数据。
+ * 输入输出都是结构体数组拆开的SoA布局，输出单位与 struct bme280_data 一致：
+ *   temp  0.01 ℃
+ *   press Pa，Q24.8
+ *   hum   %RH，Q22.10
+ */
+#ifndef __BME280_COMP_H
+#define __BME280_COMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bme280.h"
+
+/* 逐个样本的标量参考实现，与数据手册4.2.3节整数公式逐位一致 */
+void bme280_comp_scalar(const struct bme280_calib_data *calib,
+                        const int32_t *adc_t, const int32_t *adc_p,
+                        const int32_t *adc_h, size_t n,
+                        int32_t *temp, uint32_t *press, uint32_t *hum);
+
+/*
+ * 批量实现：按块先算出t_fine，再分别跑温度、湿度、气压三个无分支的循环，
+ * 便于编译器向量化(-O3，RVV内核上加 -march=rv64gcv)。结果与标量实现一致。
+ * adc_p/adc_h 或对应输出为NULL时跳过该通道。
+ */
+void bme280_comp_batch(const struct bme280_calib_data *calib,
+                       const int32_t *adc_t, const int32_t *adc_p,
+                       const int32_t *adc_h, size_t n,
+                       int32_t *temp, uint32_t *press, uint32_t *hum);
+
+#endif /* __BME280_COMP_H */
@@ -1,37 +1,155 @@
-#include <stdio.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <errno.h>
-
-struct bme280_data {
-    int temp;
-    unsigned int press;
-    unsigned int hum;
-};
-
-int main() {
-    int fd = open("/dev/bme280", O_RDONLY);
-    if (fd < 0) {
-        perror("设备打开失败");
-        return -1;
-    }
-    
-    struct bme280_data data;
-    while(1) {
-        ssize_t ret = read(fd, &data, sizeof(data));
-        if (ret != sizeof(data)) {
-            if (errno == EAGAIN) continue;
-            perror("读取失败");
-            sleep(1);
-            continue;
-        }
-        
-        printf("温度: %.2f℃\n", data.temp / 100.0);
-        printf("气压: %.2fhPa\n", data.press / 25600.0);
-        printf("湿度: %.2f%%\n\n", data.hum / 1024.0);
-        sleep(1);
-    }
-    
-    close(fd);
-    return 0;
-}
\ No newline at end of file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include "bme280.h"
+
+/*
+ * 用法：
+ *   test_bme280                    逐个打印快照
+ *   test_bme280 -b [-w N] [-o ms] [-n 总数]
+ *                                  批量模式吞吐/延迟测试：
+ *                                  -w 每次唤醒至少攒够N条记录(默认60)
+ *                                  -o 采样周期，-n 收到多少条后退出
+ */
+
+#define BATCH_MAX 256
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static uint64_t boottime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int run_snapshot(int fd) {
+    struct bme280_data data;
+    while(!stop) {
+        /* 驱动在没有新样本时阻塞，读取节奏由后台采样周期决定 */
+        ssize_t ret = read(fd, &data, sizeof(data));
+        if (ret != sizeof(data)) {
+            if (errno == EAGAIN || errno == EINTR) continue;
+            perror("读取失败");
+            sleep(1);
+            continue;
+        }
+
+        printf("序号: %u\n", data.seq);
+        printf("温度: %.2f℃\n", data.temp / 100.0);
+        printf("气压: %.2fhPa\n", data.press / 25600.0);
+        printf("湿度: %.2f%%\n\n", data.hum / 1024.0);
+    }
+    return 0;
+}
+
+static int run_batch(int fd, unsigned int watermark, unsigned int odr,
+                     unsigned long total) {
+    static struct bme280_record recs[BATCH_MAX];
+    unsigned int mode = BME280_READ_BATCH;
+    unsigned long records = 0, reads = 0, lost = 0, overflows = 0;
+    uint64_t lat_min = UINT64_MAX, lat_max = 0, lat_sum = 0;
+    uint64_t t_start, t_end;
+    uint32_t last_seq = 0;
+
+    if (odr && ioctl(fd, BME280_IOC_SET_ODR, &odr) < 0) {
+        perror("设置采样周期失败");
+        return -1;
+    }
+    if (ioctl(fd, BME280_IOC_SET_READ_MODE, &mode) < 0 ||
+        ioctl(fd, BME280_IOC_SET_WATERMARK, &watermark) < 0) {
+        perror("设置批量模式失败");
+        return -1;
+    }
+
+    t_start = boottime_ns();
+    while (!stop && (!total || records < total)) {
+        ssize_t ret = read(fd, recs, sizeof(recs));
+        uint64_t now = boottime_ns();
+        size_t i, n;
+
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            perror("读取失败");
+            return -1;
+        }
+        reads++;
+        n = ret / sizeof(recs[0]);
+
+        for (i = 0; i < n; i++) {
+            /* 延迟：样本产生到被应用拿到的时间 */
+            uint64_t lat = now - recs[i].timestamp_ns;
+            if (lat < lat_min) lat_min = lat;
+            if (lat > lat_max) lat_max = lat;
+            lat_sum += lat;
+
+            if (last_seq && recs[i].seq != last_seq + 1)
+                lost += recs[i].seq - last_seq - 1;
+            if (recs[i].flags & BME280_REC_OVERFLOW)
+                overflows++;
+            last_seq = recs[i].seq;
+        }
+        records += n;
+
+        if (n)
+            printf("read #%lu: %zu 条, 最新 %.2f℃ %.2fhPa %.2f%%\n", reads, n,
+                   recs[n - 1].temp / 100.0, recs[n - 1].press / 25600.0,
+                   recs[n - 1].hum / 1024.0);
+    }
+    t_end = boottime_ns();
+
+    if (!records)
+        return 0;
+    printf("\n记录数:        %lu (丢失 %lu, 溢出标志 %lu)\n", records, lost, overflows);
+    printf("read调用:      %lu (平均每次 %.1f 条)\n", reads, (double)records / reads);
+    printf("吞吐:          %.2f 条/s\n", records * 1e9 / (t_end - t_start));
+    printf("交付延迟(ms):  min %.1f / avg %.1f / max %.1f\n",
+           lat_min / 1e6, lat_sum / 1e6 / records, lat_max / 1e6);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    struct sigaction sa;
+    unsigned int watermark = 60, odr = 0;
+    unsigned long total = 0;
+    int batch = 0, opt, ret;
+
+    while ((opt = getopt(argc, argv, "bw:o:n:")) != -1) {
+        switch (opt) {
+        case 'b': batch = 1; break;
+        case 'w': watermark = strtoul(optarg, NULL, 0); break;
+        case 'o': odr = strtoul(optarg, NULL, 0); break;
+        case 'n': total = strtoul(optarg, NULL, 0); break;
+        default:
+            printf("Usage: %s [-b] [-w watermark] [-o odr_ms] [-n records]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    int fd = open("/dev/bme280", O_RDONLY);
+    if (fd < 0) {
+        perror("设备打开失败");
+        return -1;
+    }
+
+    /* 不设置SA_RESTART，让阻塞中的read被Ctrl+C打断后输出统计 */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    ret = batch ? run_batch(fd, watermark, odr, total) : run_snapshot(fd);
+
+    close(fd);
+    return ret;
+}
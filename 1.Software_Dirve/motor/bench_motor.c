@@ -0,0 +1,140 @@
+/*
+ * 步进电机定时抖动对比：用户态ioctl+usleep循环 vs 内核hrtimer运动
+ *
+ * 编译：
+ *   riscv64-buildroot-linux-gnu-gcc -O2 -o bench_motor bench_motor.c -lm
+ *
+ * 用法：
+ *   bench_motor [步数] [步距us]      默认 2000 步，1000us(1000半步/秒)
+ *
+ * 用户态：与 test_motor 相同，每半步4次ioctl设相位、usleep、再4次ioctl断电，
+ *         记录每一步开始的时刻，统计步距的平均值、标准差和最大偏差，
+ *         以及相对理想时间栅格的累计漂移。
+ * 内核：  同样步数、同样速度的 CMD_STEPMOTOR_MOVE(不加减速)，读取驱动统计的
+ *         hrtimer回调相对计划时刻的平均/最大延迟；内核在计划时刻上累加，
+ *         没有累计漂移，步距误差就是相邻两次延迟之差。
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include "motor.h"
+
+static const unsigned long phase_bits[8] = { 0x1, 0x3, 0x2, 0x6, 0x4, 0xC, 0x8, 0x9 };
+static const unsigned int phase_cmd[4] = {
+    CMD_STEPMOTOR_A, CMD_STEPMOTOR_B, CMD_STEPMOTOR_C, CMD_STEPMOTOR_D,
+};
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void set_phase(int fd, unsigned long bits)
+{
+    int i;
+
+    for (i = 0; i < 4; i++)
+        ioctl(fd, phase_cmd[i], (bits >> i) & 1);
+}
+
+/* 复刻 test_motor 的循环 */
+static void bench_user(int fd, unsigned long steps, unsigned long delay_us)
+{
+    double *t = malloc((steps + 1) * sizeof(double));
+    double sum = 0, sq = 0, dev_max = 0, mean, sd, ioctl_us;
+    unsigned long i;
+
+    for (i = 0; i < steps; i++) {
+        t[i] = now_us();
+        set_phase(fd, phase_bits[(i + 1) & 7]);
+        usleep(delay_us);
+        set_phase(fd, 0);
+    }
+    t[steps] = now_us();
+
+    for (i = 1; i <= steps; i++)
+        sum += t[i] - t[i - 1];
+    mean = sum / steps;
+    for (i = 1; i <= steps; i++) {
+        double d = t[i] - t[i - 1] - mean;
+        sq += d * d;
+        if (fabs(d) > dev_max)
+            dev_max = fabs(d);
+    }
+    sd = sqrt(sq / steps);
+
+    /* 单独测8次ioctl的开销 */
+    ioctl_us = now_us();
+    for (i = 0; i < 1000; i++) {
+        set_phase(fd, phase_bits[i & 7]);
+        set_phase(fd, 0);
+    }
+    ioctl_us = (now_us() - ioctl_us) / 1000;
+
+    printf("用户态循环: 目标步距 %lu us, 实际平均 %.1f us (速度偏慢 %.1f%%)\n",
+           delay_us, mean, (mean - delay_us) * 100.0 / delay_us);
+    printf("            步距标准差 %.1f us, 最大偏差 %.1f us, 每步8次ioctl %.1f us\n",
+           sd, dev_max, ioctl_us);
+    printf("            %lu 步累计漂移 %.1f ms\n", steps, (t[steps] - t[0] - steps * (double)delay_us) / 1000);
+    free(t);
+}
+
+static void bench_kernel(int fd, unsigned long steps, unsigned long delay_us)
+{
+    struct step_motor_move m = {
+        .steps = steps,
+        .direction = 1,
+        .max_speed = 1000000 / delay_us,
+        .accel = 0,
+    };
+    struct step_motor_status st;
+    double t0, t1, expect;
+
+    t0 = now_us();
+    if (ioctl(fd, CMD_STEPMOTOR_MOVE, &m) < 0 || ioctl(fd, CMD_STEPMOTOR_WAIT) < 0) {
+        perror("CMD_STEPMOTOR_MOVE");
+        return;
+    }
+    t1 = now_us();
+    if (ioctl(fd, CMD_STEPMOTOR_STATUS, &st) < 0) {
+        perror("CMD_STEPMOTOR_STATUS");
+        return;
+    }
+    /* 最后一步还要保持一个步距再断电 */
+    expect = steps * 1e6 / m.max_speed;
+    printf("内核hrtimer: 目标步距 %.1f us, %u 步总耗时 %.1f ms (理论 %.1f ms)\n",
+           1e6 / m.max_speed, st.steps_done, (t1 - t0) / 1000, expect / 1000);
+    printf("            回调延迟 平均 %.1f us, 最大 %.1f us, 步距最大偏差 <= %.1f us\n",
+           st.late_avg_ns / 1000.0, st.late_max_ns / 1000.0, st.late_max_ns / 1000.0);
+    printf("            系统调用 2 次(MOVE + WAIT)，用户态 %lu 次\n", steps * 8);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long steps = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000;
+    unsigned long delay_us = argc > 2 ? strtoul(argv[2], NULL, 0) : 1000;
+    int fd;
+
+    if (!steps || delay_us < 1000000 / STEP_MOTOR_MAX_SPEED) {
+        printf("步距不能小于 %d us\n", 1000000 / STEP_MOTOR_MAX_SPEED);
+        return 1;
+    }
+    fd = open("/dev/step_motor", O_RDWR);
+    if (fd < 0) {
+        perror("打开 /dev/step_motor 失败");
+        return -1;
+    }
+
+    bench_user(fd, steps, delay_us);
+    bench_kernel(fd, steps, delay_us);
+    close(fd);
+    return 0;
+}
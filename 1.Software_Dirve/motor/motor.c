@@ -3,8 +3,22 @@
 #include <linux/fs.h>
 #include <linux/miscdevice.h>
 #include <linux/gpio.h>
+#include <linux/gpio/consumer.h>
 #include <linux/uaccess.h>
 #include <linux/delay.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/math64.h>
+#include <linux/kfifo.h>
+#include <linux/list.h>
+#include <linux/slab.h>
+#include <linux/eventfd.h>
+
+#include "motor.h"
 
 #define DRIVER_NAME "step_motor_driver"
 #define DEVICE_NAME "step_motor"
@@ -15,17 +29,412 @@
 #define GPIO_MOTOR_C 56
 #define GPIO_MOTOR_D 40
 
-// IOCTL命令定义
-#define CMD_STEPMOTOR_A _IOW('L', 0, unsigned long)
-#define CMD_STEPMOTOR_B _IOW('L', 1, unsigned long)
-#define CMD_STEPMOTOR_C _IOW('L', 2, unsigned long)
-#define CMD_STEPMOTOR_D _IOW('L', 3, unsigned long)
-
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_AUTHOR("wdb");
 
+#define STEP_MOTOR_PHASES 4
+
+// 半步序列 A, AB, B, BC, C, CD, D, DA，bit0~3 对应 A~D
+static const unsigned long half_step_table[8] = {
+    0x1, 0x3, 0x2, 0x6, 0x4, 0xC, 0x8, 0x9,
+};
+
+/* 排队中的一段运动 */
+struct step_motor_seg {
+    u32 id;
+    int dir;
+    u32 steps;
+    u32 max_speed;
+    u32 accel;
+};
+
+/* 内核运动状态，hrtimer回调和ioctl之间用lock保护 */
+struct step_motor {
+    struct gpio_desc *desc[STEP_MOTOR_PHASES];
+    bool atomic_ok;             // 四相都能在中断上下文里设置
+    spinlock_t lock;
+    struct mutex ctl_lock;      // 串行化 MOVE/STOP/HOLD/SET_POSITION
+    struct hrtimer timer;
+    wait_queue_head_t wq;       // WAIT、read()、poll() 共用
+    bool running;               // 有段在走，队列走空才清除
+    bool hold_tail;             // 最后一步已输出，下一次到期时本段结束
+    bool hold;                  // 停止后保持最后一相通电
+    unsigned int phase;         // 半步序列位置，跨运动保持，不丢步
+    s32 position;               // 绝对位置，半步
+    DECLARE_KFIFO(queue, struct step_motor_seg, STEP_MOTOR_QUEUE_LEN);
+    u32 next_id;
+    /* 当前段 */
+    u32 seg_id;
+    bool cancelled;
+    int dir;
+    u32 steps_total;
+    u32 steps_done;
+    u64 max_speed;
+    u64 accel;
+    u32 speed;                  // 当前速度，半步/秒
+    /* 定时精度统计：回调执行时刻相对计划到期时刻的延迟 */
+    u64 late_sum_ns;
+    u32 late_max_ns;
+    u32 late_count;
+    struct list_head files;     // 打开的文件，段结束时向每个文件投递事件
+};
+
+/* 每个打开的文件一份事件缓冲 */
+struct step_motor_file {
+    struct list_head node;
+    DECLARE_KFIFO(events, struct step_motor_event, STEP_MOTOR_EVENT_BUF);
+    bool overflow;              // 有事件被丢弃，下一个事件带上标志
+    struct mutex read_lock;     // kfifo的唯一消费者
+    struct eventfd_ctx *efd;
+};
+
+static struct step_motor motor;
+
+/* 四相一次写入，不会出现中间相 */
+static void step_motor_output(unsigned long bits)
+{
+    gpiod_set_array_value(STEP_MOTOR_PHASES, motor.desc, NULL, &bits);
+}
+
+/*
+ * 第k步(从0开始)的速度：加速段 v^2 = 2*a*(k+1)，减速段 v^2 = 2*a*剩余步数，
+ * 取两者和最高速度中的最小值，即梯形(步数少时为三角形)曲线
+ */
+static u32 step_motor_speed(void)
+{
+    u64 v2, vmax2 = motor.max_speed * motor.max_speed;
+    u32 remain = motor.steps_total - motor.steps_done;
+
+    if (!motor.accel)
+        return motor.max_speed;
+    v2 = 2 * motor.accel * min(motor.steps_done + 1, remain);
+    if (v2 > vmax2)
+        v2 = vmax2;
+    return max_t(u32, int_sqrt64(v2), 1);
+}
+
+/*
+ * 段结束，向每个打开的文件投递事件；缓冲区满时丢弃新事件。
+ * 在hrtimer回调里也会调用，调用者持有lock，之后负责唤醒wq
+ */
+static void step_motor_emit(u32 id, u32 steps_done, u32 ev_flags)
+{
+    struct step_motor_event ev = {
+        .timestamp_ns = ktime_get_ns(),
+        .id = id,
+        .steps_done = steps_done,
+        .position = motor.position,
+    };
+    struct step_motor_file *f;
+
+    list_for_each_entry(f, &motor.files, node) {
+        if (f->efd)
+            eventfd_signal(f->efd, 1);
+        if (kfifo_is_full(&f->events)) {
+            f->overflow = true;
+            continue;
+        }
+        ev.flags = ev_flags;
+        if (f->overflow)
+            ev.flags |= STEP_MOTOR_EV_OVERFLOW;
+        f->overflow = false;
+        kfifo_put(&f->events, ev);
+    }
+}
+
+/* 从队列取下一段作为当前段，队列空返回false；调用者持有lock */
+static bool step_motor_next_segment(void)
+{
+    struct step_motor_seg seg;
+
+    if (!kfifo_get(&motor.queue, &seg))
+        return false;
+    motor.seg_id = seg.id;
+    motor.cancelled = false;
+    motor.dir = seg.dir;
+    motor.steps_total = seg.steps;
+    motor.steps_done = 0;
+    motor.max_speed = seg.max_speed;
+    motor.accel = seg.accel;
+    return true;
+}
+
+/* 丢弃排队中的段，每段一个取消事件；调用者持有lock */
+static void step_motor_flush(void)
+{
+    struct step_motor_seg seg;
+
+    while (kfifo_get(&motor.queue, &seg))
+        step_motor_emit(seg.id, 0, STEP_MOTOR_EV_CANCELLED);
+}
+
+/* 队列走空或被停止：断电或保持最后一相；调用者持有lock */
+static void step_motor_idle(void)
+{
+    if (!motor.hold)
+        step_motor_output(0);
+    motor.running = false;
+    motor.hold_tail = false;
+    motor.speed = 0;
+}
+
+static enum hrtimer_restart step_motor_timer(struct hrtimer *t)
+{
+    ktime_t expires = hrtimer_get_expires(t);
+    s64 late = ktime_to_ns(ktime_sub(hrtimer_cb_get_time(t), expires));
+    unsigned long flags;
+    u32 interval_ns;
+
+    spin_lock_irqsave(&motor.lock, flags);
+    if (late > 0) {
+        motor.late_sum_ns += late;
+        if (late > motor.late_max_ns)
+            motor.late_max_ns = min_t(s64, late, U32_MAX);
+    }
+    motor.late_count++;
+
+    if (motor.hold_tail) {
+        /* 最后一步保持了一个步距，本段结束，队列里有下一段就直接开始 */
+        motor.hold_tail = false;
+        step_motor_emit(motor.seg_id, motor.steps_done,
+                        motor.cancelled ? STEP_MOTOR_EV_CANCELLED : STEP_MOTOR_EV_DONE);
+        if (!step_motor_next_segment()) {
+            step_motor_idle();
+            spin_unlock_irqrestore(&motor.lock, flags);
+            wake_up_interruptible(&motor.wq);
+            return HRTIMER_NORESTART;
+        }
+        wake_up_interruptible(&motor.wq);
+    }
+
+    motor.speed = step_motor_speed();
+    motor.phase = (motor.phase + motor.dir) & 7;
+    step_motor_output(half_step_table[motor.phase]);
+    motor.position += motor.dir;
+    motor.steps_done++;
+    if (motor.steps_done == motor.steps_total)
+        motor.hold_tail = true;
+
+    /* 在计划时刻上累加，回调延迟不会累积成速度误差 */
+    interval_ns = NSEC_PER_SEC / motor.speed;
+    hrtimer_set_expires(t, ktime_add_ns(expires, interval_ns));
+    spin_unlock_irqrestore(&motor.lock, flags);
+    return HRTIMER_RESTART;
+}
+
+/* 加入队列，空闲时立即开始；段号写回 m->id */
+static int step_motor_move(struct step_motor_move *m)
+{
+    struct step_motor_seg seg;
+    unsigned long flags;
+    bool start;
+
+    if (!motor.atomic_ok)
+        return -EOPNOTSUPP;
+    if (!m->steps || !m->max_speed || m->max_speed > STEP_MOTOR_MAX_SPEED)
+        return -EINVAL;
+
+    spin_lock_irqsave(&motor.lock, flags);
+    if (kfifo_is_full(&motor.queue)) {
+        spin_unlock_irqrestore(&motor.lock, flags);
+        return -ENOSPC;
+    }
+    seg.id = m->id = ++motor.next_id;
+    seg.dir = m->direction ? 1 : -1;
+    seg.steps = m->steps;
+    seg.max_speed = m->max_speed;
+    seg.accel = m->accel;
+    kfifo_put(&motor.queue, seg);
+
+    start = !motor.running;
+    if (start) {
+        step_motor_next_segment();
+        motor.running = true;
+        motor.hold_tail = false;
+        motor.speed = 0;
+        motor.late_sum_ns = 0;
+        motor.late_max_ns = 0;
+        motor.late_count = 0;
+    }
+    spin_unlock_irqrestore(&motor.lock, flags);
+
+    /* 第一步立即输出 */
+    if (start)
+        hrtimer_start(&motor.timer, ktime_get(), HRTIMER_MODE_ABS_HARD);
+    return 0;
+}
+
+/*
+ * 取消当前段并清空队列。减速停止只是把当前段的总步数缩短到刹车距离
+ * v^2/(2a)，由hrtimer按原曲线走完；立即停止则等回调退出后直接结束本段
+ */
+static int step_motor_stop(u32 mode)
+{
+    unsigned long flags;
+    u64 v;
+    u32 brake;
+
+    if (mode != STEP_MOTOR_STOP_DECEL && mode != STEP_MOTOR_STOP_NOW)
+        return -EINVAL;
+
+    spin_lock_irqsave(&motor.lock, flags);
+    if (mode == STEP_MOTOR_STOP_DECEL && motor.running && !motor.hold_tail &&
+        motor.accel && motor.speed) {
+        v = motor.speed;
+        brake = DIV_ROUND_UP_ULL(v * v, 2 * motor.accel);
+        if (motor.steps_total - motor.steps_done > brake) {
+            motor.steps_total = motor.steps_done + brake;
+            motor.cancelled = true;
+        }
+        step_motor_flush();
+        spin_unlock_irqrestore(&motor.lock, flags);
+        wake_up_interruptible(&motor.wq);
+        return 0;
+    }
+    spin_unlock_irqrestore(&motor.lock, flags);
+
+    /* 回调里会拿lock，不能持锁等待 */
+    hrtimer_cancel(&motor.timer);
+
+    spin_lock_irqsave(&motor.lock, flags);
+    if (motor.running) {
+        step_motor_emit(motor.seg_id, motor.steps_done,
+                        motor.steps_done == motor.steps_total && !motor.cancelled ?
+                        STEP_MOTOR_EV_DONE : STEP_MOTOR_EV_CANCELLED);
+        step_motor_idle();
+    }
+    step_motor_flush();
+    spin_unlock_irqrestore(&motor.lock, flags);
+    wake_up_interruptible(&motor.wq);
+    return 0;
+}
+
+/* 空闲时立即生效：保持则给当前相通电，不会移动转子 */
+static int step_motor_set_hold(bool hold)
+{
+    unsigned long flags;
+
+    if (!motor.atomic_ok)
+        return -EOPNOTSUPP;
+    spin_lock_irqsave(&motor.lock, flags);
+    motor.hold = hold;
+    if (!motor.running)
+        step_motor_output(hold ? half_step_table[motor.phase] : 0);
+    spin_unlock_irqrestore(&motor.lock, flags);
+    return 0;
+}
+
+static int step_motor_set_position(s32 pos)
+{
+    unsigned long flags;
+    int ret = 0;
+
+    spin_lock_irqsave(&motor.lock, flags);
+    if (motor.running)
+        ret = -EBUSY;
+    else
+        motor.position = pos;
+    spin_unlock_irqrestore(&motor.lock, flags);
+    return ret;
+}
+
+static int step_motor_set_eventfd(struct step_motor_file *f, int fd)
+{
+    struct eventfd_ctx *ctx = NULL, *old;
+    unsigned long flags;
+
+    if (fd >= 0) {
+        ctx = eventfd_ctx_fdget(fd);
+        if (IS_ERR(ctx))
+            return PTR_ERR(ctx);
+    }
+    spin_lock_irqsave(&motor.lock, flags);
+    old = f->efd;
+    f->efd = ctx;
+    spin_unlock_irqrestore(&motor.lock, flags);
+    if (old)
+        eventfd_ctx_put(old);
+    return 0;
+}
+
+static void step_motor_get_status(struct step_motor_status *st)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&motor.lock, flags);
+    st->running = motor.running;
+    st->steps_done = motor.steps_done;
+    st->steps_total = motor.steps_total;
+    st->speed = motor.speed;
+    st->late_max_ns = motor.late_max_ns;
+    st->late_avg_ns = motor.late_count ? div_u64(motor.late_sum_ns, motor.late_count) : 0;
+    st->position = motor.position;
+    st->seg_id = motor.seg_id;
+    st->queued = kfifo_len(&motor.queue);
+    st->hold = motor.hold;
+    spin_unlock_irqrestore(&motor.lock, flags);
+}
+
+/* 运动控制命令，ctl_lock下执行；不是运动命令返回-ENOIOCTLCMD */
+static long step_motor_ctl(struct step_motor_file *f, unsigned int cmd, unsigned long arg)
+{
+    struct step_motor_move m;
+    int ret;
+
+    switch(cmd) {
+        case CMD_STEPMOTOR_MOVE:
+            if (copy_from_user(&m, (void __user *)arg, sizeof(m)))
+                return -EFAULT;
+            ret = step_motor_move(&m);
+            if (!ret && copy_to_user((void __user *)arg, &m, sizeof(m)))
+                return -EFAULT;
+            return ret;
+        case CMD_STEPMOTOR_STOP:
+            return step_motor_stop(arg);
+        case CMD_STEPMOTOR_HOLD:
+            return step_motor_set_hold(arg != 0);
+        case CMD_STEPMOTOR_SET_POSITION:
+            return step_motor_set_position((s32)arg);
+        case CMD_STEPMOTOR_SET_EVENTFD:
+            return step_motor_set_eventfd(f, (int)arg);
+        default:
+            return -ENOIOCTLCMD;
+    }
+}
+
 static long step_motor_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
+    struct step_motor_file *f = filp->private_data;
+    struct step_motor_status st;
+    long ret;
+
+    switch(cmd) {
+        case CMD_STEPMOTOR_WAIT:
+            return wait_event_interruptible(motor.wq, !READ_ONCE(motor.running));
+        case CMD_STEPMOTOR_STATUS:
+            step_motor_get_status(&st);
+            if (copy_to_user((void __user *)arg, &st, sizeof(st)))
+                return -EFAULT;
+            return 0;
+        default:
+            break;
+    }
+
+    mutex_lock(&motor.ctl_lock);
+    ret = step_motor_ctl(f, cmd, arg);
+    if (ret != -ENOIOCTLCMD)
+        goto out;
+
+    /*
+     * 单相控制与内核运动互斥。MOVE也要拿ctl_lock，检查running和写GPIO
+     * 都在锁内，中间不会有运动开始，不会打乱正在输出的半步序列
+     */
+    if (READ_ONCE(motor.running)) {
+        ret = -EBUSY;
+        goto out;
+    }
+
+    ret = 0;
     switch(cmd) {
         case CMD_STEPMOTOR_A:
             gpio_set_value(GPIO_MOTOR_A, arg);
@@ -40,19 +449,81 @@ static long step_motor_ioctl(struct file *filp, unsigned int cmd, unsigned long
             gpio_set_value(GPIO_MOTOR_D, arg);
             break;
         default:
-            return -ENOTTY;
+            ret = -ENOTTY;
+            break;
     }
-    return 0;
+out:
+    mutex_unlock(&motor.ctl_lock);
+    return ret;
+}
+
+/* 返回缓冲区里能放下的所有整条事件 */
+static ssize_t step_motor_read(struct file *filp, char __user *buf,
+                               size_t count, loff_t *fpos)
+{
+    struct step_motor_file *f = filp->private_data;
+    unsigned int copied;
+    int ret;
+
+    if (count < sizeof(struct step_motor_event))
+        return -EINVAL;
+
+    mutex_lock(&f->read_lock);
+    while (kfifo_is_empty(&f->events)) {
+        mutex_unlock(&f->read_lock);
+        if (filp->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(motor.wq, !kfifo_is_empty(&f->events));
+        if (ret)
+            return ret;
+        mutex_lock(&f->read_lock);
+    }
+
+    ret = kfifo_to_user(&f->events, buf, count, &copied);
+    mutex_unlock(&f->read_lock);
+    return ret ? ret : copied;
+}
+
+static __poll_t step_motor_poll(struct file *filp, poll_table *wait)
+{
+    struct step_motor_file *f = filp->private_data;
+
+    poll_wait(filp, &motor.wq, wait);
+    return kfifo_is_empty(&f->events) ? 0 : EPOLLIN | EPOLLRDNORM;
 }
 
 static int step_motor_open(struct inode *inode, struct file *filp)
 {
+    struct step_motor_file *f;
+    unsigned long flags;
+
+    f = kzalloc(sizeof(*f), GFP_KERNEL);
+    if (!f)
+        return -ENOMEM;
+    INIT_KFIFO(f->events);
+    mutex_init(&f->read_lock);
+
+    spin_lock_irqsave(&motor.lock, flags);
+    list_add_tail(&f->node, &motor.files);
+    spin_unlock_irqrestore(&motor.lock, flags);
+    filp->private_data = f;
+
     printk(KERN_INFO "Step motor device opened\n");
     return 0;
 }
 
 static int step_motor_release(struct inode *inode, struct file *filp)
 {
+    struct step_motor_file *f = filp->private_data;
+    unsigned long flags;
+
+    spin_lock_irqsave(&motor.lock, flags);
+    list_del(&f->node);
+    spin_unlock_irqrestore(&motor.lock, flags);
+    if (f->efd)
+        eventfd_ctx_put(f->efd);
+    kfree(f);
+
     printk(KERN_INFO "Step motor device closed\n");
     return 0;
 }
@@ -61,6 +532,8 @@ static struct file_operations step_motor_fops = {
     .owner = THIS_MODULE,
     .open = step_motor_open,
     .release = step_motor_release,
+    .read = step_motor_read,
+    .poll = step_motor_poll,
     .unlocked_ioctl = step_motor_ioctl,
 };
 
@@ -108,6 +581,23 @@ static int __init step_motor_init(void)
     gpio_direction_output(GPIO_MOTOR_B, 0);
     gpio_direction_output(GPIO_MOTOR_C, 0);
     gpio_direction_output(GPIO_MOTOR_D, 0);
+
+    // 内核运动：四相描述符用于一次性写入，全部不会睡眠时才能在hrtimer里用
+    motor.desc[0] = gpio_to_desc(GPIO_MOTOR_A);
+    motor.desc[1] = gpio_to_desc(GPIO_MOTOR_B);
+    motor.desc[2] = gpio_to_desc(GPIO_MOTOR_C);
+    motor.desc[3] = gpio_to_desc(GPIO_MOTOR_D);
+    motor.atomic_ok = !gpiod_cansleep(motor.desc[0]) && !gpiod_cansleep(motor.desc[1]) &&
+                      !gpiod_cansleep(motor.desc[2]) && !gpiod_cansleep(motor.desc[3]);
+    if (!motor.atomic_ok)
+        printk(KERN_WARNING "Step motor GPIOs may sleep, MOVE disabled\n");
+    spin_lock_init(&motor.lock);
+    mutex_init(&motor.ctl_lock);
+    init_waitqueue_head(&motor.wq);
+    INIT_KFIFO(motor.queue);
+    INIT_LIST_HEAD(&motor.files);
+    hrtimer_init(&motor.timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_HARD);
+    motor.timer.function = step_motor_timer;
     
     // 注册misc设备
     ret = misc_register(&step_motor_dev);
@@ -126,15 +616,19 @@ static int __init step_motor_init(void)
 
 static void __exit step_motor_exit(void)
 {
+    unsigned long off = 0;
+
+    // 先注销设备，不再有新的运动，再停掉进行中的运动并断电
+    misc_deregister(&step_motor_dev);
+    hrtimer_cancel(&motor.timer);
+    gpiod_set_array_value_cansleep(STEP_MOTOR_PHASES, motor.desc, NULL, &off);
+
     // 释放GPIO资源
     gpio_free(GPIO_MOTOR_A);
     gpio_free(GPIO_MOTOR_B);
     gpio_free(GPIO_MOTOR_C);
     gpio_free(GPIO_MOTOR_D);
     
-    // 注销设备
-    misc_deregister(&step_motor_dev);
-    
     printk(KERN_INFO "Step motor driver removed\n");
 }
 
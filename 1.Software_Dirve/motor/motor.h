@@ -0,0 +1,87 @@
+/*
+ * 28BYJ-48 步进电机驱动与应用程序共用的ioctl定义
+ */
+#ifndef __MOTOR_H
+#define __MOTOR_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/* 单独设置A/B/C/D相，arg为0/1；内核运动进行中返回EBUSY，不计入绝对位置 */
+#define CMD_STEPMOTOR_A _IOW('L', 0, unsigned long)
+#define CMD_STEPMOTOR_B _IOW('L', 1, unsigned long)
+#define CMD_STEPMOTOR_C _IOW('L', 2, unsigned long)
+#define CMD_STEPMOTOR_D _IOW('L', 3, unsigned long)
+
+/*
+ * 内核运动：半步序列 A-AB-B-BC-C-CD-D-DA 由hrtimer驱动，四相一次写入。
+ * 梯形速度曲线：从静止以accel加速到max_speed，匀速，再以accel减速到停止；
+ * 步数不够时为三角形曲线。accel为0时全程max_speed。
+ * 走完后保持最后一相一个步距，队列里还有段就接着走下一段(每段都从静止加速)，
+ * 否则断电(或按 HOLD 保持)。ioctl立即返回，段号写回 id，
+ * 结束时通过 read()/poll() 和 eventfd 通知，也可以用 WAIT 阻塞等待。
+ */
+struct step_motor_move {
+    __u32 steps;        /* 半步数，28BYJ-48输出轴一圈约4076 */
+    __u32 direction;    /* 1 顺时针，0 逆时针 */
+    __u32 max_speed;    /* 半步/秒，1 ~ STEP_MOTOR_MAX_SPEED */
+    __u32 accel;        /* 半步/秒^2，0为不加减速 */
+    __u32 id;           /* 输出：段号，从1递增，完成事件里带回 */
+};
+
+#define STEP_MOTOR_MAX_SPEED    2000
+/* 排队等待的段数上限(不含正在走的段)，满了 MOVE 返回ENOSPC */
+#define STEP_MOTOR_QUEUE_LEN    16
+
+struct step_motor_status {
+    __u32 running;
+    __u32 steps_done;   /* 当前段已走的步数 */
+    __u32 steps_total;
+    __u32 speed;        /* 当前速度，半步/秒 */
+    __u32 late_max_ns;  /* 从静止启动以来hrtimer回调相对计划时刻的最大延迟 */
+    __u32 late_avg_ns;  /* 平均延迟 */
+    __s32 position;     /* 绝对位置，半步，顺时针为正 */
+    __u32 seg_id;       /* 正在走的段号 */
+    __u32 queued;       /* 排队中的段数 */
+    __u32 hold;         /* 停止后是否保持通电 */
+};
+
+/*
+ * 段结束事件，每个打开的文件各有一份缓冲，read() 一次返回整数条，
+ * 有事件可读时 poll() 返回POLLIN；设置了eventfd的文件每个事件再加1。
+ */
+struct step_motor_event {
+    __u64 timestamp_ns;     /* 事件时刻，CLOCK_MONOTONIC */
+    __u32 id;               /* 段号 */
+    __u32 steps_done;       /* 本段实际走的步数，未开始就被取消的段为0 */
+    __s32 position;         /* 事件时刻的绝对位置 */
+    __u32 flags;            /* STEP_MOTOR_EV_* */
+};
+
+/* 本段走完 */
+#define STEP_MOTOR_EV_DONE      0x01
+/* 本段被 STOP 取消 */
+#define STEP_MOTOR_EV_CANCELLED 0x02
+/* 本事件之前有事件因缓冲区满被丢弃 */
+#define STEP_MOTOR_EV_OVERFLOW  0x04
+
+#define STEP_MOTOR_EVENT_BUF    32
+
+/* STOP 的参数 */
+#define STEP_MOTOR_STOP_DECEL   0   /* 按本段加速度减速停下，accel为0时同 NOW */
+#define STEP_MOTOR_STOP_NOW     1   /* 立即停止 */
+
+#define CMD_STEPMOTOR_MOVE      _IOWR('L', 4, struct step_motor_move)
+/* 阻塞到队列里所有段走完 */
+#define CMD_STEPMOTOR_WAIT      _IO('L', 5)
+#define CMD_STEPMOTOR_STATUS    _IOR('L', 6, struct step_motor_status)
+/* 取消当前段并清空队列，arg为 STEP_MOTOR_STOP_* */
+#define CMD_STEPMOTOR_STOP      _IOW('L', 7, __u32)
+/* arg非0：停止后保持最后一相通电，防止负载反拖；0：断电(默认，省电不发热) */
+#define CMD_STEPMOTOR_HOLD      _IOW('L', 8, __u32)
+/* 设置当前绝对位置(回零后设0)，运动中返回EBUSY */
+#define CMD_STEPMOTOR_SET_POSITION _IOW('L', 9, __s32)
+/* 本文件的事件同时通知给eventfd，arg为eventfd描述符，-1取消 */
+#define CMD_STEPMOTOR_SET_EVENTFD  _IOW('L', 10, __s32)
+
+#endif /* __MOTOR_H */
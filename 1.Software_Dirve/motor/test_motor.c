@@ -6,11 +6,9 @@
 #include <sys/ioctl.h>
 #include <string.h>
 #include <stdlib.h>
+#include <poll.h>
 
-#define CMD_STEPMOTOR_A _IOW('L', 0, unsigned long)
-#define CMD_STEPMOTOR_B _IOW('L', 1, unsigned long)
-#define CMD_STEPMOTOR_C _IOW('L', 2, unsigned long)
-#define CMD_STEPMOTOR_D _IOW('L', 3, unsigned long)
+#include "motor.h"
 
 #define HIGH 1
 #define LOW 0
@@ -93,17 +91,99 @@ void step_motor_num(int direction, unsigned long steps, unsigned long speed) {
     }
 }
 
+/* 内核运动：一次ioctl交给hrtimer走完，再等待结束 */
+int step_motor_move(int direction, unsigned long steps, unsigned long speed,
+                    unsigned long accel) {
+    struct step_motor_move m;
+    struct step_motor_status st;
+
+    m.steps = steps;
+    m.direction = direction;
+    m.max_speed = speed ? 1000000 / speed : 0;
+    m.accel = accel;
+    if (ioctl(fd, CMD_STEPMOTOR_MOVE, &m) < 0 || ioctl(fd, CMD_STEPMOTOR_WAIT) < 0) {
+        perror("CMD_STEPMOTOR_MOVE");
+        return -1;
+    }
+    if (ioctl(fd, CMD_STEPMOTOR_STATUS, &st) == 0)
+        printf("Done %u/%u steps, position %d, timer late avg %u ns, max %u ns\n",
+               st.steps_done, st.steps_total, st.position, st.late_avg_ns, st.late_max_ns);
+    return 0;
+}
+
+/* 多段排队：全部交给内核，poll等完成事件，不阻塞在ioctl里 */
+int step_motor_sequence(int argc, char *argv[]) {
+    struct step_motor_move m;
+    struct step_motor_event ev[8];
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    unsigned long accel = atol(argv[0]), speed = atol(argv[1]);
+    unsigned int last = 0;
+    int i, n;
+    long steps;
+
+    for (i = 2; i < argc; i++) {
+        steps = atol(argv[i]);
+        m.steps = labs(steps);
+        m.direction = steps > 0;
+        m.max_speed = speed ? 1000000 / speed : 0;
+        m.accel = accel;
+        if (ioctl(fd, CMD_STEPMOTOR_MOVE, &m) < 0) {
+            perror("CMD_STEPMOTOR_MOVE");
+            ioctl(fd, CMD_STEPMOTOR_STOP, STEP_MOTOR_STOP_NOW);
+            return -1;
+        }
+        printf("Queued segment %u: %ld steps\n", m.id, steps);
+        last = m.id;
+    }
+
+    while (1) {
+        if (poll(&pfd, 1, -1) < 0) {
+            perror("poll");
+            return -1;
+        }
+        n = read(fd, ev, sizeof(ev));
+        if (n < 0)
+            continue;
+        for (i = 0; i < n / (int)sizeof(ev[0]); i++) {
+            printf("Segment %u %s: %u steps, position %d%s\n", ev[i].id,
+                   ev[i].flags & STEP_MOTOR_EV_CANCELLED ? "cancelled" : "done",
+                   ev[i].steps_done, ev[i].position,
+                   ev[i].flags & STEP_MOTOR_EV_OVERFLOW ? " (events lost)" : "");
+            if (ev[i].id == last)
+                return 0;
+        }
+    }
+}
+
 int main(int argc, char *argv[]) {
     char *step_motor = "/dev/step_motor";
     int direction;
     unsigned long steps, speed;
     
+    if(argc > 4 && !strcmp(argv[1], "-s")) {
+        if((fd = open(step_motor, O_RDWR | O_NONBLOCK)) < 0) {
+            printf("Failed to open %s\n", step_motor);
+            return -1;
+        }
+        if (step_motor_sequence(argc - 2, argv + 2) < 0) {
+            close(fd);
+            return -1;
+        }
+        close(fd);
+        return 0;
+    }
+
     if(argc < 4) {
-        printf("Usage: %s <direction> <steps> <speed>\n", argv[0]);
+        printf("Usage: %s <direction> <steps> <speed> [accel]\n", argv[0]);
+        printf("       %s -s <accel> <speed> <steps> [steps ...]\n", argv[0]);
         printf("Direction: 1 (CW) or 0 (CCW)\n");
         printf("Steps: number of steps to move\n");
         printf("Speed: delay between steps in microseconds (3000-20000)\n");
+        printf("Accel: steps/s^2, run the move in the kernel (0 = constant speed)\n");
         printf("Example: %s 1 4076 3080\n", argv[0]);
+        printf("Example: %s 1 4076 1000 1500\n", argv[0]);
+        printf("Sequence: queue segments in the kernel, negative steps = CCW\n");
+        printf("Example: %s -s 1500 1000 2038 -1019 1019\n", argv[0]);
         return 1;
     }
     
@@ -119,7 +199,14 @@ int main(int argc, char *argv[]) {
     printf("Moving motor: Direction=%s, Steps=%lu, Speed=%lu us/step\n",
            direction ? "CW" : "CCW", steps, speed);
     
-    step_motor_num(direction, steps, speed);
+    if (argc > 4) {
+        if (step_motor_move(direction, steps, speed, atol(argv[4])) < 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        step_motor_num(direction, steps, speed);
+    }
     
     close(fd);
     return 0;
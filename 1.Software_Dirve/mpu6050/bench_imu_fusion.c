@@ -0,0 +1,211 @@
+/*
+ * 姿态融合库的精度校验和性能测试，用合成的IMU数据，不需要硬件
+ *
+ * 编译：
+ *   riscv64-buildroot-linux-gnu-gcc -O2 -o bench_imu_fusion bench_imu_fusion.c imu_fusion.c -lm
+ *
+ * 校验(任何一项不通过返回非0)：
+ *   1. 静止倾斜30°横滚、-20°俯仰，从水平姿态开始，各滤波器收敛到1°以内
+ *   2. 水平放置绕Z轴90°/s转3秒，航向角积分误差小于1°
+ *   3. 定点Mahony与浮点Mahony全程偏差小于0.1°
+ * 性能：每个样本耗时，以及1kHz采样时占单核的百分比(目标远低于5%)。
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "imu_fusion.h"
+
+#define RATE_HZ			1000
+#define ACC_1G			16384
+#define BENCH_SAMPLES	(1 << 20)
+
+static double ts_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1e9 + ts->tv_nsec;
+}
+
+/* 小幅高斯噪声，约为MPU6050手册给出的噪声密度在1kHz下的量级 */
+static int16_t noisy(double v, double sigma)
+{
+	double u1 = (rand() + 1.0) / (RAND_MAX + 2.0), u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+	v += sigma * sqrt(-2.0 * log(u1)) * cos(2 * M_PI * u2);
+	return (int16_t)lrint(v);
+}
+
+/* 固定姿态下的静止样本，横滚roll、俯仰pitch(度) */
+static void make_tilt(struct mpu6050_sample *s, size_t n, double roll, double pitch)
+{
+	double r = roll * M_PI / 180, p = pitch * M_PI / 180;
+	size_t i;
+	int k;
+
+	for (i = 0; i < n; i++) {
+		memset(&s[i], 0, sizeof(s[i]));
+		s[i].timestamp_ns = (int64_t)i * 1000000;
+		s[i].accel[0] = noisy(-sin(p) * ACC_1G, 8);
+		s[i].accel[1] = noisy(sin(r) * cos(p) * ACC_1G, 8);
+		s[i].accel[2] = noisy(cos(r) * cos(p) * ACC_1G, 8);
+		for (k = 0; k < 3; k++)
+			s[i].gyro[k] = noisy(0, 4);
+	}
+}
+
+/* 水平放置，绕Z轴匀速转动 */
+static void make_yaw(struct mpu6050_sample *s, size_t n, double dps)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		memset(&s[i], 0, sizeof(s[i]));
+		s[i].accel[2] = ACC_1G;
+		s[i].gyro[2] = (int16_t)lrint(dps * IMU_GYRO_LSB_250DPS);
+	}
+}
+
+static float angle_diff(float a, float b)
+{
+	float d = fmodf(a - b + 540.0f, 360.0f) - 180.0f;
+	return fabsf(d);
+}
+
+/* 返回不通过的项数 */
+static int test_tilt(void)
+{
+	size_t n = 10 * RATE_HZ, i;
+	struct mpu6050_sample *s = malloc(n * sizeof(*s));
+	struct madgwick mw;
+	struct mahony mh;
+	struct mahony_q mq;
+	float q[4], r, p, y, r2, p2, y2, max_dev = 0;
+	int errors = 0, ok;
+
+	make_tilt(s, n, 30, -20);
+	madgwick_init(&mw, 0.1f, RATE_HZ, IMU_GYRO_LSB_250DPS);
+	mahony_init(&mh, 2.0f, 0.05f, RATE_HZ, IMU_GYRO_LSB_250DPS);
+	mahony_q_init(&mq, 2.0f, 0.05f, RATE_HZ, IMU_GYRO_LSB_250DPS);
+
+	for (i = 0; i < n; i++) {
+		mahony_update_batch(&mh, &s[i], 1);
+		mahony_q_update_batch(&mq, &s[i], 1);
+		imu_quat_to_euler(mh.q, &r, &p, &y);
+		mahony_q_get(&mq, q);
+		imu_quat_to_euler(q, &r2, &p2, &y2);
+		if (angle_diff(r, r2) > max_dev) max_dev = angle_diff(r, r2);
+		if (angle_diff(p, p2) > max_dev) max_dev = angle_diff(p, p2);
+	}
+	madgwick_update_batch(&mw, s, n);
+
+	/* 期望横滚30°、俯仰-20°，误差1°以内；定点与浮点偏差0.1°以内 */
+	printf("倾斜(期望 roll 30 pitch -20)\n");
+	imu_quat_to_euler(mw.q, &r, &p, &y);
+	ok = angle_diff(r, 30) < 1 && angle_diff(p, -20) < 1;
+	printf("  Madgwick   roll %.2f pitch %.2f%s\n", r, p, ok ? "" : "  没有收敛");
+	errors += !ok;
+	imu_quat_to_euler(mh.q, &r, &p, &y);
+	ok = angle_diff(r, 30) < 1 && angle_diff(p, -20) < 1;
+	printf("  Mahony     roll %.2f pitch %.2f%s\n", r, p, ok ? "" : "  没有收敛");
+	errors += !ok;
+	mahony_q_get(&mq, q);
+	imu_quat_to_euler(q, &r, &p, &y);
+	ok = angle_diff(r, 30) < 1 && angle_diff(p, -20) < 1 && max_dev < 0.1f;
+	printf("  Mahony定点 roll %.2f pitch %.2f，与浮点最大偏差 %.4f°%s\n", r, p, max_dev,
+		   ok ? "" : "  超差");
+	errors += !ok;
+	free(s);
+	return errors;
+}
+
+/* 返回不通过的项数 */
+static int test_yaw(void)
+{
+	size_t n = 3 * RATE_HZ;
+	struct mpu6050_sample *s = malloc(n * sizeof(*s));
+	struct madgwick mw;
+	struct mahony mh;
+	struct mahony_q mq;
+	float q[4], r, p, y1, y2, y3;
+	int ok;
+	/* 量化后的实际转速 */
+	float expect = fmodf(lrint(90 * IMU_GYRO_LSB_250DPS) / IMU_GYRO_LSB_250DPS * 3, 360.0f);
+
+	make_yaw(s, n, 90);
+	madgwick_init(&mw, 0.1f, RATE_HZ, IMU_GYRO_LSB_250DPS);
+	mahony_init(&mh, 2.0f, 0.05f, RATE_HZ, IMU_GYRO_LSB_250DPS);
+	mahony_q_init(&mq, 2.0f, 0.05f, RATE_HZ, IMU_GYRO_LSB_250DPS);
+	madgwick_update_batch(&mw, s, n);
+	mahony_update_batch(&mh, s, n);
+	mahony_q_update_batch(&mq, s, n);
+
+	imu_quat_to_euler(mw.q, &r, &p, &y1);
+	imu_quat_to_euler(mh.q, &r, &p, &y2);
+	mahony_q_get(&mq, q);
+	imu_quat_to_euler(q, &r, &p, &y3);
+	/* 陀螺积分的航向角误差1°以内 */
+	ok = angle_diff(y1, expect) < 1 && angle_diff(y2, expect) < 1 && angle_diff(y3, expect) < 1;
+	printf("航向(期望 %.2f) Madgwick %.2f Mahony %.2f 定点 %.2f%s\n",
+		   expect, y1, y2, y3, ok ? "" : "  超差");
+	free(s);
+	return !ok;
+}
+
+/* 返回1kHz下占单核超过5%的滤波器个数 */
+static int bench(const struct mpu6050_sample *s, size_t n)
+{
+	struct madgwick mw;
+	struct mahony mh;
+	struct mahony_q mq;
+	struct timespec t[4];
+	double ns[3];
+	int i, errors = 0;
+
+	madgwick_init(&mw, 0.1f, RATE_HZ, IMU_GYRO_LSB_250DPS);
+	mahony_init(&mh, 2.0f, 0.05f, RATE_HZ, IMU_GYRO_LSB_250DPS);
+	mahony_q_init(&mq, 2.0f, 0.05f, RATE_HZ, IMU_GYRO_LSB_250DPS);
+
+	clock_gettime(CLOCK_MONOTONIC, &t[0]);
+	madgwick_update_batch(&mw, s, n);
+	clock_gettime(CLOCK_MONOTONIC, &t[1]);
+	mahony_update_batch(&mh, s, n);
+	clock_gettime(CLOCK_MONOTONIC, &t[2]);
+	mahony_q_update_batch(&mq, s, n);
+	clock_gettime(CLOCK_MONOTONIC, &t[3]);
+	for (i = 0; i < 3; i++) {
+		ns[i] = (ts_ns(&t[i + 1]) - ts_ns(&t[i])) / n;
+		errors += ns[i] * RATE_HZ / 1e7 >= 5;
+	}
+
+	/* 防止结果被优化掉 */
+	if (mw.q[0] + mh.q[0] + mq.q[0] == 12345.0f)
+		printf("\n");
+
+	printf("\n样本数 %zu\n", n);
+	printf("Madgwick浮点: %7.1f ns/样本, 1kHz占单核 %.4f%%\n", ns[0], ns[0] * RATE_HZ / 1e7);
+	printf("Mahony浮点:   %7.1f ns/样本, 1kHz占单核 %.4f%%\n", ns[1], ns[1] * RATE_HZ / 1e7);
+	printf("Mahony定点:   %7.1f ns/样本, 1kHz占单核 %.4f%%\n", ns[2], ns[2] * RATE_HZ / 1e7);
+	return errors;
+}
+
+int main(void)
+{
+	struct mpu6050_sample *s = malloc(BENCH_SAMPLES * sizeof(*s));
+	int errors;
+
+	if (!s) {
+		perror("malloc");
+		return 1;
+	}
+	srand(1);
+	errors = test_tilt();
+	errors += test_yaw();
+
+	make_tilt(s, BENCH_SAMPLES, 10, 5);
+	errors += bench(s, BENCH_SAMPLES);
+	free(s);
+	if (errors)
+		printf("\n%d 项校验不通过\n", errors);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * MPU6050 记录读取方式对比：read() 拷贝 与 mmap共享环形缓冲
+ *
+ * 编译：
+ *   riscv64-buildroot-linux-gnu-gcc -O2 -o bench_mpu6050_ring bench_mpu6050_ring.c
+ *
+ * 用法：
+ *   ./bench_mpu6050_ring [每项秒数] [设备，默认/dev/mpu6050-0]
+ * 依次测试 1kHz 全部通道、4kHz 只有加速度 两种FIFO配置，每种配置分别用
+ * read() 和 mmap 环形缓冲取数据，统计本进程的CPU时间(用户态+内核态)、
+ * 每条记录的CPU开销、实际收到的记录数和丢失标记。
+ * 驱动排空芯片FIFO的工作队列不算在本进程里，两种方式这部分开销相同。
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "mpu6050i2c.h"
+
+struct result {
+	long records;
+	long overflows;
+	long wakeups;
+	long disorder;			/* 时间戳倒退的次数，应为0 */
+	double cpu_us;
+	double wall_us;
+};
+
+static double tv_us(const struct timeval *tv)
+{
+	return tv->tv_sec * 1e6 + tv->tv_usec;
+}
+
+static double ts_us(const struct timespec *ts)
+{
+	return ts->tv_sec * 1e6 + ts->tv_nsec / 1e3;
+}
+
+static void account(struct result *r, const struct mpu6050_sample *s, int64_t *last_ts)
+{
+	if (s->flags & MPU6050_SAMPLE_OVERFLOW)
+		r->overflows++;
+	if (s->timestamp_ns < *last_ts)
+		r->disorder++;
+	*last_ts = s->timestamp_ns;
+	r->records++;
+}
+
+/* 每次唤醒后用一次 read() 尽量多取记录 */
+static void run_read(int fd, double secs, struct result *r)
+{
+	static struct mpu6050_sample buf[256];
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	struct timespec now, end;
+	int64_t last_ts = 0;
+	ssize_t ret;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	end = now;
+	end.tv_sec += (time_t)secs;
+	do {
+		if (poll(&pfd, 1, 1000) <= 0)
+			break;
+		r->wakeups++;
+		ret = read(fd, buf, sizeof(buf));
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			perror("read");
+			break;
+		}
+		for (i = 0; i < ret / (ssize_t)sizeof(buf[0]); i++)
+			account(r, &buf[i], &last_ts);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while (ts_us(&now) < ts_us(&end));
+}
+
+/* 环形缓冲为空时才poll，有数据时直接在共享内存上处理，不进内核 */
+static void run_ring(int fd, struct mpu6050_ring *ring, double secs, struct result *r)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	struct timespec now, end;
+	int64_t last_ts = 0;
+	uint32_t head, tail;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	end = now;
+	end.tv_sec += (time_t)secs;
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+	do {
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			if (poll(&pfd, 1, 1000) <= 0)
+				break;
+			r->wakeups++;
+			continue;
+		}
+		while (tail != head) {
+			account(r, &ring->rec[tail & (ring->slots - 1)], &last_ts);
+			tail++;
+		}
+		/* 记录读完后才交还槽位 */
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while (ts_us(&now) < ts_us(&end));
+}
+
+static int bench(int fd, struct mpu6050_ring *ring, unsigned int rate, uint8_t mask,
+				 int use_ring, double secs)
+{
+	struct mpu6050_fifo_config cfg = { .rate_hz = rate, .mask = mask };
+	struct result r;
+	struct rusage ru0, ru1;
+	struct timespec t0, t1;
+	__u32 on = use_ring;
+
+	memset(&r, 0, sizeof(r));
+	if (ioctl(fd, MPU6050_IOC_SET_RING, &on) < 0) {
+		perror("设置环形缓冲失败");
+		return -1;
+	}
+	if (ioctl(fd, MPU6050_IOC_SET_FIFO, &cfg) < 0) {
+		perror("设置FIFO失败");
+		return -1;
+	}
+
+	getrusage(RUSAGE_SELF, &ru0);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	if (use_ring)
+		run_ring(fd, ring, secs, &r);
+	else
+		run_read(fd, secs, &r);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	getrusage(RUSAGE_SELF, &ru1);
+
+	cfg.mask = 0;
+	ioctl(fd, MPU6050_IOC_SET_FIFO, &cfg);
+
+	r.cpu_us = (tv_us(&ru1.ru_stime) - tv_us(&ru0.ru_stime)) +
+			   (tv_us(&ru1.ru_utime) - tv_us(&ru0.ru_utime));
+	r.wall_us = ts_us(&t1) - ts_us(&t0);
+
+	printf("%-6s %5uHz mask 0x%02x: 记录 %7ld (期望约 %7.0f) 溢出标记 %ld 乱序 %ld 唤醒 %ld",
+		   use_ring ? "mmap" : "read", rate, mask, r.records, r.wall_us * rate / 1e6,
+		   use_ring ? (long)ring->lost : r.overflows, r.disorder, r.wakeups);
+	printf("  CPU %.2f%%  %.2f us/条\n", 100.0 * r.cpu_us / r.wall_us,
+		   r.records ? r.cpu_us / r.records : 0.0);
+	return r.disorder ? 1 : 0;
+}
+
+/*
+ * @description		: main主程序
+ * @param - argc 	: argv数组元素个数
+ * @param - argv 	: 具体参数
+ * @return 			: 0 成功;其他 失败
+ */
+int main(int argc, char *argv[])
+{
+	double secs = argc > 1 ? atof(argv[1]) : 5;
+	const char *devname = argc > 2 ? argv[2] : "/dev/mpu6050-0";
+	struct mpu6050_ring *ring;
+	__u32 off = 0;
+	int fd, ret = 0;
+
+	if (secs < 1) {
+		printf("Usage: %s [seconds] [device]\n", argv[0]);
+		return 1;
+	}
+
+	fd = open(devname, O_RDWR);
+	if (fd < 0) {
+		perror("设备打开失败");
+		return -1;
+	}
+	ring = mmap(NULL, MPU6050_RING_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED) {
+		perror("mmap失败");
+		close(fd);
+		return -1;
+	}
+
+	ret |= bench(fd, ring, 1000, MPU6050_FIFO_ALL, 0, secs);
+	ret |= bench(fd, ring, 1000, MPU6050_FIFO_ALL, 1, secs);
+	ret |= bench(fd, ring, 4000, MPU6050_FIFO_ACCEL, 0, secs);
+	ret |= bench(fd, ring, 4000, MPU6050_FIFO_ACCEL, 1, secs);
+
+	ioctl(fd, MPU6050_IOC_SET_RING, &off);
+	munmap(ring, MPU6050_RING_BYTES);
+	close(fd);
+	return ret ? 2 : 0;
+}
@@ -0,0 +1,320 @@
+/*
+ * 振动频谱库的精度校验和性能测试，用合成的加速度数据，不需要硬件
+ *
+ * 编译：
+ *   riscv64-buildroot-linux-gnu-gcc -O2 -o bench_vib_spectrum bench_vib_spectrum.c vib_spectrum.c -lm
+ *
+ * 校验(任何一项不通过返回非0)：
+ *   1. 实数FFT与双精度直接DFT逐点比较，误差小于幅度峰值的1e-4
+ *   2. 0.5g、37.3Hz正弦叠加1g重力，频带能量等于 A^2/2(误差<2%)，峰值频率误差小于一个频点
+ *   3. 12Hz 0.2g + 80Hz 0.1g 双音，各自频带能量误差<2%，中间空频带泄漏小于1e-3
+ *   4. 0.05g白噪声，各频带能量之和(总RMS)与噪声标准差误差<3%
+ *   5. 样本流中有溢出标记时重新攒帧，仍按时输出报告
+ * 性能：1kHz三轴、512点50%重叠下每个样本的耗时和占单核百分比，
+ *       以及不同点数单次实数FFT的耗时。
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vib_spectrum.h"
+
+#define RATE_HZ			1000
+#define ACC_1G			16384
+#define BENCH_SECONDS	600
+
+static double ts_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1e9 + ts->tv_nsec;
+}
+
+static double gauss(double sigma)
+{
+	double u1 = (rand() + 1.0) / (RAND_MAX + 2.0), u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+	return sigma * sqrt(-2.0 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static int16_t lsb(double g)
+{
+	return (int16_t)lrint(g * ACC_1G);
+}
+
+/* 保存最后一次报告，psd 指向库内部缓冲 */
+struct capture {
+	struct vib_report last;
+	unsigned int reports;
+};
+
+static void on_report(void *ctx, const struct vib_report *r)
+{
+	struct capture *c = ctx;
+
+	c->last = *r;
+	c->reports++;
+}
+
+static float rel_err(float v, float expect)
+{
+	return fabsf(v - expect) / expect;
+}
+
+/* 以下 test_* 返回不通过的项数 */
+static int test_fft(unsigned int n)
+{
+	struct vib_fft f;
+	float *x = malloc(n * sizeof(float));
+	float *re = malloc((n / 2 + 1) * sizeof(float)), *im = malloc((n / 2 + 1) * sizeof(float));
+	double err = 0, peak = 0;
+	unsigned int i, k;
+
+	if (vib_fft_init(&f, n)) {
+		printf("%u点 vib_fft_init 失败\n", n);
+		free(x);
+		free(re);
+		free(im);
+		return 1;
+	}
+	for (i = 0; i < n; i++)
+		x[i] = (float)(gauss(1.0) + 0.3 * sin(2 * M_PI * 5.5 * i / n));
+	vib_fft_real(&f, x, re, im);
+
+	for (k = 0; k <= n / 2; k++) {
+		double sr = 0, si = 0, d;
+
+		for (i = 0; i < n; i++) {
+			sr += x[i] * cos(2 * M_PI * (double)k * i / n);
+			si -= x[i] * sin(2 * M_PI * (double)k * i / n);
+		}
+		d = hypot(re[k] - sr, im[k] - si);
+		if (d > err)
+			err = d;
+		if (hypot(sr, si) > peak)
+			peak = hypot(sr, si);
+	}
+	/* 与直接DFT的误差小于幅度峰值的1e-4 */
+	printf("%u点实数FFT与直接DFT相对误差 %.2e%s\n", n, err / peak,
+		   err / peak < 1e-4 ? "" : "  超差");
+	vib_fft_free(&f);
+	free(x);
+	free(re);
+	free(im);
+	return err / peak >= 1e-4;
+}
+
+/* seconds 秒的合成数据，z轴带1g重力；tone: {频率Hz, 幅度g} 列表，noise 为各轴噪声g */
+static struct mpu6050_sample *make_signal(size_t n, const double (*tone)[2], int nr_tone,
+										  double noise)
+{
+	struct mpu6050_sample *s = calloc(n, sizeof(*s));
+	size_t i;
+	int k;
+
+	for (i = 0; i < n; i++) {
+		double t = (double)i / RATE_HZ, v = 0;
+
+		for (k = 0; k < nr_tone; k++)
+			v += tone[k][1] * sin(2 * M_PI * tone[k][0] * t);
+		s[i].timestamp_ns = (int64_t)i * 1000000;
+		s[i].accel[0] = lsb(v + gauss(noise));
+		s[i].accel[1] = lsb(0.5 * v + gauss(noise));
+		s[i].accel[2] = lsb(1.0 + v + gauss(noise));
+	}
+	return s;
+}
+
+static int test_sine(void)
+{
+	static const double tone[][2] = { { 37.3, 0.5 } };
+	static const struct vib_band bands[] = { { 30, 45 } };
+	size_t n = 2 * RATE_HZ;
+	struct mpu6050_sample *s = make_signal(n, tone, 1, 0);
+	struct vib_psd p;
+	struct capture c;
+	float expect = 0.5f * 0.5f / 2;
+	int errors = 0;
+
+	memset(&c, 0, sizeof(c));
+	vib_psd_init(&p, RATE_HZ, 512, 256, 1, ACC_1G, on_report, &c);
+	vib_psd_set_bands(&p, bands, 1);
+	vib_psd_push(&p, s, n);
+
+	/*
+	 * 每秒一次报告；频带能量 A^2/2 误差2%以内(Y轴幅度减半)；
+	 * 峰值误差小于一个频点；重力(直流)不计入RMS
+	 */
+	printf("正弦: %u 次报告(期望 2), %u 帧/秒, 频带能量 X %.5f Z %.5f g^2(期望 %.5f)\n",
+		   c.reports, c.last.frames, c.last.band[0][0], c.last.band[0][2], expect);
+	printf("      峰值 %.2fHz(期望 37.30±%.2f), Z轴RMS %.4f g(期望 %.4f)\n",
+		   c.last.peak_hz[2], c.last.df, c.last.rms[2], 0.5f / sqrtf(2));
+	if (c.reports != 2)
+		errors++;
+	if (rel_err(c.last.band[0][0], expect) >= 0.02 ||
+		rel_err(c.last.band[0][1], expect / 4) >= 0.02 ||
+		rel_err(c.last.band[0][2], expect) >= 0.02)
+		errors++;
+	if (fabsf(c.last.peak_hz[2] - 37.3f) >= c.last.df)
+		errors++;
+	if (rel_err(c.last.rms[2], 0.5f / sqrtf(2)) >= 0.01)
+		errors++;
+	vib_psd_free(&p);
+	free(s);
+	return errors;
+}
+
+static int test_two_tone(void)
+{
+	static const double tone[][2] = { { 12, 0.2 }, { 80, 0.1 } };
+	static const struct vib_band bands[] = { { 5, 20 }, { 30, 60 }, { 70, 90 } };
+	size_t n = 3 * RATE_HZ;
+	struct mpu6050_sample *s = make_signal(n, tone, 2, 0);
+	struct vib_psd p;
+	struct capture c;
+	int errors = 0;
+
+	memset(&c, 0, sizeof(c));
+	vib_psd_init(&p, RATE_HZ, 512, 256, 1, ACC_1G, on_report, &c);
+	vib_psd_set_bands(&p, bands, 3);
+	vib_psd_push(&p, s, n);
+
+	/* 各自频带能量误差2%以内，中间空频带泄漏小于1e-3 */
+	printf("双音: 5~20Hz %.5f(期望 0.02000)  30~60Hz %.2e(上限 %.2e)  70~90Hz %.5f(期望 0.00500) g^2\n",
+		   c.last.band[0][0], c.last.band[1][0], 1e-3f * 0.005f, c.last.band[2][0]);
+	if (rel_err(c.last.band[0][0], 0.02f) >= 0.02 || rel_err(c.last.band[2][0], 0.005f) >= 0.02)
+		errors++;
+	if (c.last.band[1][0] >= 1e-3f * 0.005f)
+		errors++;
+	vib_psd_free(&p);
+	free(s);
+	return errors;
+}
+
+static int test_noise(void)
+{
+	static const struct vib_band bands[] = { { 0, 250 }, { 250, 501 } };
+	size_t n = 20 * RATE_HZ;
+	struct mpu6050_sample *s = make_signal(n, NULL, 0, 0.05);
+	struct vib_psd p;
+	struct capture c;
+	float sum;
+	int ok;
+
+	memset(&c, 0, sizeof(c));
+	/* 20秒平均一次，降低估计方差 */
+	vib_psd_init(&p, RATE_HZ, 512, 256, 0.05f, ACC_1G, on_report, &c);
+	vib_psd_set_bands(&p, bands, 2);
+	vib_psd_push(&p, s, n);
+
+	sum = c.last.band[0][0] + c.last.band[1][0];
+	/* 频带能量之和与RMS都应等于噪声方差，误差3%以内 */
+	ok = c.reports == 1 && rel_err(sqrtf(sum), 0.05f) < 0.03 && rel_err(c.last.rms[0], 0.05f) < 0.03;
+	printf("白噪声: %u 帧平均, 频带和 %.6f g^2(期望 0.002500), RMS %.4f g(期望 0.0500)%s\n",
+		   c.last.frames, sum, c.last.rms[0], ok ? "" : "  超差");
+	vib_psd_free(&p);
+	free(s);
+	return !ok;
+}
+
+static int test_overflow(void)
+{
+	static const double tone[][2] = { { 37.3, 0.5 } };
+	size_t n = 3 * RATE_HZ, i;
+	struct mpu6050_sample *s = make_signal(n, tone, 1, 0);
+	struct vib_psd p;
+	struct capture c;
+	int ok;
+
+	for (i = 300; i < n; i += 700)
+		s[i].flags |= MPU6050_SAMPLE_OVERFLOW;
+	memset(&c, 0, sizeof(c));
+	vib_psd_init(&p, RATE_HZ, 512, 256, 1, ACC_1G, on_report, &c);
+	vib_psd_push(&p, s, n);
+	/* 溢出后重新攒帧，仍然每秒一次报告 */
+	ok = c.reports == 3 && c.last.lost > 0 && c.last.frames > 0;
+	printf("溢出: %u 次报告(期望 3), 最后一次 %u 帧, 丢失标记 %u%s\n",
+		   c.reports, c.last.frames, c.last.lost, ok ? "" : "  没有重新攒帧");
+	vib_psd_free(&p);
+	free(s);
+	return !ok;
+}
+
+/* 返回不通过的项数 */
+static int bench(void)
+{
+	static const unsigned int sizes[] = { 256, 512, 1024, 4096 };
+	static const struct vib_band bands[] = {
+		{ 1, 5 }, { 5, 10 }, { 10, 20 }, { 20, 40 }, { 40, 80 }, { 80, 160 }, { 160, 500 },
+	};
+	static const double tone[][2] = { { 14, 0.05 }, { 120, 0.02 } };
+	size_t n = (size_t)BENCH_SECONDS * RATE_HZ;
+	struct mpu6050_sample *s = make_signal(n, tone, 2, 0.02);
+	float *x, *re, *im;
+	struct vib_psd p;
+	struct capture c;
+	struct vib_fft f;
+	struct timespec t0, t1;
+	double ns, pct;
+	unsigned int i, k, loops;
+
+	memset(&c, 0, sizeof(c));
+	vib_psd_init(&p, RATE_HZ, 512, 256, 1, ACC_1G, on_report, &c);
+	vib_psd_set_bands(&p, bands, sizeof(bands) / sizeof(bands[0]));
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	vib_psd_push(&p, s, n);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ns = (ts_ns(&t1) - ts_ns(&t0)) / n;
+	pct = ns * RATE_HZ / 1e7;
+	vib_psd_free(&p);
+	free(s);
+
+	printf("\n%d 秒1kHz三轴数据, 512点FFT, 50%%重叠, %zu 帧, %u 次报告\n",
+		   BENCH_SECONDS, n / 256, c.reports);
+	printf("Welch PSD: %7.1f ns/样本, 1kHz占单核 %.4f%%\n", ns, pct);
+
+	for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+		vib_fft_init(&f, sizes[k]);
+		x = malloc(sizes[k] * sizeof(float));
+		re = malloc((sizes[k] / 2 + 1) * sizeof(float));
+		im = malloc((sizes[k] / 2 + 1) * sizeof(float));
+		for (i = 0; i < sizes[k]; i++)
+			x[i] = (float)gauss(1);
+		loops = (1 << 22) / sizes[k];
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (i = 0; i < loops; i++) {
+			x[0] = (float)i;
+			vib_fft_real(&f, x, re, im);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		ns = (ts_ns(&t1) - ts_ns(&t0)) / loops;
+		/* 防止结果被优化掉 */
+		if (re[1] == 12345.0f)
+			printf("\n");
+		printf("%4u点实数FFT: %8.1f ns/次, %5.2f ns/点\n", sizes[k], ns, ns / sizes[k]);
+		vib_fft_free(&f);
+		free(x);
+		free(re);
+		free(im);
+	}
+	/* 每秒一次报告，1kHz下占用低于单核5% */
+	return c.reports != BENCH_SECONDS || pct >= 5;
+}
+
+int main(void)
+{
+	int errors;
+
+	srand(1);
+	errors = test_fft(64);
+	errors += test_fft(512);
+	errors += test_fft(4096);
+	errors += test_sine();
+	errors += test_two_tone();
+	errors += test_noise();
+	errors += test_overflow();
+	errors += bench();
+	if (errors)
+		printf("\n%d 项校验不通过\n", errors);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,288 @@
+/*
+ * MPU6050 姿态融合库，说明见 imu_fusion.h
+ *
+ * 编译：
+ *   riscv64-buildroot-linux-gnu-gcc -O2 -c imu_fusion.c
+ *
+ * 浮点版参考 S.Madgwick 的 MadgwickAHRS/MahonyAHRS 六轴实现，
+ * 归一化用 1/sqrtf，RV64GC 上是单条 fsqrt.s，不需要快速平方根倒数的技巧。
+ */
+#include <math.h>
+
+#include "imu_fusion.h"
+
+#define DEG_TO_RAD		0.01745329252f
+#define RAD_TO_DEG		57.2957795131f
+#define Q30_ONE			(1 << 30)
+
+static float inv_norm3(float x, float y, float z)
+{
+	return 1.0f / sqrtf(x * x + y * y + z * z);
+}
+
+static void quat_normalize(float q[4])
+{
+	float r = 1.0f / sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+
+	q[0] *= r;
+	q[1] *= r;
+	q[2] *= r;
+	q[3] *= r;
+}
+
+static void raw_to_float(const struct mpu6050_sample *s, float scale, float g[3], float a[3])
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		g[i] = s->gyro[i] * scale;
+		a[i] = s->accel[i];
+	}
+}
+
+/*************************** Madgwick ***************************/
+
+void madgwick_init(struct madgwick *f, float beta, float sample_hz, float gyro_lsb)
+{
+	f->q[0] = 1.0f;
+	f->q[1] = f->q[2] = f->q[3] = 0.0f;
+	f->beta = beta;
+	f->dt = 1.0f / sample_hz;
+	f->gyro_scale = DEG_TO_RAD / gyro_lsb;
+}
+
+void madgwick_update(struct madgwick *f, const float g[3], const float a[3])
+{
+	float q0 = f->q[0], q1 = f->q[1], q2 = f->q[2], q3 = f->q[3];
+	float qd0, qd1, qd2, qd3;
+
+	/* 陀螺积分得到的四元数导数 */
+	qd0 = 0.5f * (-q1 * g[0] - q2 * g[1] - q3 * g[2]);
+	qd1 = 0.5f * (q0 * g[0] + q2 * g[2] - q3 * g[1]);
+	qd2 = 0.5f * (q0 * g[1] - q1 * g[2] + q3 * g[0]);
+	qd3 = 0.5f * (q0 * g[2] + q1 * g[1] - q2 * g[0]);
+
+	/* 加速度有效时沿目标函数梯度方向修正 */
+	if (a[0] != 0.0f || a[1] != 0.0f || a[2] != 0.0f) {
+		float r = inv_norm3(a[0], a[1], a[2]);
+		float ax = a[0] * r, ay = a[1] * r, az = a[2] * r;
+		float _2q0 = 2.0f * q0, _2q1 = 2.0f * q1, _2q2 = 2.0f * q2, _2q3 = 2.0f * q3;
+		float _4q0 = 4.0f * q0, _4q1 = 4.0f * q1, _4q2 = 4.0f * q2;
+		float _8q1 = 8.0f * q1, _8q2 = 8.0f * q2;
+		float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+		float s0, s1, s2, s3, sn;
+
+		s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+		s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 +
+			 _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+		s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 +
+			 _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+		s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+		sn = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+		/* 已经完全对准时梯度为0 */
+		if (sn > 0.0f) {
+			sn = f->beta / sqrtf(sn);
+			qd0 -= sn * s0;
+			qd1 -= sn * s1;
+			qd2 -= sn * s2;
+			qd3 -= sn * s3;
+		}
+	}
+
+	f->q[0] = q0 + qd0 * f->dt;
+	f->q[1] = q1 + qd1 * f->dt;
+	f->q[2] = q2 + qd2 * f->dt;
+	f->q[3] = q3 + qd3 * f->dt;
+	quat_normalize(f->q);
+}
+
+void madgwick_update_batch(struct madgwick *f, const struct mpu6050_sample *s, size_t n)
+{
+	float g[3], a[3];
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		raw_to_float(&s[i], f->gyro_scale, g, a);
+		madgwick_update(f, g, a);
+	}
+}
+
+/*************************** Mahony ***************************/
+
+void mahony_init(struct mahony *f, float kp, float ki, float sample_hz, float gyro_lsb)
+{
+	f->q[0] = 1.0f;
+	f->q[1] = f->q[2] = f->q[3] = 0.0f;
+	f->kp = kp;
+	f->ki = ki;
+	f->integral[0] = f->integral[1] = f->integral[2] = 0.0f;
+	f->dt = 1.0f / sample_hz;
+	f->gyro_scale = DEG_TO_RAD / gyro_lsb;
+}
+
+void mahony_update(struct mahony *f, const float g[3], const float a[3])
+{
+	float q0 = f->q[0], q1 = f->q[1], q2 = f->q[2], q3 = f->q[3];
+	float gx = g[0], gy = g[1], gz = g[2];
+	float hdt = 0.5f * f->dt;
+
+	if (a[0] != 0.0f || a[1] != 0.0f || a[2] != 0.0f) {
+		float r = inv_norm3(a[0], a[1], a[2]);
+		float ax = a[0] * r, ay = a[1] * r, az = a[2] * r;
+		float vx, vy, vz, ex, ey, ez;
+
+		/* 当前姿态下的重力方向，与测得方向的叉积即为误差 */
+		vx = 2.0f * (q1 * q3 - q0 * q2);
+		vy = 2.0f * (q0 * q1 + q2 * q3);
+		vz = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+		ex = ay * vz - az * vy;
+		ey = az * vx - ax * vz;
+		ez = ax * vy - ay * vx;
+
+		if (f->ki > 0.0f) {
+			f->integral[0] += f->ki * ex * f->dt;
+			f->integral[1] += f->ki * ey * f->dt;
+			f->integral[2] += f->ki * ez * f->dt;
+		}
+		gx += f->kp * ex + f->integral[0];
+		gy += f->kp * ey + f->integral[1];
+		gz += f->kp * ez + f->integral[2];
+	}
+
+	gx *= hdt;
+	gy *= hdt;
+	gz *= hdt;
+	f->q[0] = q0 + (-q1 * gx - q2 * gy - q3 * gz);
+	f->q[1] = q1 + (q0 * gx + q2 * gz - q3 * gy);
+	f->q[2] = q2 + (q0 * gy - q1 * gz + q3 * gx);
+	f->q[3] = q3 + (q0 * gz + q1 * gy - q2 * gx);
+	quat_normalize(f->q);
+}
+
+void mahony_update_batch(struct mahony *f, const struct mpu6050_sample *s, size_t n)
+{
+	float g[3], a[3];
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		raw_to_float(&s[i], f->gyro_scale, g, a);
+		mahony_update(f, g, a);
+	}
+}
+
+/*************************** 定点 Mahony ***************************/
+
+/* 逐位开平方，输入最大为3*32768^2 */
+static uint32_t isqrt32(uint32_t x)
+{
+	uint32_t r = 0, bit = 1u << 30;
+
+	while (bit > x)
+		bit >>= 2;
+	while (bit) {
+		if (x >= r + bit) {
+			x -= r + bit;
+			r = (r >> 1) + bit;
+		} else {
+			r >>= 1;
+		}
+		bit >>= 2;
+	}
+	return r;
+}
+
+void mahony_q_init(struct mahony_q *f, float kp, float ki, float sample_hz, float gyro_lsb)
+{
+	f->q[0] = Q30_ONE;
+	f->q[1] = f->q[2] = f->q[3] = 0;
+	f->integral[0] = f->integral[1] = f->integral[2] = 0;
+	f->kp = (int64_t)(kp * 65536.0f + 0.5f);
+	f->ki_dt = (int64_t)((double)ki / sample_hz * 4294967296.0 + 0.5);
+	f->half_dt = (int64_t)(0.5 / sample_hz * 4294967296.0 + 0.5);
+	f->gyro_scale = (int64_t)((double)DEG_TO_RAD / gyro_lsb * 4294967296.0 + 0.5);
+}
+
+void mahony_q_update(struct mahony_q *f, const int16_t g[3], const int16_t a[3])
+{
+	int64_t q0 = f->q[0], q1 = f->q[1], q2 = f->q[2], q3 = f->q[3];
+	int64_t gx, gy, gz, n, inv;
+	uint32_t s;
+
+	/* 原始值 -> Q24 rad/s */
+	gx = (g[0] * f->gyro_scale) >> 8;
+	gy = (g[1] * f->gyro_scale) >> 8;
+	gz = (g[2] * f->gyro_scale) >> 8;
+
+	s = (uint32_t)(a[0] * a[0]) + (uint32_t)(a[1] * a[1]) + (uint32_t)(a[2] * a[2]);
+	if (s) {
+		int64_t ax, ay, az, vx, vy, vz, ex, ey, ez;
+
+		/* 一次除法得到倒数，乘出来是Q30单位向量 */
+		inv = ((int64_t)1 << 46) / isqrt32(s);
+		ax = (a[0] * inv) >> 16;
+		ay = (a[1] * inv) >> 16;
+		az = (a[2] * inv) >> 16;
+
+		vx = (q1 * q3 - q0 * q2) >> 29;
+		vy = (q0 * q1 + q2 * q3) >> 29;
+		vz = (q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3) >> 30;
+		ex = (ay * vz - az * vy) >> 30;
+		ey = (az * vx - ax * vz) >> 30;
+		ez = (ax * vy - ay * vx) >> 30;
+
+		/* Q32 * Q30 >> 38 = Q24 */
+		f->integral[0] += (int32_t)((f->ki_dt * ex) >> 38);
+		f->integral[1] += (int32_t)((f->ki_dt * ey) >> 38);
+		f->integral[2] += (int32_t)((f->ki_dt * ez) >> 38);
+		/* Q16 * Q30 >> 22 = Q24 */
+		gx += ((f->kp * ex) >> 22) + f->integral[0];
+		gy += ((f->kp * ey) >> 22) + f->integral[1];
+		gz += ((f->kp * ez) >> 22) + f->integral[2];
+	}
+
+	/* Q24 * Q32 >> 26 = Q30 */
+	gx = (gx * f->half_dt) >> 26;
+	gy = (gy * f->half_dt) >> 26;
+	gz = (gz * f->half_dt) >> 26;
+	f->q[0] = (int32_t)(q0 + ((-q1 * gx - q2 * gy - q3 * gz) >> 30));
+	f->q[1] = (int32_t)(q1 + ((q0 * gx + q2 * gz - q3 * gy) >> 30));
+	f->q[2] = (int32_t)(q2 + ((q0 * gy - q1 * gz + q3 * gx) >> 30));
+	f->q[3] = (int32_t)(q3 + ((q0 * gz + q1 * gy - q2 * gx) >> 30));
+
+	/* 每步只偏离单位长度一点点，1/sqrt(n) 用 1.5 - n/2 一阶近似即可 */
+	n = ((int64_t)f->q[0] * f->q[0] + (int64_t)f->q[1] * f->q[1] +
+		 (int64_t)f->q[2] * f->q[2] + (int64_t)f->q[3] * f->q[3]) >> 30;
+	inv = (3LL << 29) - (n >> 1);
+	f->q[0] = (int32_t)((f->q[0] * inv) >> 30);
+	f->q[1] = (int32_t)((f->q[1] * inv) >> 30);
+	f->q[2] = (int32_t)((f->q[2] * inv) >> 30);
+	f->q[3] = (int32_t)((f->q[3] * inv) >> 30);
+}
+
+void mahony_q_update_batch(struct mahony_q *f, const struct mpu6050_sample *s, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		mahony_q_update(f, s[i].gyro, s[i].accel);
+}
+
+void mahony_q_get(const struct mahony_q *f, float q[4])
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+		q[i] = f->q[i] * (1.0f / Q30_ONE);
+}
+
+void imu_quat_to_euler(const float q[4], float *roll, float *pitch, float *yaw)
+{
+	float sp = 2.0f * (q[0] * q[2] - q[3] * q[1]);
+
+	sp = sp > 1.0f ? 1.0f : (sp < -1.0f ? -1.0f : sp);
+	*roll = atan2f(2.0f * (q[0] * q[1] + q[2] * q[3]),
+				   1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2])) * RAD_TO_DEG;
+	*pitch = asinf(sp) * RAD_TO_DEG;
+	*yaw = atan2f(2.0f * (q[0] * q[3] + q[1] * q[2]),
+				  1.0f - 2.0f * (q[2] * q[2] + q[3] * q[3])) * RAD_TO_DEG;
+}
@@ -0,0 +1,72 @@
+/*
+ * MPU6050 姿态融合库(用户态)
+ *
+ * 输入为驱动FIFO/数据就绪中断模式输出的 struct mpu6050_sample 流，
+ * 输出姿态四元数 q = [w, x, y, z]，可以转换成横滚/俯仰/航向角。
+ * 只用加速度和角速度(六轴)，航向角只靠陀螺积分，会缓慢漂移。
+ *
+ *   madgwick_*  浮点Madgwick梯度下降滤波
+ *   mahony_*    浮点Mahony互补滤波(PI修正)
+ *   mahony_q_*  定点Mahony，直接吃原始值，没有浮点运算，结果与浮点版一致
+ *
+ * 所有滤波器按固定采样周期积分，采样率在初始化时给出；
+ * 陀螺灵敏度 gyro_lsb 为每 °/s 的LSB数(±250°/s量程为131)。
+ */
+#ifndef __IMU_FUSION_H
+#define __IMU_FUSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mpu6050i2c.h"
+
+#define IMU_GYRO_LSB_250DPS		131.0f
+
+struct madgwick {
+	float q[4];
+	float beta;				/* 梯度下降步长，越大收敛越快、噪声越大 */
+	float dt;
+	float gyro_scale;		/* LSB -> rad/s */
+};
+
+struct mahony {
+	float q[4];
+	float kp, ki;
+	float integral[3];		/* 陀螺零偏估计(rad/s) */
+	float dt;
+	float gyro_scale;
+};
+
+/*
+ * 定点格式：
+ *   四元数、重力方向、误差 Q30
+ *   角速度、积分项 Q24(rad/s)
+ */
+struct mahony_q {
+	int32_t q[4];
+	int32_t integral[3];
+	int64_t kp;				/* Q16 */
+	int64_t ki_dt;			/* ki * dt，Q32 */
+	int64_t half_dt;		/* dt / 2，Q32 */
+	int64_t gyro_scale;		/* LSB -> rad/s，Q32 */
+};
+
+void madgwick_init(struct madgwick *f, float beta, float sample_hz, float gyro_lsb);
+/* g: rad/s，a: 任意单位(只用方向) */
+void madgwick_update(struct madgwick *f, const float g[3], const float a[3]);
+void madgwick_update_batch(struct madgwick *f, const struct mpu6050_sample *s, size_t n);
+
+void mahony_init(struct mahony *f, float kp, float ki, float sample_hz, float gyro_lsb);
+void mahony_update(struct mahony *f, const float g[3], const float a[3]);
+void mahony_update_batch(struct mahony *f, const struct mpu6050_sample *s, size_t n);
+
+void mahony_q_init(struct mahony_q *f, float kp, float ki, float sample_hz, float gyro_lsb);
+/* g/a 为原始LSB */
+void mahony_q_update(struct mahony_q *f, const int16_t g[3], const int16_t a[3]);
+void mahony_q_update_batch(struct mahony_q *f, const struct mpu6050_sample *s, size_t n);
+void mahony_q_get(const struct mahony_q *f, float q[4]);
+
+/* 四元数转横滚/俯仰/航向角(度) */
+void imu_quat_to_euler(const float q[4], float *roll, float *pitch, float *yaw);
+
+#endif /* __IMU_FUSION_H */
@@ -4,6 +4,7 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/errno.h>
+#include <linux/firmware.h>
 #include <linux/gpio.h>
 #include <linux/cdev.h>
 #include <linux/device.h>
@@ -11,6 +12,18 @@
 #include <linux/semaphore.h>
 #include <linux/timer.h>
 #include <linux/i2c.h>
+#include <linux/idr.h>
+#include <linux/interrupt.h>
+#include <linux/kfifo.h>
+#include <linux/kref.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/rwsem.h>
+#include <linux/slab.h>
+#include <linux/timekeeping.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
 /***************************************************************
@@ -21,21 +34,123 @@
 其他	   	: 无
 日志	   	: 初版V1.0 2021/8/8 1997AURORA创建
 ***************************************************************/
-#define mpu6050i2c_CNT	1
+#include "mpu6050i2c.h"
+
+#define mpu6050i2c_CNT	2			/* 每个芯片一个数据节点和一个事件节点 */
 #define mpu6050i2c_NAME	"mpu6050i2c"
+#define MPU6050_MAX_DEVICES	8		/* 最多同时挂的芯片数，/dev/mpu6050-0 ~ 7 */
+
+/* 寄存器地址 */
+#define MPU6050_XA_OFFS_H		0x06	/* 加速度零偏补偿，手册未列出，见InvenSense应用笔记 */
+#define MPU6050_XG_OFFS_USRH	0x13	/* 陀螺零偏补偿 */
+#define MPU6050_SMPLRT_DIV		0x19
+#define MPU6050_CONFIG			0x1A
+#define MPU6050_GYRO_CONFIG		0x1B
+#define MPU6050_ACCEL_CONFIG	0x1C
+#define MPU6050_MOT_THR			0x1F
+#define MPU6050_MOT_DUR			0x20
+#define MPU6050_FIFO_EN			0x23
+#define MPU6050_INT_PIN_CFG		0x37
+#define MPU6050_INT_ENABLE		0x38
+#define MPU6050_INT_STATUS		0x3A
+#define MPU6050_ACCEL_XOUT_H	0x3B
+#define MPU6050_MOT_DETECT_STATUS	0x61
+#define MPU6050_USER_CTRL		0x6A
+#define MPU6050_PWR_MGMT_1		0x6B
+#define MPU6050_FIFO_COUNTH		0x72
+#define MPU6050_FIFO_R_W		0x74
+
+#define MPU6050_INT_FIFO_OFLOW	0x10	/* INT_STATUS: FIFO溢出 */
+#define MPU6050_INT_DATA_RDY	0x01	/* INT_STATUS/INT_ENABLE: 数据就绪 */
+#define MPU6050_INT_MOT			0x40	/* INT_STATUS/INT_ENABLE: 运动检测 */
+#define MPU6050_INT_LATCH_EN	0x20	/* INT_PIN_CFG: 电平保持到读INT_STATUS */
+#define MPU6050_USER_FIFO_EN	0x40	/* USER_CTRL: 使能FIFO */
+#define MPU6050_USER_FIFO_RESET	0x04	/* USER_CTRL: 复位FIFO，自动清零 */
+#define MPU6050_DLPF_188HZ		0x01	/* CONFIG: DLPF打开时内部输出率为1kHz */
+#define MPU6050_DLPF_OFF		0x00	/* CONFIG: DLPF关闭时陀螺内部输出率为8kHz */
+#define MPU6050_DEFAULT_RATE_HZ	1000
+#define MPU6050_ACCEL_HPF_MASK	0x07	/* ACCEL_CONFIG: 运动检测用的高通滤波 */
+#define MPU6050_ACCEL_HPF_5HZ	0x01
+#define MPU6050_ACCEL_LSB_PER_G	16384	/* ±2g量程 */
+#define MPU6050_FS_MASK			0x18	/* GYRO_CONFIG/ACCEL_CONFIG: 量程选择 */
+#define MPU6050_FS_SHIFT		3
+
+/* 校准时判断静止：样本峰峰值上限，约0.1g和4°/s(±2g/±250°/s量程) */
+#define MPU6050_CALIB_ACCEL_SPAN	1600
+#define MPU6050_CALIB_GYRO_SPAN		500
 
+#define MPU6050_FIFO_SIZE		1024	/* 芯片FIFO字节数 */
+#define MPU6050_DRAIN_MIN_MS	5
+#define MPU6050_DRAIN_MAX_MS	100
+
+/* 采集模式 */
+#define MPU6050_MODE_DIRECT		0	/* read() 时直接读寄存器 */
+#define MPU6050_MODE_FIFO		1	/* 定期排空芯片FIFO */
+#define MPU6050_MODE_DRDY		2	/* 数据就绪中断，每个样本读一次 */
+
+/*
+ * 每个I2C设备一份，多个芯片各自独立采样。
+ * 解绑后已打开的文件还可能在用，按引用计数释放：probe持有一个，每次open一个
+ */
 struct mpu6050i2c_dev {
-	dev_t devid;			/* 设备号 	 */
-	struct cdev cdev;		/* cdev 	*/
-	struct class *class;	/* 类 		*/
+	dev_t devid;			/* 数据节点设备号，事件节点为devid + 1 */
+	int id;					/* 实例编号，对应 /dev/mpu6050-N */
+	struct kref kref;
+	struct rw_semaphore remove_sem;	/* ioctl和直接读寄存器持读锁，remove持写锁设置removed */
+	bool removed;			/* 已解绑，文件操作返回ENODEV */
+	struct cdev *cdev;		/* cdev，单独分配，最后一个文件关闭后由内核释放 */
+	struct cdev *event_cdev;	/* 事件节点cdev */
 	struct device *device;	/* 设备 	 */
-	struct device_node	*nd; /* 设备节点 */
-	int major;			/* 主设备号 */
-	void *private_data;	/* 私有数据 */
+	struct device *event_device;	/* 事件节点设备 */
+	struct i2c_client *client;	/* 所属的I2C设备 */
+	char name[16];			/* mpu6050-N，也用作中断和工作队列名 */
 	int16_t acceleration[3], gyro[3], temp;		/* 芯片数据 */
+
+	struct mutex lock;			/* 保护寄存器配置和FIFO状态 */
+	struct workqueue_struct *drain_wq;	/* 本实例专用，排空不受其他芯片拖累 */
+	struct delayed_work drain_work;	/* 定期排空芯片FIFO */
+	wait_queue_head_t wq;		/* 有新记录时唤醒读者 */
+	struct mutex read_lock;		/* kfifo的唯一消费者 */
+	DECLARE_KFIFO_PTR(samples, struct mpu6050_sample);
+	u8 *fifo_buf;				/* 一次突发读取的缓冲区 */
+	struct mpu6050_ring *ring;	/* mmap共享环形缓冲，vmalloc_user分配 */
+	bool ring_on;				/* 记录写入ring而不是kfifo */
+	u8 mode;					/* MPU6050_MODE_* */
+	u8 fifo_mask;				/* FIFO模式的通道选择 */
+	u8 frame_size;				/* 每个FIFO帧的字节数 */
+	u16 rate_hz;				/* 实际采样率 */
+	u8 dlpf;					/* CONFIG的DLPF_CFG，采样率超过1kHz时临时关闭 */
+	u8 gyro_range;				/* MPU6050_GYRO_* */
+	u8 accel_range;				/* MPU6050_ACCEL_* */
+	u8 decimate;				/* 每多少个样本平均成一条输出，1为不抽取 */
+	u8 dec_count;				/* 当前这组已累加的样本数 */
+	u16 dec_flags;
+	s32 dec_sum[7];				/* 加速度X/Y/Z、温度、角速度X/Y/Z的累加值 */
+	s64 dec_first_ts;
+	u64 period_ns;
+	unsigned long drain_delay;	/* 排空周期(jiffies) */
+	bool overflow;				/* 下一条记录带溢出标志 */
+	int irq;					/* INT引脚中断，0为没有接 */
+	u64 irq_ts;					/* 硬中断上半部记录的时刻 */
+
+	/* 运动检测 */
+	struct mpu6050_motion_config motion;
+	u16 motion_rate_hz;			/* 打开运动检测前的采样率，关闭时恢复，0为没有改过 */
+	wait_queue_head_t event_wq;
+	struct mutex event_lock;	/* 事件kfifo的唯一消费者 */
+	DECLARE_KFIFO_PTR(events, struct mpu6050_event);
+	struct mpu6050_event *event_buf;	/* 组装事件用，太大不放栈上 */
+	u32 event_seq;
+	bool event_lost;
 };
 
-static struct mpu6050i2c_dev mpu6050i2cdev;
+/* 所有实例共用的主设备号和类，次设备号按实例编号划分 */
+static dev_t mpu6050_devt;
+static struct class *mpu6050_class;
+static DEFINE_IDA(mpu6050_ida);
+/* open按次设备号找实例，remove时摘掉 */
+static struct mpu6050i2c_dev *mpu6050_devs[MPU6050_MAX_DEVICES];
+static DEFINE_MUTEX(mpu6050_devs_lock);
 
 /*
  * @description	: 从mpu6050i2c读取多个寄存器数据
@@ -49,7 +164,7 @@ static int mpu6050i2c_read_regs(struct mpu6050i2c_dev *dev, u8 reg, void *val, i
 {
 	int ret;
 	struct i2c_msg msg[2];
-	struct i2c_client *client = (struct i2c_client *)dev->private_data;
+	struct i2c_client *client = dev->client;
 
 	/* msg[0]为发送要读取的首地址 */
 	msg[0].addr = client->addr;			/* mpu6050i2c地址 */
@@ -67,7 +182,7 @@ static int mpu6050i2c_read_regs(struct mpu6050i2c_dev *dev, u8 reg, void *val, i
 	if(ret == 2) {
 		ret = 0;
 	} else {
-		printk("i2c rd failed=%d reg=%06x len=%d\n",ret, reg, len);
+		dev_err_ratelimited(&client->dev, "i2c rd failed=%d reg=%06x len=%d\n", ret, reg, len);
 		ret = -EREMOTEIO;
 	}
 	return ret;
@@ -85,7 +200,7 @@ static s32 mpu6050i2c_write_regs(struct mpu6050i2c_dev *dev, u8 reg, u8 *buf, u8
 {
 	u8 b[256];
 	struct i2c_msg msg;
-	struct i2c_client *client = (struct i2c_client *)dev->private_data;
+	struct i2c_client *client = dev->client;
 	
 	b[0] = reg;					/* 寄存器首地址 */
 	memcpy(&b[1],buf,len);		/* 将要写入的数据拷贝到数组b里面 */
@@ -113,7 +228,7 @@ static unsigned char mpu6050i2c_read_reg(struct mpu6050i2c_dev *dev, u8 reg)
 	return data;
 
 #if 0
-	struct i2c_client *client = (struct i2c_client *)dev->private_data;
+	struct i2c_client *client = dev->client;
 	return i2c_smbus_read_byte_data(client, reg);
 #endif
 }
@@ -132,41 +247,1008 @@ static void mpu6050i2c_write_reg(struct mpu6050i2c_dev *dev, u8 reg, u8 data)
 	mpu6050i2c_write_regs(dev, reg, &buf, 1);
 }
 
-static void mpu6050_reset(void) {
-	mpu6050i2c_write_reg(&mpu6050i2cdev, 0x6B, 0x00);
+static void mpu6050_reset(struct mpu6050i2c_dev *dev) {
+	mpu6050i2c_write_reg(dev, MPU6050_PWR_MGMT_1, 0x00);
 }
 /*
  * @description	: 读取mpu6050i2c的数据，读取原始数据
+ * 				  0x3B开始的14字节依次为加速度、温度、角速度，一次突发读完，
+ * 				  三组数据来自同一个采样时刻
  * @param - dev:  mpu6050i2c设备
- * @return 		: 无。
+ * @return 		: 0 成功;其他 失败
  */
-void mpu6050i2c_readdata(struct mpu6050i2c_dev *dev)
+int mpu6050i2c_readdata(struct mpu6050i2c_dev *dev)
 {
-	unsigned char i =0;
-    unsigned char buf[6];
-	unsigned char val = 0x3B;
-	// Start reading acceleration registers from register 0x3B for 6 bytes
-	mpu6050i2c_read_regs(dev, val, buf, 6);
-	for(i = 0; i < 3; i++)	
+	unsigned char i = 0;
+	unsigned char buf[14];
+	int ret;
+
+	ret = mpu6050i2c_read_regs(dev, MPU6050_ACCEL_XOUT_H, buf, sizeof(buf));
+	if (ret)
+		return ret;
+
+	for(i = 0; i < 3; i++)
 	{
 		dev->acceleration[i] = (buf[i * 2] << 8 | buf[(i * 2) + 1]);
+		dev->gyro[i] = (buf[8 + i * 2] << 8 | buf[8 + (i * 2) + 1]);
 	}
-	// Now gyro data from reg 0x43 for 6 bytes
-    // The register is auto incrementing on each read
-	val = 0x43;
-	mpu6050i2c_read_regs(dev, val, buf, 6);
-	for(i = 0; i < 3; i++)	
-	{
-		dev->gyro[i] = (buf[i * 2] << 8 | buf[(i * 2) + 1]);
+	dev->temp = buf[6] << 8 | buf[7];
+	return 0;
+}
+
+/*
+ * @description	: 根据通道选择计算FIFO帧长，顺序与寄存器地址一致：
+ * 				  加速度(6) 温度(2) 角速度X/Y/Z(各2)
+ * @param - mask: MPU6050_FIFO_* 组合
+ * @return 		: 每帧字节数
+ */
+static u8 mpu6050_frame_size(u8 mask)
+{
+	u8 size = 0;
+
+	if (mask & MPU6050_FIFO_ACCEL)
+		size += 6;
+	if (mask & MPU6050_FIFO_TEMP)
+		size += 2;
+	if (mask & MPU6050_FIFO_XG)
+		size += 2;
+	if (mask & MPU6050_FIFO_YG)
+		size += 2;
+	if (mask & MPU6050_FIFO_ZG)
+		size += 2;
+	return size;
+}
+
+/*
+ * @description	: 把一个FIFO帧解析成记录，未使能的通道为0
+ * @param - mask: MPU6050_FIFO_* 组合
+ * @param - p 	: 帧数据
+ * @param - s 	: 输出记录
+ * @return 		: 无
+ */
+static void mpu6050_parse_frame(u8 mask, const u8 *p, struct mpu6050_sample *s)
+{
+	int i;
+
+	memset(s, 0, sizeof(*s));
+	if (mask & MPU6050_FIFO_ACCEL) {
+		for (i = 0; i < 3; i++, p += 2)
+			s->accel[i] = (s16)(p[0] << 8 | p[1]);
 	}
-	// Now temperature from reg 0x41 for 2 bytes
-    // The register is auto incrementing on each read
-	val = 0x41;
-	mpu6050i2c_read_regs(dev, val, buf, 2);
-	for(i = 0; i < 3; i++)	
-	{
-		dev->temp = buf[0] << 8 | buf[1];
+	if (mask & MPU6050_FIFO_TEMP) {
+		s->temp = (s16)(p[0] << 8 | p[1]);
+		p += 2;
+	}
+	for (i = 0; i < 3; i++) {
+		if (mask & (MPU6050_FIFO_XG >> i)) {
+			s->gyro[i] = (s16)(p[0] << 8 | p[1]);
+			p += 2;
+		}
+	}
+}
+
+/*
+ * @description	: 复位芯片FIFO并重新使能，用于启动和溢出恢复
+ * @param - dev:  mpu6050i2c设备
+ * @return 		: 无
+ */
+static void mpu6050_fifo_reset(struct mpu6050i2c_dev *dev)
+{
+	mpu6050i2c_write_reg(dev, MPU6050_FIFO_EN, 0);
+	mpu6050i2c_write_reg(dev, MPU6050_USER_CTRL, MPU6050_USER_FIFO_RESET);
+	mpu6050i2c_write_reg(dev, MPU6050_USER_CTRL, MPU6050_USER_FIFO_EN);
+	mpu6050i2c_write_reg(dev, MPU6050_FIFO_EN, dev->fifo_mask);
+	/* INT_STATUS读后清零，丢掉复位前的溢出标志 */
+	mpu6050i2c_read_reg(dev, MPU6050_INT_STATUS);
+}
+
+/*
+ * @description	: 共享环形缓冲是否有记录可读，消费者位置由用户态写
+ * @param - dev:  mpu6050i2c设备
+ * @return 		: 有记录返回true
+ */
+static bool mpu6050_ring_ready(struct mpu6050i2c_dev *dev)
+{
+	return READ_ONCE(dev->ring->head) != READ_ONCE(dev->ring->tail);
+}
+
+/*
+ * @description	: 记录是否可读，按当前输出方式检查kfifo或共享环形缓冲
+ * @param - dev:  mpu6050i2c设备
+ * @return 		: 有记录返回true
+ */
+static bool mpu6050_samples_ready(struct mpu6050i2c_dev *dev)
+{
+	return READ_ONCE(dev->ring_on) ? mpu6050_ring_ready(dev) :
+									 !kfifo_is_empty(&dev->samples);
+}
+
+/*
+ * @description	: 把解析好的记录放入驱动缓冲区，满了丢弃新记录并标记下一条。
+ * 				  共享环形缓冲只有这里一个生产者：先写槽位再release发布head，
+ * 				  acquire读取tail保证用户态读完的槽位才会被覆盖
+ * @param - dev:  mpu6050i2c设备
+ * @param - s 	: 记录
+ * @return 		: 无
+ */
+static void mpu6050_emit_sample(struct mpu6050i2c_dev *dev, struct mpu6050_sample *s)
+{
+	struct mpu6050_ring *ring = dev->ring;
+	u32 head = 0;
+	bool full;
+
+	if (dev->ring_on) {
+		head = ring->head;
+		full = head - smp_load_acquire(&ring->tail) >= MPU6050_RING_SLOTS;
+	} else {
+		full = kfifo_is_full(&dev->samples);
+	}
+	if (full) {
+		dev->overflow = true;
+		if (dev->ring_on)
+			WRITE_ONCE(ring->lost, ring->lost + 1);
+		return;
+	}
+	if (dev->overflow) {
+		s->flags |= MPU6050_SAMPLE_OVERFLOW;
+		dev->overflow = false;
+	}
+
+	if (dev->ring_on) {
+		ring->rec[head & (MPU6050_RING_SLOTS - 1)] = *s;
+		smp_store_release(&ring->head, head + 1);
+	} else {
+		kfifo_put(&dev->samples, *s);
+	}
+}
+
+/*
+ * @description	: 丢弃抽取到一半的样本，采集开始/停止和改配置时调用
+ * @param - dev:  mpu6050i2c设备
+ * @return 		: 无
+ */
+static void mpu6050_decimate_reset(struct mpu6050i2c_dev *dev)
+{
+	dev->dec_count = 0;
+	dev->dec_flags = 0;
+	memset(dev->dec_sum, 0, sizeof(dev->dec_sum));
+}
+
+/*
+ * @description	: 采集到的样本经过抽取后放入驱动缓冲区。
+ * 				  每decimate个样本取平均输出一条(一阶CIC，即滑动窗口不重叠的box滤波)，
+ * 				  时间戳取这组样本的中点，flags取并集
+ * @param - dev:  mpu6050i2c设备
+ * @param - s 	: 记录
+ * @return 		: 无
+ */
+static void mpu6050_push_sample(struct mpu6050i2c_dev *dev, struct mpu6050_sample *s)
+{
+	int n = dev->decimate, i;
+
+	if (n <= 1) {
+		mpu6050_emit_sample(dev, s);
+		return;
+	}
+
+	if (!dev->dec_count)
+		dev->dec_first_ts = s->timestamp_ns;
+	for (i = 0; i < 3; i++) {
+		dev->dec_sum[i] += s->accel[i];
+		dev->dec_sum[4 + i] += s->gyro[i];
+	}
+	dev->dec_sum[3] += s->temp;
+	dev->dec_flags |= s->flags;
+	if (++dev->dec_count < n)
+		return;
+
+	s->timestamp_ns = dev->dec_first_ts + (s->timestamp_ns - dev->dec_first_ts) / 2;
+	for (i = 0; i < 3; i++) {
+		s->accel[i] = DIV_ROUND_CLOSEST(dev->dec_sum[i], n);
+		s->gyro[i] = DIV_ROUND_CLOSEST(dev->dec_sum[4 + i], n);
+	}
+	s->temp = DIV_ROUND_CLOSEST(dev->dec_sum[3], n);
+	s->flags = dev->dec_flags;
+	mpu6050_decimate_reset(dev);
+	mpu6050_emit_sample(dev, s);
+}
+
+/*
+ * @description	: 排空芯片FIFO：读FIFO_COUNT，再按整帧从FIFO_R_W突发读取，
+ * 				  时间戳按采样周期从读取时刻倒推
+ * @param - dev:  mpu6050i2c设备
+ * @return 		: 0 成功;其他 失败
+ */
+static int mpu6050_fifo_drain(struct mpu6050i2c_dev *dev)
+{
+	struct mpu6050_sample s;
+	u8 cnt[2];
+	unsigned int count, frames, i;
+	u64 now;
+	int ret;
+
+	ret = mpu6050i2c_read_regs(dev, MPU6050_INT_STATUS, cnt, 1);
+	if (ret)
+		return ret;
+	if (cnt[0] & MPU6050_INT_FIFO_OFLOW) {
+		/* 溢出后FIFO里的帧边界已经错位，只能整体丢弃 */
+		dev_warn_ratelimited(&dev->client->dev, "FIFO溢出，复位FIFO\n");
+		mpu6050_fifo_reset(dev);
+		dev->overflow = true;
+		return 0;
+	}
+
+	ret = mpu6050i2c_read_regs(dev, MPU6050_FIFO_COUNTH, cnt, 2);
+	if (ret)
+		return ret;
+	count = cnt[0] << 8 | cnt[1];
+	frames = min_t(unsigned int, count, MPU6050_FIFO_SIZE) / dev->frame_size;
+	if (!frames)
+		return 0;
+
+	ret = mpu6050i2c_read_regs(dev, MPU6050_FIFO_R_W, dev->fifo_buf,
+							   frames * dev->frame_size);
+	if (ret)
+		return ret;
+	now = ktime_get_boottime_ns();
+
+	for (i = 0; i < frames; i++) {
+		mpu6050_parse_frame(dev->fifo_mask, dev->fifo_buf + i * dev->frame_size, &s);
+		s.timestamp_ns = now - (u64)(frames - 1 - i) * dev->period_ns;
+		mpu6050_push_sample(dev, &s);
+	}
+	wake_up_interruptible(&dev->wq);
+	return 0;
+}
+
+/*
+ * @description	: FIFO排空线程，周期由采样率和帧长决定
+ * @param - work: 工作项
+ * @return 		: 无
+ */
+static void mpu6050_drain_work(struct work_struct *work)
+{
+	struct mpu6050i2c_dev *dev = container_of(to_delayed_work(work),
+						struct mpu6050i2c_dev, drain_work);
+
+	mutex_lock(&dev->lock);
+	if (dev->mode == MPU6050_MODE_FIFO) {
+		if (mpu6050_fifo_drain(dev))
+			dev_err_ratelimited(&dev->client->dev, "排空FIFO失败\n");
+		queue_delayed_work(dev->drain_wq, &dev->drain_work, dev->drain_delay);
+	}
+	mutex_unlock(&dev->lock);
+}
+
+/*
+ * @description	: 数据就绪中断上半部，只记录时间戳，总线读取放到线程里
+ * @param - irq : 中断号
+ * @param - data: mpu6050i2c设备
+ * @return 		: IRQ_WAKE_THREAD
+ */
+static irqreturn_t mpu6050_irq(int irq, void *data)
+{
+	struct mpu6050i2c_dev *dev = data;
+
+	/* IRQF_ONESHOT保证线程跑完之前不会再进来覆盖这个值 */
+	dev->irq_ts = ktime_get_boottime_ns();
+	return IRQ_WAKE_THREAD;
+}
+
+/*
+ * @description	: 当前应打开的中断源，调用者持有dev->lock
+ * @param - dev:  mpu6050i2c设备
+ * @return 		: INT_ENABLE寄存器值
+ */
+static u8 mpu6050_int_mask(struct mpu6050i2c_dev *dev)
+{
+	u8 mask = 0;
+
+	if (dev->mode == MPU6050_MODE_DRDY)
+		mask |= MPU6050_INT_DATA_RDY;
+	if (dev->motion.enable)
+		mask |= MPU6050_INT_MOT;
+	return mask;
+}
+
+/*
+ * @description	: 运动中断后组装事件：把芯片FIFO里的加速度历史全部读出，
+ * 				  取最后 MPU6050_EVENT_PRE 帧作为预触发样本。
+ * 				  FIFO满后新数据覆盖最旧的字节，开头 count % 6 个字节是
+ * 				  被截断的半帧，要跳过。调用者持有dev->lock
+ * @param - dev:  mpu6050i2c设备
+ * @return 		: 无
+ */
+static void mpu6050_motion_event(struct mpu6050i2c_dev *dev)
+{
+	struct mpu6050_event *ev = dev->event_buf;
+	unsigned int count, frames, first, i, k;
+	s32 d[3], base[3];
+	u32 mag, peak = 0;
+	u8 cnt[2];
+
+	memset(ev, 0, sizeof(*ev));
+	ev->timestamp_ns = dev->irq_ts;
+	mpu6050i2c_read_regs(dev, MPU6050_MOT_DETECT_STATUS, &ev->motion_status, 1);
+
+	if (mpu6050i2c_read_regs(dev, MPU6050_FIFO_COUNTH, cnt, 2) == 0) {
+		count = min_t(unsigned int, cnt[0] << 8 | cnt[1], MPU6050_FIFO_SIZE);
+		frames = count / 6;
+		if (frames && mpu6050i2c_read_regs(dev, MPU6050_FIFO_R_W,
+										   dev->fifo_buf, count) == 0) {
+			first = frames > MPU6050_EVENT_PRE ? frames - MPU6050_EVENT_PRE : 0;
+			ev->nr_pre = frames - first;
+			for (i = 0; i < ev->nr_pre; i++) {
+				mpu6050_parse_frame(MPU6050_FIFO_ACCEL,
+						dev->fifo_buf + count % 6 + (first + i) * 6, &ev->pre[i]);
+				ev->pre[i].timestamp_ns = dev->irq_ts -
+						(u64)(ev->nr_pre - 1 - i) * dev->period_ns;
+			}
+		}
+	}
+
+	/* 峰值：相对窗口第一条样本(触发前的基线)的变化量 */
+	for (i = 0; i < ev->nr_pre; i++) {
+		for (k = 0; k < 3; k++) {
+			if (i == 0)
+				base[k] = ev->pre[0].accel[k];
+			d[k] = ev->pre[i].accel[k] - base[k];
+		}
+		mag = int_sqrt64((s64)d[0] * d[0] + (s64)d[1] * d[1] + (s64)d[2] * d[2]);
+		if (mag > peak) {
+			peak = mag;
+			ev->peak_axis = abs(d[0]) >= abs(d[1]) ?
+					(abs(d[0]) >= abs(d[2]) ? 0 : 2) :
+					(abs(d[1]) >= abs(d[2]) ? 1 : 2);
+		}
+	}
+	ev->peak_mg = peak * 1000 / (MPU6050_ACCEL_LSB_PER_G >> dev->accel_range);
+
+	ev->seq = ++dev->event_seq;
+	if (kfifo_is_full(&dev->events)) {
+		dev->event_lost = true;
+		dev_warn_ratelimited(&dev->client->dev, "事件缓冲区满，丢弃事件%u\n", ev->seq);
+		return;
+	}
+	if (dev->event_lost) {
+		ev->flags |= MPU6050_EVENT_LOST;
+		dev->event_lost = false;
+	}
+	kfifo_put(&dev->events, *ev);
+	wake_up_interruptible(&dev->event_wq);
+}
+
+/*
+ * @description	: 中断线程：从INT_STATUS开始突发读15字节，
+ * 				  读INT_STATUS同时清掉保持的中断电平，再按中断源分别处理
+ * @param - irq : 中断号
+ * @param - data: mpu6050i2c设备
+ * @return 		: IRQ_HANDLED
+ */
+static irqreturn_t mpu6050_irq_thread(int irq, void *data)
+{
+	struct mpu6050i2c_dev *dev = data;
+	struct mpu6050_sample s;
+	u8 buf[15];
+
+	mutex_lock(&dev->lock);
+	if (mpu6050i2c_read_regs(dev, MPU6050_INT_STATUS, buf, sizeof(buf)) == 0) {
+		if (dev->mode == MPU6050_MODE_DRDY && (buf[0] & MPU6050_INT_DATA_RDY)) {
+			/* 数据寄存器的顺序与全通道FIFO帧相同 */
+			mpu6050_parse_frame(MPU6050_FIFO_ALL, buf + 1, &s);
+			s.timestamp_ns = dev->irq_ts;
+			mpu6050_push_sample(dev, &s);
+			wake_up_interruptible(&dev->wq);
+		}
+		if (dev->motion.enable && (buf[0] & MPU6050_INT_MOT))
+			mpu6050_motion_event(dev);
+	}
+	mutex_unlock(&dev->lock);
+	return IRQ_HANDLED;
+}
+
+/*
+ * @description	: 停止FIFO/中断采集，回到直接读寄存器模式并清空缓冲区
+ * @param - dev:  mpu6050i2c设备
+ * @return 		: 无
+ */
+static void mpu6050_stop_capture(struct mpu6050i2c_dev *dev)
+{
+	u8 mode;
+
+	/* 排空线程和中断线程都在锁内检查mode */
+	mutex_lock(&dev->lock);
+	mode = dev->mode;
+	dev->mode = MPU6050_MODE_DIRECT;
+	dev->fifo_mask = 0;
+	mutex_unlock(&dev->lock);
+
+	cancel_delayed_work_sync(&dev->drain_work);
+
+	mutex_lock(&dev->lock);
+	/* 中断线程在锁内检查mode，这里只需关掉芯片的中断源，运动检测保留 */
+	mpu6050i2c_write_reg(dev, MPU6050_INT_ENABLE, mpu6050_int_mask(dev));
+	if (mode == MPU6050_MODE_FIFO) {
+		mpu6050i2c_write_reg(dev, MPU6050_FIFO_EN, 0);
+		mpu6050i2c_write_reg(dev, MPU6050_USER_CTRL, 0);
+	}
+	mpu6050i2c_read_reg(dev, MPU6050_INT_STATUS);
+
+	mutex_lock(&dev->read_lock);
+	kfifo_reset(&dev->samples);
+	dev->overflow = false;
+	mpu6050_decimate_reset(dev);
+	mutex_unlock(&dev->read_lock);
+	mutex_unlock(&dev->lock);
+
+	/* 唤醒阻塞在旧模式下的读者 */
+	wake_up_interruptible(&dev->wq);
+}
+
+/*
+ * @description	: 设置采样率，调用者持有dev->lock。
+ * 				  DLPF打开时内部输出率为1kHz，关闭时陀螺为8kHz，再经SMPLRT_DIV分频。
+ * 				  超过1kHz的采样率临时关闭DLPF，此时加速度仍然只按1kHz更新
+ * @param - dev:  mpu6050i2c设备
+ * @param - rate: 期望的采样率(Hz)，按整数分频取整
+ * @return 		: 无
+ */
+static void mpu6050_set_rate(struct mpu6050i2c_dev *dev, unsigned int rate)
+{
+	u8 dlpf = rate > 1000 ? MPU6050_DLPF_OFF : dev->dlpf;
+	unsigned int base = dlpf == MPU6050_DLPF_OFF ? 8000 : 1000;
+	unsigned int div = clamp_t(unsigned int, DIV_ROUND_CLOSEST(base, rate), 1, 256);
+
+	dev->rate_hz = base / div;
+	dev->period_ns = div * NSEC_PER_SEC / base;
+	mpu6050i2c_write_reg(dev, MPU6050_CONFIG, dlpf);
+	mpu6050i2c_write_reg(dev, MPU6050_SMPLRT_DIV, div - 1);
+}
+/*
+ * @description	: 把DLPF和量程写入芯片，并按新的DLPF重新设置采样率，调用者持有dev->lock。
+ * 				  ACCEL_CONFIG的高通滤波位归运动检测所有，这里保留
+ * @param - dev:  mpu6050i2c设备
+ * @return 		: 无
+ */
+static void mpu6050_apply_filter(struct mpu6050i2c_dev *dev)
+{
+	u8 accel_cfg;
+
+	mpu6050i2c_write_reg(dev, MPU6050_GYRO_CONFIG, dev->gyro_range << MPU6050_FS_SHIFT);
+	accel_cfg = mpu6050i2c_read_reg(dev, MPU6050_ACCEL_CONFIG) & MPU6050_ACCEL_HPF_MASK;
+	mpu6050i2c_write_reg(dev, MPU6050_ACCEL_CONFIG,
+						 accel_cfg | dev->accel_range << MPU6050_FS_SHIFT);
+	mpu6050_set_rate(dev, dev->rate_hz);
+}
+
+/*
+ * @description	: 当前滤波/量程/抽取配置，调用者持有dev->lock
+ * @param - dev:  mpu6050i2c设备
+ * @param - cfg:  输出配置
+ * @return 		: 无
+ */
+static void mpu6050_get_filter(struct mpu6050i2c_dev *dev, struct mpu6050_filter_config *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->dlpf = dev->dlpf;
+	cfg->gyro_range = dev->gyro_range;
+	cfg->accel_range = dev->accel_range;
+	cfg->decimate = dev->decimate;
+	cfg->rate_hz = dev->rate_hz;
+	cfg->accel_lsb_per_g = MPU6050_ACCEL_LSB_PER_G >> dev->accel_range;
+	cfg->gyro_lsb_per_dps_x10 = 1310 >> dev->gyro_range;
+}
+
+/*
+ * @description	: 设置DLPF、量程、抽取和直接读寄存器模式下的采样率。
+ * 				  采集中改动会让缓冲区里的数据前后单位不一致，只能在
+ * 				  直接读寄存器模式下设置，否则返回EBUSY
+ * @param - dev:  mpu6050i2c设备
+ * @param - cfg:  配置，按实际值写回
+ * @return 		: 0 成功;其他 失败
+ */
+static int mpu6050_set_filter(struct mpu6050i2c_dev *dev, struct mpu6050_filter_config *cfg)
+{
+	int ret = 0;
+
+	if (cfg->dlpf > MPU6050_DLPF_MAX || cfg->gyro_range > MPU6050_GYRO_2000DPS ||
+		cfg->accel_range > MPU6050_ACCEL_16G || !cfg->decimate ||
+		cfg->decimate > MPU6050_DECIMATE_MAX ||
+		(cfg->rate_hz && (cfg->rate_hz < MPU6050_RATE_MIN_HZ ||
+						  cfg->rate_hz > MPU6050_RATE_MAX_HZ)))
+		return -EINVAL;
+
+	mutex_lock(&dev->lock);
+	if (dev->mode != MPU6050_MODE_DIRECT) {
+		ret = -EBUSY;
+		goto out;
+	}
+	dev->dlpf = cfg->dlpf;
+	dev->gyro_range = cfg->gyro_range;
+	dev->accel_range = cfg->accel_range;
+	dev->decimate = cfg->decimate;
+	/* 运动检测按1kHz填充预触发缓冲，这时不改采样率 */
+	if (cfg->rate_hz && !dev->motion.enable)
+		dev->rate_hz = cfg->rate_hz;
+	mpu6050_apply_filter(dev);
+out:
+	mpu6050_get_filter(dev, cfg);
+	mutex_unlock(&dev->lock);
+	return ret;
+}
+
+static ssize_t mpu6050_filter_show(struct device *d, char *buf, size_t offset)
+{
+	struct mpu6050i2c_dev *dev = dev_get_drvdata(d);
+	struct mpu6050_filter_config cfg;
+
+	mutex_lock(&dev->lock);
+	mpu6050_get_filter(dev, &cfg);
+	mutex_unlock(&dev->lock);
+	if (offset == offsetof(struct mpu6050_filter_config, rate_hz))
+		return sysfs_emit(buf, "%u\n", cfg.rate_hz);
+	return sysfs_emit(buf, "%u\n", *((u8 *)&cfg + offset));
+}
+
+static ssize_t mpu6050_filter_store(struct device *d, const char *buf, size_t count,
+									size_t offset)
+{
+	struct mpu6050i2c_dev *dev = dev_get_drvdata(d);
+	struct mpu6050_filter_config cfg;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+	mutex_lock(&dev->lock);
+	mpu6050_get_filter(dev, &cfg);
+	mutex_unlock(&dev->lock);
+	if (offset == offsetof(struct mpu6050_filter_config, rate_hz)) {
+		if (val > U16_MAX)
+			return -EINVAL;
+		cfg.rate_hz = val;
+	} else {
+		if (val > U8_MAX)
+			return -EINVAL;
+		*((u8 *)&cfg + offset) = val;
+	}
+	ret = mpu6050_set_filter(dev, &cfg);
+	return ret ? ret : count;
+}
+
+/* sysfs属性与ioctl共用同一套检查，每个属性对应 mpu6050_filter_config 的一个字段 */
+#define MPU6050_FILTER_ATTR(field)												\
+static ssize_t field##_show(struct device *d, struct device_attribute *attr, char *buf)	\
+{																				\
+	return mpu6050_filter_show(d, buf, offsetof(struct mpu6050_filter_config, field));	\
+}																				\
+static ssize_t field##_store(struct device *d, struct device_attribute *attr,	\
+							 const char *buf, size_t count)						\
+{																				\
+	return mpu6050_filter_store(d, buf, count,									\
+								offsetof(struct mpu6050_filter_config, field));	\
+}																				\
+static DEVICE_ATTR_RW(field)
+
+MPU6050_FILTER_ATTR(dlpf);
+MPU6050_FILTER_ATTR(gyro_range);
+MPU6050_FILTER_ATTR(accel_range);
+MPU6050_FILTER_ATTR(decimate);
+MPU6050_FILTER_ATTR(rate_hz);
+
+static struct attribute *mpu6050_attrs[] = {
+	&dev_attr_dlpf.attr,
+	&dev_attr_gyro_range.attr,
+	&dev_attr_accel_range.attr,
+	&dev_attr_decimate.attr,
+	&dev_attr_rate_hz.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(mpu6050);
+
+/*
+ * @description	: 设置FIFO模式，mask为0时关闭
+ * @param - dev:  mpu6050i2c设备
+ * @param - cfg:  FIFO配置，rate_hz按分频取整后写回
+ * @return 		: 0 成功;其他 失败
+ */
+static int mpu6050_fifo_config(struct mpu6050i2c_dev *dev, struct mpu6050_fifo_config *cfg)
+{
+	unsigned int fill_ms;
+	bool busy;
+
+	if (cfg->mask & ~MPU6050_FIFO_ALL)
+		return -EINVAL;
+	if (cfg->mask && (cfg->rate_hz < MPU6050_RATE_MIN_HZ ||
+					  cfg->rate_hz > MPU6050_RATE_MAX_HZ))
+		return -EINVAL;
+
+	/* 运动检测占用芯片FIFO做预触发缓冲，先检查一次，不为注定失败的请求停掉当前采集 */
+	if (cfg->mask) {
+		mutex_lock(&dev->lock);
+		busy = dev->motion.enable;
+		mutex_unlock(&dev->lock);
+		if (busy)
+			return -EBUSY;
+	}
+
+	mpu6050_stop_capture(dev);
+	if (!cfg->mask) {
+		cfg->rate_hz = 0;
+		return 0;
+	}
+
+	/* 停止采集和重新加锁之间，其他调用者可能打开了运动检测或别的采集模式 */
+	mutex_lock(&dev->lock);
+	if (dev->motion.enable || dev->mode != MPU6050_MODE_DIRECT) {
+		mutex_unlock(&dev->lock);
+		return -EBUSY;
+	}
+	mpu6050_set_rate(dev, cfg->rate_hz);
+	dev->frame_size = mpu6050_frame_size(cfg->mask);
+	/* 在芯片FIFO填满四分之一时排空，留足余量 */
+	fill_ms = div_u64(MPU6050_FIFO_SIZE / dev->frame_size * dev->period_ns, NSEC_PER_MSEC);
+	dev->drain_delay = msecs_to_jiffies(clamp_t(unsigned int, fill_ms / 4,
+						MPU6050_DRAIN_MIN_MS, MPU6050_DRAIN_MAX_MS));
+
+	dev->fifo_mask = cfg->mask;
+	dev->mode = MPU6050_MODE_FIFO;
+	mpu6050_fifo_reset(dev);
+	queue_delayed_work(dev->drain_wq, &dev->drain_work, dev->drain_delay);
+	cfg->rate_hz = dev->rate_hz;
+	mutex_unlock(&dev->lock);
+	return 0;
+}
+
+/*
+ * @description	: 设置数据就绪中断模式，rate为0时关闭
+ * @param - dev:  mpu6050i2c设备
+ * @param - rate: 采样率(Hz)，按分频取整后写回
+ * @return 		: 0 成功;其他 失败
+ */
+static int mpu6050_drdy_config(struct mpu6050i2c_dev *dev, u32 *rate)
+{
+	if (*rate && (*rate < MPU6050_RATE_MIN_HZ || *rate > MPU6050_DRDY_MAX_HZ))
+		return -EINVAL;
+	if (*rate && dev->irq <= 0)
+		return -EOPNOTSUPP;
+
+	mpu6050_stop_capture(dev);
+	if (!*rate)
+		return 0;
+
+	mutex_lock(&dev->lock);
+	mpu6050_set_rate(dev, *rate);
+	/* 中断保持高电平直到读INT_STATUS，配合IRQF_ONESHOT不会丢边沿 */
+	mpu6050i2c_write_reg(dev, MPU6050_INT_PIN_CFG, MPU6050_INT_LATCH_EN);
+	mpu6050i2c_read_reg(dev, MPU6050_INT_STATUS);
+	dev->mode = MPU6050_MODE_DRDY;
+	*rate = dev->rate_hz;
+	mpu6050i2c_write_reg(dev, MPU6050_INT_ENABLE, mpu6050_int_mask(dev));
+	mutex_unlock(&dev->lock);
+	return 0;
+}
+
+/*
+ * @description	: 设置运动检测
+ * @param - dev:  mpu6050i2c设备
+ * @param - cfg:  运动检测配置，阈值按2mg取整后写回
+ * @return 		: 0 成功;其他 失败
+ */
+static int mpu6050_motion_config(struct mpu6050i2c_dev *dev, struct mpu6050_motion_config *cfg)
+{
+	u8 accel_cfg;
+	int ret = 0;
+
+	if (cfg->enable) {
+		if (cfg->threshold_mg < 2 || cfg->threshold_mg > 510 || !cfg->duration_ms)
+			return -EINVAL;
+		if (dev->irq <= 0)
+			return -EOPNOTSUPP;
+	}
+
+	mutex_lock(&dev->lock);
+	if (!cfg->enable) {
+		if (dev->motion.enable && dev->mode != MPU6050_MODE_FIFO) {
+			mpu6050i2c_write_reg(dev, MPU6050_FIFO_EN, 0);
+			mpu6050i2c_write_reg(dev, MPU6050_USER_CTRL, 0);
+		}
+		/* 采集中的采样率归采集模式所有，只在直接读寄存器模式下恢复 */
+		if (dev->motion.enable && dev->motion_rate_hz && dev->mode == MPU6050_MODE_DIRECT)
+			mpu6050_set_rate(dev, dev->motion_rate_hz);
+		dev->motion_rate_hz = 0;
+		dev->motion.enable = 0;
+		goto out;
+	}
+	if (dev->mode == MPU6050_MODE_FIFO) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	/* 没有在采集时按1kHz填充预触发缓冲，记下原来的采样率，关闭时恢复 */
+	if (dev->mode == MPU6050_MODE_DIRECT) {
+		if (!dev->motion.enable)
+			dev->motion_rate_hz = dev->rate_hz;
+		mpu6050_set_rate(dev, 1000);
+	}
+
+	/* 高通滤波只作用于运动检测，不影响数据寄存器 */
+	accel_cfg = mpu6050i2c_read_reg(dev, MPU6050_ACCEL_CONFIG);
+	accel_cfg = (accel_cfg & ~MPU6050_ACCEL_HPF_MASK) | MPU6050_ACCEL_HPF_5HZ;
+	mpu6050i2c_write_reg(dev, MPU6050_ACCEL_CONFIG, accel_cfg);
+	mpu6050i2c_write_reg(dev, MPU6050_MOT_THR, DIV_ROUND_UP(cfg->threshold_mg, 2));
+	mpu6050i2c_write_reg(dev, MPU6050_MOT_DUR, cfg->duration_ms);
+	mpu6050i2c_write_reg(dev, MPU6050_INT_PIN_CFG, MPU6050_INT_LATCH_EN);
+
+	/* 芯片FIFO只存加速度，满了以后覆盖最旧的数据，正好当环形缓冲用 */
+	mpu6050i2c_write_reg(dev, MPU6050_FIFO_EN, 0);
+	mpu6050i2c_write_reg(dev, MPU6050_USER_CTRL, MPU6050_USER_FIFO_RESET);
+	mpu6050i2c_write_reg(dev, MPU6050_USER_CTRL, MPU6050_USER_FIFO_EN);
+	mpu6050i2c_write_reg(dev, MPU6050_FIFO_EN, MPU6050_FIFO_ACCEL);
+
+	dev->motion.threshold_mg = DIV_ROUND_UP(cfg->threshold_mg, 2) * 2;
+	dev->motion.duration_ms = cfg->duration_ms;
+	dev->motion.enable = 1;
+out:
+	mpu6050i2c_write_reg(dev, MPU6050_INT_ENABLE, mpu6050_int_mask(dev));
+	mpu6050i2c_read_reg(dev, MPU6050_INT_STATUS);
+	*cfg = dev->motion;
+	mutex_unlock(&dev->lock);
+	return ret;
+}
+
+/*
+ * @description	: 读取芯片的零偏补偿寄存器，两组都是高字节在前
+ * @param - dev:  mpu6050i2c设备
+ * @param - off:  输出补偿值
+ * @return 		: 0 成功;其他 失败
+ */
+static int mpu6050_read_offsets(struct mpu6050i2c_dev *dev, struct mpu6050_offsets *off)
+{
+	u8 a[6], g[6];
+	int i, ret;
+
+	ret = mpu6050i2c_read_regs(dev, MPU6050_XA_OFFS_H, a, sizeof(a));
+	if (!ret)
+		ret = mpu6050i2c_read_regs(dev, MPU6050_XG_OFFS_USRH, g, sizeof(g));
+	if (ret)
+		return ret;
+	for (i = 0; i < 3; i++) {
+		off->accel[i] = (s16)(a[i * 2] << 8 | a[i * 2 + 1]);
+		off->gyro[i] = (s16)(g[i * 2] << 8 | g[i * 2 + 1]);
+	}
+	return 0;
+}
+
+/*
+ * @description	: 写入零偏补偿寄存器，加速度寄存器的bit0保留芯片原值
+ * @param - dev:  mpu6050i2c设备
+ * @param - off:  补偿值，写入后按实际寄存器值更新
+ * @return 		: 0 成功;其他 失败
+ */
+static int mpu6050_write_offsets(struct mpu6050i2c_dev *dev, struct mpu6050_offsets *off)
+{
+	struct mpu6050_offsets cur;
+	u8 a[6], g[6];
+	int i, ret;
+
+	ret = mpu6050_read_offsets(dev, &cur);
+	if (ret)
+		return ret;
+	for (i = 0; i < 3; i++) {
+		off->accel[i] = (off->accel[i] & ~1) | (cur.accel[i] & 1);
+		a[i * 2] = (u16)off->accel[i] >> 8;
+		a[i * 2 + 1] = off->accel[i] & 0xff;
+		g[i * 2] = (u16)off->gyro[i] >> 8;
+		g[i * 2 + 1] = off->gyro[i] & 0xff;
+	}
+	if (mpu6050i2c_write_regs(dev, MPU6050_XA_OFFS_H, a, sizeof(a)) != 1 ||
+		mpu6050i2c_write_regs(dev, MPU6050_XG_OFFS_USRH, g, sizeof(g)) != 1)
+		return -EREMOTEIO;
+	return 0;
+}
+
+/*
+ * @description	: 按约1kHz连续读取n个样本，求各轴均值，并检查是否静止。
+ * 				  调用者持有dev->lock
+ * @param - dev:  mpu6050i2c设备
+ * @param - n 	: 样本数
+ * @param - accel:输出加速度均值
+ * @param - gyro: 输出角速度均值
+ * @return 		: 0 成功;EAGAIN 没有静止(均值仍然有效);其他 失败
+ */
+static int mpu6050_average(struct mpu6050i2c_dev *dev, unsigned int n,
+						   s16 accel[3], s16 gyro[3])
+{
+	s64 sum[6] = { 0 };
+	s16 lo[6], hi[6], v[6];
+	unsigned int i, k;
+	int ret;
+
+	for (i = 0; i < n; i++) {
+		ret = mpu6050i2c_readdata(dev);
+		if (ret)
+			return ret;
+		for (k = 0; k < 3; k++) {
+			v[k] = dev->acceleration[k];
+			v[k + 3] = dev->gyro[k];
+		}
+		for (k = 0; k < 6; k++) {
+			sum[k] += v[k];
+			lo[k] = i ? min(lo[k], v[k]) : v[k];
+			hi[k] = i ? max(hi[k], v[k]) : v[k];
+		}
+		usleep_range(1000, 1100);
+	}
+
+	for (k = 0; k < 3; k++) {
+		accel[k] = div_s64(sum[k] + (sum[k] < 0 ? -(s64)n / 2 : n / 2), n);
+		gyro[k] = div_s64(sum[k + 3] + (sum[k + 3] < 0 ? -(s64)n / 2 : n / 2), n);
 	}
+
+	/* 阈值按±2g/±250°/s量程给出，量程越大同样的抖动LSB越少，阈值只会更宽松 */
+	for (k = 0; k < 6; k++) {
+		if (hi[k] - lo[k] > (k < 3 ? MPU6050_CALIB_ACCEL_SPAN : MPU6050_CALIB_GYRO_SPAN))
+			return -EAGAIN;
+	}
+	return 0;
+}
+
+/*
+ * @description	: 静止校准：测零偏，换算成补偿寄存器的单位后在现有值上修正。
+ * 				  补偿寄存器加速度为±16g量程单位，陀螺为±1000°/s量程单位，
+ * 				  当前量程下1LSB零偏对应 (1 << fs) / 8 和 (1 << fs) / 4 个补偿单位
+ * @param - dev:  mpu6050i2c设备
+ * @param - cal:  校准参数和结果
+ * @return 		: 0 成功;其他 失败
+ */
+static int mpu6050_calibrate(struct mpu6050i2c_dev *dev, struct mpu6050_calib *cal)
+{
+	struct mpu6050_offsets off;
+	unsigned int afs, gfs, axis, rate;
+	s16 accel[3], gyro[3];
+	int i, ret;
+
+	if (cal->samples < MPU6050_CALIB_MIN_SAMPLES || cal->samples > MPU6050_CALIB_MAX_SAMPLES ||
+		cal->up_axis > MPU6050_UP_ZNEG)
+		return -EINVAL;
+
+	mutex_lock(&dev->lock);
+	if (dev->mode != MPU6050_MODE_DIRECT || dev->motion.enable) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	/* 按1kHz取样，结束后恢复原来的采样率 */
+	rate = dev->rate_hz;
+	mpu6050_set_rate(dev, 1000);
+	afs = (mpu6050i2c_read_reg(dev, MPU6050_ACCEL_CONFIG) & MPU6050_FS_MASK) >> MPU6050_FS_SHIFT;
+	gfs = (mpu6050i2c_read_reg(dev, MPU6050_GYRO_CONFIG) & MPU6050_FS_MASK) >> MPU6050_FS_SHIFT;
+
+	ret = mpu6050_read_offsets(dev, &off);
+	if (ret)
+		goto restore;
+	ret = mpu6050_average(dev, cal->samples, accel, gyro);
+	if (ret)
+		goto restore;
+
+	/* 朝上的轴应读到1g，扣掉重力后才是零偏 */
+	axis = cal->up_axis / 2;
+	accel[axis] -= (cal->up_axis & 1 ? -1 : 1) * (MPU6050_ACCEL_LSB_PER_G >> afs);
+
+	for (i = 0; i < 3; i++) {
+		cal->accel_bias[i] = accel[i];
+		cal->gyro_bias[i] = gyro[i];
+		off.accel[i] -= DIV_ROUND_CLOSEST(accel[i] * (1 << afs), 8);
+		off.gyro[i] -= DIV_ROUND_CLOSEST(gyro[i] * (1 << gfs), 4);
+	}
+	ret = mpu6050_write_offsets(dev, &off);
+	if (ret)
+		goto restore;
+	cal->offsets = off;
+
+	/* 等补偿生效后复测 */
+	msleep(10);
+	ret = mpu6050_average(dev, cal->samples / 4, accel, gyro);
+	if (ret == -EAGAIN)
+		ret = 0;
+	if (ret)
+		goto restore;
+	accel[axis] -= (cal->up_axis & 1 ? -1 : 1) * (MPU6050_ACCEL_LSB_PER_G >> afs);
+	for (i = 0; i < 3; i++) {
+		cal->accel_residual[i] = accel[i];
+		cal->gyro_residual[i] = gyro[i];
+	}
+restore:
+	mpu6050_set_rate(dev, rate);
+out:
+	mutex_unlock(&dev->lock);
+	return ret;
+}
+
+/*
+ * @description	: probe时恢复保存的校准值，文件不存在时保持芯片当前值
+ * @param - dev:  mpu6050i2c设备
+ * @return 		: 无
+ */
+static void mpu6050_load_calib(struct mpu6050i2c_dev *dev)
+{
+	const struct mpu6050_calib_file *cf;
+	const struct firmware *fw;
+	struct mpu6050_offsets off;
+	char name[40];
+
+	snprintf(name, sizeof(name), "mpu6050-%s.cal", dev_name(&dev->client->dev));
+	if (firmware_request_nowarn(&fw, name, &dev->client->dev))
+		return;
+
+	cf = (const struct mpu6050_calib_file *)fw->data;
+	if (fw->size != sizeof(*cf) || cf->magic != MPU6050_CALIB_MAGIC ||
+		cf->version != MPU6050_CALIB_VERSION) {
+		dev_warn(&dev->client->dev, "%s 格式不对，忽略\n", name);
+	} else {
+		off = cf->offsets;
+		mutex_lock(&dev->lock);
+		if (mpu6050_write_offsets(dev, &off))
+			dev_warn(&dev->client->dev, "写入校准值失败\n");
+		else
+			dev_info(&dev->client->dev, "已恢复校准值 %s\n", name);
+		mutex_unlock(&dev->lock);
+	}
+	release_firmware(fw);
+}
+
+/*
+ * @description	: 释放实例，最后一个引用放掉时调用
+ * @param - kref: 实例的引用计数
+ * @return 		: 无
+ */
+static void mpu6050_dev_release(struct kref *kref)
+{
+	struct mpu6050i2c_dev *dev = container_of(kref, struct mpu6050i2c_dev, kref);
+
+	kfifo_free(&dev->events);
+	kfifo_free(&dev->samples);
+	vfree(dev->ring);
+	kfree(dev->event_buf);
+	kfree(dev->fifo_buf);
+	ida_free(&mpu6050_ida, dev->id);
+	kfree(dev);
+}
+
+/*
+ * @description		: 按次设备号找到实例并取得一个引用
+ * @param - inode 	: 设备节点inode
+ * @return 			: 实例，已解绑时返回NULL
+ */
+static struct mpu6050i2c_dev *mpu6050_get_dev(struct inode *inode)
+{
+	struct mpu6050i2c_dev *dev;
+
+	mutex_lock(&mpu6050_devs_lock);
+	dev = mpu6050_devs[MINOR(inode->i_rdev) / mpu6050i2c_CNT];
+	if (dev)
+		kref_get(&dev->kref);
+	mutex_unlock(&mpu6050_devs_lock);
+	return dev;
+}
+
+/*
+ * @description	: 解绑时从表里摘掉实例，等进行中的ioctl和直接读取结束后
+ * 				  置removed，之后的文件操作都返回ENODEV
+ * @param - dev:  mpu6050i2c设备
+ * @return 		: 无
+ */
+static void mpu6050_unpublish(struct mpu6050i2c_dev *dev)
+{
+	mutex_lock(&mpu6050_devs_lock);
+	mpu6050_devs[dev->id] = NULL;
+	mutex_unlock(&mpu6050_devs_lock);
+
+	down_write(&dev->remove_sem);
+	WRITE_ONCE(dev->removed, true);
+	up_write(&dev->remove_sem);
 }
 
 /*
@@ -178,8 +1260,56 @@ void mpu6050i2c_readdata(struct mpu6050i2c_dev *dev)
  */
 static int mpu6050i2c_open(struct inode *inode, struct file *filp)
 {
-	filp->private_data = &mpu6050i2cdev;
-	return 0;
+	filp->private_data = mpu6050_get_dev(inode);
+	return filp->private_data ? 0 : -ENODEV;
+}
+
+/*
+ * @description		: FIFO/中断模式的读取，阻塞到至少有一条记录
+ * @param - filp 	: 设备文件
+ * @param - dev 	: mpu6050i2c设备
+ * @param - buf 	: 返回给用户空间的数据缓冲区
+ * @param - cnt 	: 缓冲区长度，至少一条记录
+ * @return 			: 读取的字节数，采集被关闭时返回0
+ */
+static ssize_t mpu6050i2c_read_fifo(struct file *filp, struct mpu6050i2c_dev *dev,
+									char __user *buf, size_t cnt)
+{
+	unsigned int copied;
+	int ret;
+
+	if (cnt < sizeof(struct mpu6050_sample))
+		return -EINVAL;
+	cnt = rounddown(cnt, sizeof(struct mpu6050_sample));
+
+	/* 打开mmap共享环形缓冲后记录不再进kfifo */
+	if (READ_ONCE(dev->ring_on))
+		return -EBUSY;
+
+	if (mutex_lock_interruptible(&dev->read_lock))
+		return -ERESTARTSYS;
+	while (kfifo_is_empty(&dev->samples)) {
+		mutex_unlock(&dev->read_lock);
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(dev->wq, !kfifo_is_empty(&dev->samples) ||
+				READ_ONCE(dev->mode) == MPU6050_MODE_DIRECT || READ_ONCE(dev->ring_on) ||
+				READ_ONCE(dev->removed));
+		if (ret)
+			return ret;
+		if (READ_ONCE(dev->removed))
+			return -ENODEV;
+		if (READ_ONCE(dev->mode) == MPU6050_MODE_DIRECT)
+			return 0;
+		if (READ_ONCE(dev->ring_on))
+			return -EBUSY;
+		if (mutex_lock_interruptible(&dev->read_lock))
+			return -ERESTARTSYS;
+	}
+	ret = kfifo_to_user(&dev->samples, buf, cnt, &copied);
+	mutex_unlock(&dev->read_lock);
+
+	return ret ? ret : copied;
 }
 
 /*
@@ -193,30 +1323,232 @@ static int mpu6050i2c_open(struct inode *inode, struct file *filp)
 static ssize_t mpu6050i2c_read(struct file *filp, char __user *buf, size_t cnt, loff_t *off)
 {
 	int16_t data[7];
-	long err = 0;
+	int ret;
 
 	struct mpu6050i2c_dev *dev = (struct mpu6050i2c_dev *)filp->private_data;
-	
-	mpu6050i2c_readdata(dev);
-
-	data[0] = dev->acceleration[0];
-	data[1] = dev->acceleration[1];
-	data[2] = dev->acceleration[2];
-	data[3] = dev->gyro[0];
-	data[4] = dev->gyro[1];
-	data[5] = dev->gyro[2];
-	data[6] = dev->temp;
-	err = copy_to_user(buf, data, sizeof(data));
+
+	if (READ_ONCE(dev->removed))
+		return -ENODEV;
+
+	/* FIFO/中断模式下返回整块记录 */
+	if (READ_ONCE(dev->mode) != MPU6050_MODE_DIRECT)
+		return mpu6050i2c_read_fifo(filp, dev, buf, cnt);
+
+	if (cnt < sizeof(data))
+		return -EINVAL;
+
+	down_read(&dev->remove_sem);
+	if (dev->removed) {
+		up_read(&dev->remove_sem);
+		return -ENODEV;
+	}
+	/* 校准和其他读者也会改写dev里的数据，在锁内取出，保证7个值来自同一次读取 */
+	mutex_lock(&dev->lock);
+	ret = mpu6050i2c_readdata(dev);
+	if (!ret) {
+		data[0] = dev->acceleration[0];
+		data[1] = dev->acceleration[1];
+		data[2] = dev->acceleration[2];
+		data[3] = dev->gyro[0];
+		data[4] = dev->gyro[1];
+		data[5] = dev->gyro[2];
+		data[6] = dev->temp;
+	}
+	mutex_unlock(&dev->lock);
+	up_read(&dev->remove_sem);
+	if (ret)
+		return ret;
+
+	if (copy_to_user(buf, data, sizeof(data)))
+		return -EFAULT;
+	return sizeof(data);
+}
+
+/*
+ * @description		: poll，FIFO/中断模式下有记录时可读(kfifo或共享环形缓冲)，
+ * 					  直接读寄存器模式总是可读
+ * @param - filp 	: 设备文件
+ * @param - wait 	: poll表
+ * @return 			: 事件掩码
+ */
+static __poll_t mpu6050i2c_poll(struct file *filp, poll_table *wait)
+{
+	struct mpu6050i2c_dev *dev = (struct mpu6050i2c_dev *)filp->private_data;
+
+	poll_wait(filp, &dev->wq, wait);
+	if (READ_ONCE(dev->removed))
+		return EPOLLERR | EPOLLHUP;
+	if (READ_ONCE(dev->mode) == MPU6050_MODE_DIRECT || mpu6050_samples_ready(dev))
+		return EPOLLIN | EPOLLRDNORM;
 	return 0;
 }
 
 /*
- * @description		: 关闭/释放设备
+ * @description		: 把共享环形缓冲映射到用户空间，只能从偏移0开始映射
+ * @param - filp 	: 设备文件
+ * @param - vma 	: 用户空间映射区
+ * @return 			: 0 成功;其他 失败
+ */
+static int mpu6050i2c_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct mpu6050i2c_dev *dev = (struct mpu6050i2c_dev *)filp->private_data;
+
+	if (READ_ONCE(dev->removed))
+		return -ENODEV;
+	if (vma->vm_pgoff)
+		return -EINVAL;
+	/* 长度超出缓冲区时remap_vmalloc_range返回EINVAL */
+	return remap_vmalloc_range(vma, dev->ring, 0);
+}
+
+/*
+ * @description		: 打开/关闭共享环形缓冲输出，打开时head/tail清零
+ * @param - dev 	: mpu6050i2c设备
+ * @param - on 		: 1打开 0关闭
+ * @return 			: 无
+ */
+static void mpu6050_ring_enable(struct mpu6050i2c_dev *dev, bool on)
+{
+	mutex_lock(&dev->lock);
+	mutex_lock(&dev->read_lock);
+	if (on) {
+		WRITE_ONCE(dev->ring->head, 0);
+		WRITE_ONCE(dev->ring->tail, 0);
+		WRITE_ONCE(dev->ring->lost, 0);
+	}
+	kfifo_reset(&dev->samples);
+	dev->overflow = false;
+	mpu6050_decimate_reset(dev);
+	WRITE_ONCE(dev->ring_on, on);
+	mutex_unlock(&dev->read_lock);
+	mutex_unlock(&dev->lock);
+	/* 唤醒阻塞在旧输出方式上的读者 */
+	wake_up_interruptible(&dev->wq);
+}
+
+/*
+ * @description		: ioctl，配置FIFO模式、数据就绪中断模式、运动检测、零偏校准和滤波，
+ * 					  调用者持有remove_sem读锁
+ * @param - dev 	: mpu6050i2c设备
+ * @param - cmd 	: MPU6050_IOC_*
+ * @param - arg 	: 用户空间参数地址
+ * @return 			: 0 成功;其他 失败
+ */
+static long mpu6050i2c_do_ioctl(struct mpu6050i2c_dev *dev, unsigned int cmd, unsigned long arg)
+{
+	void __user *argp = (void __user *)arg;
+	struct mpu6050_fifo_config cfg;
+	struct mpu6050_motion_config mot;
+	struct mpu6050_calib cal;
+	struct mpu6050_offsets off;
+	struct mpu6050_filter_config flt;
+	u32 rate;
+	int ret;
+
+	switch (cmd) {
+	case MPU6050_IOC_SET_FIFO:
+		if (copy_from_user(&cfg, argp, sizeof(cfg)))
+			return -EFAULT;
+		return mpu6050_fifo_config(dev, &cfg);
+	case MPU6050_IOC_GET_FIFO:
+		mutex_lock(&dev->lock);
+		cfg.mask = dev->fifo_mask;
+		cfg.rate_hz = dev->mode == MPU6050_MODE_FIFO ? dev->rate_hz : 0;
+		cfg.reserved = 0;
+		mutex_unlock(&dev->lock);
+		return copy_to_user(argp, &cfg, sizeof(cfg)) ? -EFAULT : 0;
+	case MPU6050_IOC_SET_DRDY:
+		if (get_user(rate, (u32 __user *)argp))
+			return -EFAULT;
+		return mpu6050_drdy_config(dev, &rate);
+	case MPU6050_IOC_GET_DRDY:
+		mutex_lock(&dev->lock);
+		rate = dev->mode == MPU6050_MODE_DRDY ? dev->rate_hz : 0;
+		mutex_unlock(&dev->lock);
+		return put_user(rate, (u32 __user *)argp);
+	case MPU6050_IOC_SET_MOTION:
+		if (copy_from_user(&mot, argp, sizeof(mot)))
+			return -EFAULT;
+		ret = mpu6050_motion_config(dev, &mot);
+		if (ret)
+			return ret;
+		return copy_to_user(argp, &mot, sizeof(mot)) ? -EFAULT : 0;
+	case MPU6050_IOC_GET_MOTION:
+		mutex_lock(&dev->lock);
+		mot = dev->motion;
+		mutex_unlock(&dev->lock);
+		return copy_to_user(argp, &mot, sizeof(mot)) ? -EFAULT : 0;
+	case MPU6050_IOC_SET_RING:
+		if (get_user(rate, (u32 __user *)argp))
+			return -EFAULT;
+		mpu6050_ring_enable(dev, rate != 0);
+		return 0;
+	case MPU6050_IOC_CALIBRATE:
+		if (copy_from_user(&cal, argp, sizeof(cal)))
+			return -EFAULT;
+		ret = mpu6050_calibrate(dev, &cal);
+		if (ret)
+			return ret;
+		return copy_to_user(argp, &cal, sizeof(cal)) ? -EFAULT : 0;
+	case MPU6050_IOC_GET_OFFSETS:
+		mutex_lock(&dev->lock);
+		ret = mpu6050_read_offsets(dev, &off);
+		mutex_unlock(&dev->lock);
+		if (ret)
+			return ret;
+		return copy_to_user(argp, &off, sizeof(off)) ? -EFAULT : 0;
+	case MPU6050_IOC_SET_OFFSETS:
+		if (copy_from_user(&off, argp, sizeof(off)))
+			return -EFAULT;
+		mutex_lock(&dev->lock);
+		ret = mpu6050_write_offsets(dev, &off);
+		mutex_unlock(&dev->lock);
+		return ret;
+	case MPU6050_IOC_SET_FILTER:
+		if (copy_from_user(&flt, argp, sizeof(flt)))
+			return -EFAULT;
+		ret = mpu6050_set_filter(dev, &flt);
+		if (ret)
+			return ret;
+		return copy_to_user(argp, &flt, sizeof(flt)) ? -EFAULT : 0;
+	case MPU6050_IOC_GET_FILTER:
+		mutex_lock(&dev->lock);
+		mpu6050_get_filter(dev, &flt);
+		mutex_unlock(&dev->lock);
+		return copy_to_user(argp, &flt, sizeof(flt)) ? -EFAULT : 0;
+	default:
+		return -ENOTTY;
+	}
+}
+
+/*
+ * @description		: ioctl入口，解绑之后返回ENODEV
+ * @param - filp 	: 设备文件
+ * @param - cmd 	: MPU6050_IOC_*
+ * @param - arg 	: 用户空间参数地址
+ * @return 			: 0 成功;其他 失败
+ */
+static long mpu6050i2c_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct mpu6050i2c_dev *dev = (struct mpu6050i2c_dev *)filp->private_data;
+	long ret;
+
+	down_read(&dev->remove_sem);
+	ret = dev->removed ? -ENODEV : mpu6050i2c_do_ioctl(dev, cmd, arg);
+	up_read(&dev->remove_sem);
+	return ret;
+}
+
+/*
+ * @description		: 关闭/释放设备，放掉open时取得的引用
  * @param - filp 	: 要关闭的设备文件(文件描述符)
  * @return 			: 0 成功;其他 失败
  */
 static int mpu6050i2c_release(struct inode *inode, struct file *filp)
 {
+	struct mpu6050i2c_dev *dev = (struct mpu6050i2c_dev *)filp->private_data;
+
+	kref_put(&dev->kref, mpu6050_dev_release);
 	return 0;
 }
 
@@ -225,49 +1557,253 @@ static const struct file_operations mpu6050i2c_ops = {
 	.owner = THIS_MODULE,
 	.open = mpu6050i2c_open,
 	.read = mpu6050i2c_read,
+	.poll = mpu6050i2c_poll,
+	.mmap = mpu6050i2c_mmap,
+	.unlocked_ioctl = mpu6050i2c_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.release = mpu6050i2c_release,
+};
+
+/*
+ * @description		: 打开事件节点
+ * @param - inode 	: 传递给驱动的inode
+ * @param - filp 	: 设备文件
+ * @return 			: 0 成功;其他 失败
+ */
+static int mpu6050_event_open(struct inode *inode, struct file *filp)
+{
+	filp->private_data = mpu6050_get_dev(inode);
+	return filp->private_data ? 0 : -ENODEV;
+}
+
+/*
+ * @description		: 从事件节点读取运动事件，阻塞到至少有一个事件
+ * @param - filp 	: 设备文件
+ * @param - buf 	: 返回给用户空间的数据缓冲区
+ * @param - cnt 	: 缓冲区长度，至少一个事件
+ * @param - offt 	: 相对于文件首地址的偏移
+ * @return 			: 读取的字节数，如果为负值，表示读取失败
+ */
+static ssize_t mpu6050_event_read(struct file *filp, char __user *buf, size_t cnt, loff_t *off)
+{
+	struct mpu6050i2c_dev *dev = (struct mpu6050i2c_dev *)filp->private_data;
+	unsigned int copied;
+	int ret;
+
+	if (READ_ONCE(dev->removed))
+		return -ENODEV;
+	if (cnt < sizeof(struct mpu6050_event))
+		return -EINVAL;
+	cnt = rounddown(cnt, sizeof(struct mpu6050_event));
+
+	if (mutex_lock_interruptible(&dev->event_lock))
+		return -ERESTARTSYS;
+	while (kfifo_is_empty(&dev->events)) {
+		mutex_unlock(&dev->event_lock);
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(dev->event_wq, !kfifo_is_empty(&dev->events) ||
+				READ_ONCE(dev->removed));
+		if (ret)
+			return ret;
+		if (READ_ONCE(dev->removed))
+			return -ENODEV;
+		if (mutex_lock_interruptible(&dev->event_lock))
+			return -ERESTARTSYS;
+	}
+	ret = kfifo_to_user(&dev->events, buf, cnt, &copied);
+	mutex_unlock(&dev->event_lock);
+
+	return ret ? ret : copied;
+}
+
+/*
+ * @description		: 事件节点poll，有事件时可读
+ * @param - filp 	: 设备文件
+ * @param - wait 	: poll表
+ * @return 			: 事件掩码
+ */
+static __poll_t mpu6050_event_poll(struct file *filp, poll_table *wait)
+{
+	struct mpu6050i2c_dev *dev = (struct mpu6050i2c_dev *)filp->private_data;
+
+	poll_wait(filp, &dev->event_wq, wait);
+	if (READ_ONCE(dev->removed))
+		return EPOLLERR | EPOLLHUP;
+	return kfifo_is_empty(&dev->events) ? 0 : EPOLLIN | EPOLLRDNORM;
+}
+
+/* 事件节点操作函数，运动检测的配置仍通过数据节点的ioctl */
+static const struct file_operations mpu6050_event_ops = {
+	.owner = THIS_MODULE,
+	.open = mpu6050_event_open,
+	.read = mpu6050_event_read,
+	.poll = mpu6050_event_poll,
 	.release = mpu6050i2c_release,
 };
 
  /*
   * @description     : i2c驱动的probe函数，当驱动与
-  *                    设备匹配以后此函数就会执行
+  *                    设备匹配以后此函数就会执行。每个芯片分配独立的状态、
+  *                    缓冲区、排空线程和中断，节点为 /dev/mpu6050-N
   * @param - client  : i2c设备
   * @param - id      : i2c设备ID
   * @return          : 0，成功;其他负值,失败
   */
 static int mpu6050i2c_probe(struct i2c_client *client, const struct i2c_device_id *id)
 {
-	/* 1、构建设备号 */
-	if (mpu6050i2cdev.major) {
-		mpu6050i2cdev.devid = MKDEV(mpu6050i2cdev.major, 0);
-		register_chrdev_region(mpu6050i2cdev.devid, mpu6050i2c_CNT, mpu6050i2c_NAME);
-	} else {
-		alloc_chrdev_region(&mpu6050i2cdev.devid, 0, mpu6050i2c_CNT, mpu6050i2c_NAME);
-		mpu6050i2cdev.major = MAJOR(mpu6050i2cdev.devid);
+	struct mpu6050i2c_dev *dev;
+	int ret;
+
+	/* 解绑后打开的文件可能还在用，不能用devm，按引用计数释放 */
+	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+	if (!dev)
+		return -ENOMEM;
+	kref_init(&dev->kref);
+	init_rwsem(&dev->remove_sem);
+	dev->client = client;
+	i2c_set_clientdata(client, dev);
+
+	dev->id = ida_alloc_max(&mpu6050_ida, MPU6050_MAX_DEVICES - 1, GFP_KERNEL);
+	if (dev->id < 0) {
+		ret = dev->id;
+		kfree(dev);
+		return ret;
 	}
+	snprintf(dev->name, sizeof(dev->name), "mpu6050-%d", dev->id);
+	dev->devid = MKDEV(MAJOR(mpu6050_devt), dev->id * mpu6050i2c_CNT);
 
-	/* 2、注册设备 */
-	cdev_init(&mpu6050i2cdev.cdev, &mpu6050i2c_ops);
-	cdev_add(&mpu6050i2cdev.cdev, mpu6050i2cdev.devid, mpu6050i2c_CNT);
+	/* 0、FIFO/中断模式用到的缓冲区和同步对象 */
+	mutex_init(&dev->lock);
+	mutex_init(&dev->read_lock);
+	init_waitqueue_head(&dev->wq);
+	INIT_DELAYED_WORK(&dev->drain_work, mpu6050_drain_work);
+	init_waitqueue_head(&dev->event_wq);
+	mutex_init(&dev->event_lock);
+	dev->mode = MPU6050_MODE_DIRECT;
+	dev->dlpf = MPU6050_DLPF_188HZ;
+	dev->decimate = 1;
+	dev->rate_hz = MPU6050_DEFAULT_RATE_HZ;
 
-	/* 3、创建类 */
-	mpu6050i2cdev.class = class_create(THIS_MODULE, mpu6050i2c_NAME);
-	if (IS_ERR(mpu6050i2cdev.class)) {
-		return PTR_ERR(mpu6050i2cdev.class);
+	/* 以下缓冲区都在最后一个引用放掉时由 mpu6050_dev_release 释放 */
+	dev->fifo_buf = kmalloc(MPU6050_FIFO_SIZE, GFP_KERNEL);
+	dev->event_buf = kmalloc(sizeof(struct mpu6050_event), GFP_KERNEL);
+	if (!dev->fifo_buf || !dev->event_buf) {
+		ret = -ENOMEM;
+		goto put_dev;
+	}
+	/* vmalloc_user分配的内存已清零，可以用remap_vmalloc_range映射给用户 */
+	dev->ring = vmalloc_user(MPU6050_RING_BYTES);
+	if (!dev->ring) {
+		ret = -ENOMEM;
+		goto put_dev;
 	}
+	dev->ring->slots = MPU6050_RING_SLOTS;
+	ret = kfifo_alloc(&dev->samples, MPU6050_SAMPLE_BUF, GFP_KERNEL);
+	if (ret)
+		goto put_dev;
+	ret = kfifo_alloc(&dev->events, MPU6050_EVENT_BUF, GFP_KERNEL);
+	if (ret)
+		goto put_dev;
+	/* 每个芯片一个有序的高优先级工作队列，两个芯片的排空可以并行 */
+	dev->drain_wq = alloc_ordered_workqueue("%s", WQ_HIGHPRI | WQ_MEM_RECLAIM, dev->name);
+	if (!dev->drain_wq) {
+		ret = -ENOMEM;
+		goto put_dev;
+	}
+
+	mpu6050_reset(dev);
+	/* 上电默认DLPF关闭、8kHz，改为驱动的默认带宽、采样率和最小量程 */
+	mutex_lock(&dev->lock);
+	mpu6050_apply_filter(dev);
+	mutex_unlock(&dev->lock);
+	/* 补偿寄存器掉电丢失，每次probe从文件恢复 */
+	mpu6050_load_calib(dev);
 
-	/* 4、创建设备 */
-	mpu6050i2cdev.device = device_create(mpu6050i2cdev.class, NULL, mpu6050i2cdev.devid, NULL, mpu6050i2c_NAME);
-	if (IS_ERR(mpu6050i2cdev.device)) {
-		return PTR_ERR(mpu6050i2cdev.device);
+	/*
+	 * INT引脚(设备树interrupts属性)，没有接时只能用FIFO模式。
+	 * 中断一直开着，由芯片的INT_ENABLE决定哪些中断源会拉高INT。
+	 * 不用devm，remove里要在放掉引用之前释放
+	 */
+	dev->irq = client->irq;
+	if (dev->irq > 0) {
+		ret = request_threaded_irq(dev->irq, mpu6050_irq, mpu6050_irq_thread,
+				IRQF_TRIGGER_HIGH | IRQF_ONESHOT,
+				dev->name, dev);
+		if (ret) {
+			dev_warn(&client->dev, "申请中断%d失败(%d)，数据就绪和运动检测不可用\n",
+					 dev->irq, ret);
+			dev->irq = 0;
+		}
 	}
 
-	mpu6050i2cdev.private_data = client;
-	
-	mpu6050_reset();
-	printk("mpu6050_reset\n");
+	/*
+	 * 1、注册设备，节点创建之前所有状态都已就绪。
+	 * 关闭文件时内核在release之后还会访问cdev，cdev不能嵌在实例里随实例释放
+	 */
+	dev->cdev = cdev_alloc();
+	dev->event_cdev = cdev_alloc();
+	if (!dev->cdev || !dev->event_cdev) {
+		ret = -ENOMEM;
+		goto put_cdev;
+	}
+	dev->cdev->ops = &mpu6050i2c_ops;
+	dev->cdev->owner = THIS_MODULE;
+	dev->event_cdev->ops = &mpu6050_event_ops;
+	dev->event_cdev->owner = THIS_MODULE;
+	ret = cdev_add(dev->cdev, dev->devid, 1);
+	if (ret)
+		goto put_cdev;
+	ret = cdev_add(dev->event_cdev, dev->devid + 1, 1);
+	if (ret)
+		goto del_cdev;
+
+	mutex_lock(&mpu6050_devs_lock);
+	mpu6050_devs[dev->id] = dev;
+	mutex_unlock(&mpu6050_devs_lock);
 
+	/* 2、创建设备 */
+	dev->device = device_create_with_groups(mpu6050_class, &client->dev, dev->devid, dev,
+											mpu6050_groups, "%s", dev->name);
+	if (IS_ERR(dev->device)) {
+		ret = PTR_ERR(dev->device);
+		goto unpublish;
+	}
+	dev->event_device = device_create(mpu6050_class, &client->dev, dev->devid + 1, dev,
+									  "%s-event", dev->name);
+	if (IS_ERR(dev->event_device)) {
+		ret = PTR_ERR(dev->event_device);
+		goto destroy_device;
+	}
+
+	dev_info(&client->dev, "/dev/%s 地址0x%02x\n", dev->name, client->addr);
 	return 0;
+
+destroy_device:
+	device_destroy(mpu6050_class, dev->devid);
+unpublish:
+	mpu6050_unpublish(dev);
+	cdev_del(dev->event_cdev);
+	cdev_del(dev->cdev);
+	goto release_irq;
+del_cdev:
+	cdev_del(dev->cdev);
+	kobject_put(&dev->event_cdev->kobj);
+	goto release_irq;
+put_cdev:
+	/* 没有cdev_add成功的cdev直接放掉引用 */
+	if (dev->cdev)
+		kobject_put(&dev->cdev->kobj);
+	if (dev->event_cdev)
+		kobject_put(&dev->event_cdev->kobj);
+release_irq:
+	/* 芯片中断源还没打开，中断线程不会访问缓冲区 */
+	if (dev->irq > 0)
+		free_irq(dev->irq, dev);
+	destroy_workqueue(dev->drain_wq);
+put_dev:
+	kref_put(&dev->kref, mpu6050_dev_release);
+	return ret;
 }
 
 /*
@@ -277,13 +1813,28 @@ static int mpu6050i2c_probe(struct i2c_client *client, const struct i2c_device_i
  */
 static int mpu6050i2c_remove(struct i2c_client *client)
 {
-	/* 删除设备 */
-	cdev_del(&mpu6050i2cdev.cdev);
-	unregister_chrdev_region(mpu6050i2cdev.devid, mpu6050i2c_CNT);
+	struct mpu6050i2c_dev *dev = i2c_get_clientdata(client);
+	struct mpu6050_motion_config off = { 0 };
 
-	/* 注销掉类和设备 */
-	device_destroy(mpu6050i2cdev.class, mpu6050i2cdev.devid);
-	class_destroy(mpu6050i2cdev.class);
+	/* 先删除节点，不再有新的打开；等进行中的ioctl结束，已打开的文件之后返回ENODEV */
+	device_destroy(mpu6050_class, dev->devid + 1);
+	device_destroy(mpu6050_class, dev->devid);
+	mpu6050_unpublish(dev);
+	cdev_del(dev->event_cdev);
+	cdev_del(dev->cdev);
+
+	/* 停止运动检测、FIFO排空和数据就绪中断 */
+	mpu6050_motion_config(dev, &off);
+	mpu6050_stop_capture(dev);
+	/* 芯片不再产生中断，free_irq等中断线程结束 */
+	if (dev->irq > 0)
+		free_irq(dev->irq, dev);
+	destroy_workqueue(dev->drain_wq);
+
+	/* 唤醒阻塞在已解绑设备上的读者，缓冲区等最后一个文件关闭后再释放 */
+	wake_up_all(&dev->wq);
+	wake_up_all(&dev->event_wq);
+	kref_put(&dev->kref, mpu6050_dev_release);
 	return 0;
 }
 
@@ -320,7 +1871,26 @@ static int __init mpu6050i2c_init(void)
 {
 	int ret = 0;
 
+	/* 所有实例的设备号一次申请好，probe时按实例编号取用 */
+	ret = alloc_chrdev_region(&mpu6050_devt, 0, MPU6050_MAX_DEVICES * mpu6050i2c_CNT,
+							  mpu6050i2c_NAME);
+	if (ret)
+		return ret;
+	mpu6050_class = class_create(THIS_MODULE, mpu6050i2c_NAME);
+	if (IS_ERR(mpu6050_class)) {
+		ret = PTR_ERR(mpu6050_class);
+		goto unregister;
+	}
+
 	ret = i2c_add_driver(&mpu6050i2c_driver);
+	if (ret)
+		goto destroy_class;
+	return 0;
+
+destroy_class:
+	class_destroy(mpu6050_class);
+unregister:
+	unregister_chrdev_region(mpu6050_devt, MPU6050_MAX_DEVICES * mpu6050i2c_CNT);
 	return ret;
 }
 
@@ -332,6 +1902,9 @@ static int __init mpu6050i2c_init(void)
 static void __exit mpu6050i2c_exit(void)
 {
 	i2c_del_driver(&mpu6050i2c_driver);
+	class_destroy(mpu6050_class);
+	unregister_chrdev_region(mpu6050_devt, MPU6050_MAX_DEVICES * mpu6050i2c_CNT);
+	ida_destroy(&mpu6050_ida);
 }
 
 /* module_i2c_driver(mpu6050i2c_driver) */
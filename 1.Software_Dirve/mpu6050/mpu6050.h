@@ -70,16 +70,56 @@
 #define QMA6100P_OS_CUST_X		    0x27
 #define QMA6100P_OS_CUST_Y			0x28
 #define QMA6100P_OS_CUST_Z			0x29
+#define QMA6100P_MOT_CFG_DUR		0x2c	/* [7:2] no-motion时长 [1:0] any-motion时长 */
+#define QMA6100P_NO_MOT_TH			0x2d
+#define QMA6100P_ANY_MOT_TH			0x2e
+#define QMA6100P_FIFO_WM			0x31	/* FIFO水位，帧数 */
 
 #define QMA6100P_REG_NVM			0x33
 #define QMA6100P_REG_RESET			0x36
+#define QMA6100P_FIFO_CFG			0x3e	/* [7:6] FIFO模式 [2:0] 通道使能，写入时复位FIFO */
+#define QMA6100P_FIFO_DATA			0x3f	/* 每帧6字节 XL XH YL YH ZL ZH */
 
+#define QMA6100P_FIFO_DEPTH			64
+#define QMA6100P_FIFO_FRAME			6
+#define QMA6100P_FIFO_STATE_MASK	0x7f
+#define QMA6100P_FIFO_CFG_BYPASS	0x00
+#define QMA6100P_FIFO_CFG_FIFO		0x40
+#define QMA6100P_FIFO_CFG_STREAM	0x80
+#define QMA6100P_FIFO_CFG_XYZ		0x07
+
+#define QMA6100P_RESET_VALUE		0xb6
+#define QMA6100P_MODE_ACTIVE_BIT	0x80	/* REG_POWER_MANAGE */
 
 #define QMA6100P_DRDY_BIT			0x10
 
+/* INT_STATUS_0 */
 #define QMA6100P_AMD_X_BIT			0x01
 #define QMA6100P_AMD_Y_BIT			0x02
 #define QMA6100P_AMD_Z_BIT			0x04
+#define QMA6100P_AMD_SIGN_BIT		0x08	/* 首个触发轴的方向，1为负 */
+#define QMA6100P_NMD_BIT			0x80
+/* INT_STATUS_2 */
+#define QMA6100P_FIFO_FULL_BIT		0x20
+#define QMA6100P_FIFO_WMK_BIT		0x40
+
+/* INT_EN_1 */
+#define QMA6100P_INT_EN_DRDY		0x10
+#define QMA6100P_INT_EN_FIFO_FULL	0x20
+#define QMA6100P_INT_EN_FIFO_WMK	0x40
+/* INT_EN_2 */
+#define QMA6100P_INT_EN_AMD_XYZ		0x07
+#define QMA6100P_INT_EN_NMD_XYZ		0xe0
+/* INT1_MAP_1 */
+#define QMA6100P_INT1_MAP_AMD		0x01
+#define QMA6100P_INT1_MAP_DRDY		0x10
+#define QMA6100P_INT1_MAP_FIFO_FULL	0x20
+#define QMA6100P_INT1_MAP_FIFO_WMK	0x40
+#define QMA6100P_INT1_MAP_NMD		0x80
+/* INTPIN_CFG / INT_CFG */
+#define QMA6100P_INT1_ACTIVE_HIGH	0x01
+#define QMA6100P_INT_LATCH			0x01
+#define QMA6100P_INT_RD_CLR			0x80	/* 读任意寄存器清中断 */
 
 enum qma6100p_enable {
 	QMA6100P_DISABLE = 0,
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+
+#include "mpu6050i2c.h"
+/***************************************************************
+描述	   	: mpu6050 静止校准工具
+用法	   	: mpu6050_calib <设备> [样本数] [朝上的轴] [固件目录]
+			  例：mpu6050_calib /dev/mpu6050-0 1000 +z
+			  芯片静止放置，驱动测出零偏并写入芯片的补偿寄存器，
+			  本工具再把补偿值保存到 <固件目录>/mpu6050-<I2C设备名>.cal
+			  (默认 /lib/firmware)，驱动下次probe时自动恢复。
+编译	   	: riscv64-buildroot-linux-gnu-gcc -O2 -o mpu6050_calib mpu6050_calib.c
+***************************************************************/
+
+static const char *up_names[] = { "+x", "-x", "+y", "-y", "+z", "-z" };
+
+/*
+ * @description		: 由 /dev/mpu6050-N 找到所属I2C设备名，例如 1-0068
+ * @param - devname : 设备节点路径
+ * @param - out 	: 输出I2C设备名
+ * @param - len 	: out长度
+ * @return 			: 0 成功;其他 失败
+ */
+static int i2c_name(const char *devname, char *out, size_t len)
+{
+	char path[PATH_MAX], link[PATH_MAX], tmp[PATH_MAX];
+	ssize_t n;
+
+	snprintf(tmp, sizeof(tmp), "%s", devname);
+	snprintf(path, sizeof(path), "/sys/class/mpu6050i2c/%s/device", basename(tmp));
+	n = readlink(path, link, sizeof(link) - 1);
+	if (n < 0)
+		return -1;
+	link[n] = '\0';
+	snprintf(out, len, "%s", basename(link));
+	return 0;
+}
+
+/*
+ * @description		: main主程序
+ * @param - argc 	: argv数组元素个数
+ * @param - argv 	: 具体参数
+ * @return 			: 0 成功;其他 失败
+ */
+int main(int argc, char *argv[])
+{
+	struct mpu6050_calib cal;
+	struct mpu6050_calib_file cf;
+	const char *fwdir = argc > 4 ? argv[4] : "/lib/firmware";
+	char name[64], path[PATH_MAX];
+	unsigned int i;
+	FILE *fp;
+	int fd;
+
+	if (argc < 2) {
+		printf("Usage: %s <dev> [samples] [+x|-x|+y|-y|+z|-z] [firmware dir]\n", argv[0]);
+		return 1;
+	}
+
+	memset(&cal, 0, sizeof(cal));
+	cal.samples = argc > 2 ? strtoul(argv[2], NULL, 0) : 1000;
+	cal.up_axis = MPU6050_UP_ZPOS;
+	if (argc > 3) {
+		for (i = 0; i < 6 && strcmp(argv[3], up_names[i]); i++)
+			;
+		if (i == 6) {
+			printf("朝上的轴应为 +x/-x/+y/-y/+z/-z\n");
+			return 1;
+		}
+		cal.up_axis = i;
+	}
+
+	fd = open(argv[1], O_RDWR);
+	if (fd < 0) {
+		perror("设备打开失败");
+		return -1;
+	}
+	printf("校准中，%u 个样本，%s 朝上，保持静止...\n", cal.samples, up_names[cal.up_axis]);
+	if (ioctl(fd, MPU6050_IOC_CALIBRATE, &cal) < 0) {
+		if (errno == EAGAIN)
+			printf("采样期间芯片有晃动，请放稳后重试\n");
+		else if (errno == EBUSY)
+			printf("设备正在采集或运动检测，先关闭后再校准\n");
+		else
+			perror("校准失败");
+		close(fd);
+		return -1;
+	}
+	close(fd);
+
+	printf("零偏      Acc %6d %6d %6d  Gyro %6d %6d %6d\n",
+		   cal.accel_bias[0], cal.accel_bias[1], cal.accel_bias[2],
+		   cal.gyro_bias[0], cal.gyro_bias[1], cal.gyro_bias[2]);
+	printf("残余零偏  Acc %6d %6d %6d  Gyro %6d %6d %6d\n",
+		   cal.accel_residual[0], cal.accel_residual[1], cal.accel_residual[2],
+		   cal.gyro_residual[0], cal.gyro_residual[1], cal.gyro_residual[2]);
+	printf("补偿值    Acc %6d %6d %6d  Gyro %6d %6d %6d\n",
+		   cal.offsets.accel[0], cal.offsets.accel[1], cal.offsets.accel[2],
+		   cal.offsets.gyro[0], cal.offsets.gyro[1], cal.offsets.gyro[2]);
+
+	if (i2c_name(argv[1], name, sizeof(name))) {
+		perror("查找I2C设备失败，补偿值已写入芯片但没有保存");
+		return -1;
+	}
+	snprintf(path, sizeof(path), "%s/mpu6050-%s.cal", fwdir, name);
+	cf.magic = MPU6050_CALIB_MAGIC;
+	cf.version = MPU6050_CALIB_VERSION;
+	cf.offsets = cal.offsets;
+	fp = fopen(path, "wb");
+	if (!fp || fwrite(&cf, sizeof(cf), 1, fp) != 1) {
+		perror(path);
+		if (fp)
+			fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+	printf("已保存到 %s\n", path);
+	return 0;
+}
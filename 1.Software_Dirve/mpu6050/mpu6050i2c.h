@@ -0,0 +1,237 @@
+/*
+ * MPU6050 驱动与应用程序共用的数据结构和ioctl定义
+ *
+ * 每个芯片一组节点，N按probe顺序从0开始编号：
+ *   /dev/mpu6050-N        数据节点，read/poll/ioctl/mmap
+ *   /dev/mpu6050-N-event  运动/冲击事件节点
+ * 节点的父设备是I2C设备，可以从 /sys/class/mpu6050i2c/mpu6050-N/device 查到总线和地址。
+ */
+#ifndef __MPU6050I2C_H
+#define __MPU6050I2C_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/* FIFO/数据就绪中断模式下 read() 一次返回多条的记录，未使能的通道为0 */
+struct mpu6050_sample {
+	__s64 timestamp_ns;		/* 采样时刻，CLOCK_BOOTTIME */
+	__s16 accel[3];			/* 加速度原始值 X/Y/Z */
+	__s16 temp;				/* 温度原始值，℃ = temp / 340 + 36.53 */
+	__s16 gyro[3];			/* 角速度原始值 X/Y/Z */
+	__u16 flags;			/* MPU6050_SAMPLE_* */
+};
+
+/* 本记录之前有样本丢失(芯片FIFO溢出被复位，或驱动缓冲区满) */
+#define MPU6050_SAMPLE_OVERFLOW		0x01
+
+/* FIFO通道选择，与 FIFO_EN(0x23) 寄存器位一致 */
+#define MPU6050_FIFO_TEMP			0x80
+#define MPU6050_FIFO_XG				0x40
+#define MPU6050_FIFO_YG				0x20
+#define MPU6050_FIFO_ZG				0x10
+#define MPU6050_FIFO_ACCEL			0x08
+#define MPU6050_FIFO_GYRO			(MPU6050_FIFO_XG | MPU6050_FIFO_YG | MPU6050_FIFO_ZG)
+#define MPU6050_FIFO_ALL			(MPU6050_FIFO_ACCEL | MPU6050_FIFO_TEMP | MPU6050_FIFO_GYRO)
+
+/*
+ * 采样率范围(Hz)。不超过1kHz时DLPF打开，内部输出率1kHz经SMPLRT_DIV分频；
+ * 更高时DLPF关闭，从陀螺的8kHz分频，但加速度仍然只有1kHz更新。
+ * 高采样率只适合FIFO模式少量通道，数据就绪中断模式最高1kHz。
+ */
+#define MPU6050_RATE_MIN_HZ			4
+#define MPU6050_RATE_MAX_HZ			8000
+#define MPU6050_DRDY_MAX_HZ			1000
+
+/* 驱动缓冲的记录条数，1kHz下约2秒 */
+#define MPU6050_SAMPLE_BUF			2048
+
+/* 事件节点 /dev/mpu6050-N-event 上 read() 返回的运动/冲击事件 */
+#define MPU6050_EVENT_PRE			64		/* 每个事件附带的预触发样本数上限 */
+#define MPU6050_EVENT_BUF			16		/* 驱动缓冲的事件数 */
+
+struct mpu6050_event {
+	__s64 timestamp_ns;		/* 运动中断时刻，CLOCK_BOOTTIME */
+	__u32 seq;				/* 事件序号 */
+	__u32 peak_mg;			/* 预触发窗口内相对窗口起点的加速度变化峰值(mg) */
+	__u8 motion_status;		/* MOT_DETECT_STATUS(0x61)，MPU6050_MOT_* */
+	__u8 peak_axis;			/* 峰值时变化最大的轴，0/1/2 = X/Y/Z */
+	__u16 nr_pre;			/* pre[] 中的有效样本数 */
+	__u32 flags;			/* MPU6050_EVENT_* */
+	/* 触发前的加速度样本(来自芯片FIFO)，按时间顺序，最后一条最接近中断时刻 */
+	struct mpu6050_sample pre[MPU6050_EVENT_PRE];
+};
+
+/* 本事件之前有事件因缓冲区满被丢弃 */
+#define MPU6050_EVENT_LOST			0x01
+
+/* MOT_DETECT_STATUS 位 */
+#define MPU6050_MOT_XNEG			0x80
+#define MPU6050_MOT_XPOS			0x40
+#define MPU6050_MOT_YNEG			0x20
+#define MPU6050_MOT_YPOS			0x10
+#define MPU6050_MOT_ZNEG			0x08
+#define MPU6050_MOT_ZPOS			0x04
+
+/*
+ * 运动检测配置：加速度经过芯片内5Hz高通滤波后，任一轴超过threshold_mg
+ * 持续duration_ms即产生中断。芯片FIFO只存加速度，作为预触发环形缓冲，
+ * 因此与FIFO采集模式互斥，可以与直接读寄存器或数据就绪中断模式同时使用。
+ */
+struct mpu6050_motion_config {
+	__u16 threshold_mg;		/* 2~510，步进2mg */
+	__u8 duration_ms;		/* 1~255 */
+	__u8 enable;
+};
+
+/*
+ * FIFO配置：mask为0时关闭FIFO，read() 恢复为直接读寄存器。
+ * 设置时rate_hz按分频取整，GET返回实际采样率。
+ */
+struct mpu6050_fifo_config {
+	__u16 rate_hz;
+	__u8 mask;				/* MPU6050_FIFO_* 组合 */
+	__u8 reserved;
+};
+
+#define MPU6050_IOC_MAGIC			'M'
+#define MPU6050_IOC_SET_FIFO		_IOW(MPU6050_IOC_MAGIC, 1, struct mpu6050_fifo_config)
+#define MPU6050_IOC_GET_FIFO		_IOR(MPU6050_IOC_MAGIC, 2, struct mpu6050_fifo_config)
+/*
+ * 数据就绪中断模式：参数为采样率(Hz)，0为关闭，与FIFO模式互斥。
+ * 每个样本触发一次INT引脚中断，时间戳取自中断时刻，read()/poll() 与FIFO模式相同。
+ * 需要在设备树里给出INT引脚的interrupts属性，否则返回EOPNOTSUPP。
+ */
+#define MPU6050_IOC_SET_DRDY		_IOW(MPU6050_IOC_MAGIC, 3, __u32)
+#define MPU6050_IOC_GET_DRDY		_IOR(MPU6050_IOC_MAGIC, 4, __u32)
+/* 运动/冲击检测，事件从同一芯片的 /dev/mpu6050-N-event 读取；同样需要INT引脚 */
+#define MPU6050_IOC_SET_MOTION		_IOWR(MPU6050_IOC_MAGIC, 5, struct mpu6050_motion_config)
+#define MPU6050_IOC_GET_MOTION		_IOR(MPU6050_IOC_MAGIC, 6, struct mpu6050_motion_config)
+/*
+ * mmap共享环形缓冲：参数非0时FIFO/数据就绪中断模式的记录写入环形缓冲，
+ * read() 返回EBUSY，poll() 在 head != tail 时可读；参数为0恢复read()。
+ * 打开时head/tail/lost清零。
+ */
+#define MPU6050_IOC_SET_RING		_IOW(MPU6050_IOC_MAGIC, 7, __u32)
+
+/*
+ * 用 mmap(NULL, MPU6050_RING_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) 映射。
+ * 驱动是唯一的生产者，只写head；应用是唯一的消费者，只写tail。
+ * head/tail是自由增长的计数，槽位为 rec[x & (slots - 1)]，head - tail 为可读条数。
+ * 应用先acquire读head，再读记录，最后release写tail；满了之后驱动丢弃新记录，
+ * lost加1，并在下一条写入的记录上标记 MPU6050_SAMPLE_OVERFLOW。
+ * head和tail分在不同的cache line，避免生产者与消费者互相争用。
+ */
+#define MPU6050_RING_SLOTS			4096	/* 2的幂，1kHz下约4秒 */
+
+struct mpu6050_ring {
+	__u32 head;				/* 驱动写 */
+	__u32 pad0[15];
+	__u32 tail;				/* 应用写 */
+	__u32 pad1[15];
+	__u32 slots;			/* = MPU6050_RING_SLOTS */
+	__u32 lost;				/* 因环形缓冲满丢弃的记录数 */
+	__u32 reserved[14];
+	struct mpu6050_sample rec[];
+};
+
+#define MPU6050_RING_BYTES			(sizeof(struct mpu6050_ring) + \
+									 MPU6050_RING_SLOTS * sizeof(struct mpu6050_sample))
+
+/*
+ * 芯片零偏补偿寄存器的值，写入后数据寄存器和FIFO输出的就是补偿后的结果。
+ * accel 对应 XA_OFFS_H(0x06)起的寄存器，±16g量程单位(2048 LSB/g)，bit0为芯片
+ * 保留的温度补偿位，驱动写入时保留原值；gyro 对应 XG_OFFS_USRH(0x13)起的寄存器，
+ * ±1000°/s量程单位(32.8 LSB/(°/s))。
+ */
+struct mpu6050_offsets {
+	__s16 accel[3];
+	__s16 gyro[3];
+};
+
+/* 校准时朝上(感受+1g)的轴 */
+#define MPU6050_UP_XPOS				0
+#define MPU6050_UP_XNEG				1
+#define MPU6050_UP_YPOS				2
+#define MPU6050_UP_YNEG				3
+#define MPU6050_UP_ZPOS				4
+#define MPU6050_UP_ZNEG				5
+
+#define MPU6050_CALIB_MIN_SAMPLES	16
+#define MPU6050_CALIB_MAX_SAMPLES	4096
+
+/*
+ * 静止校准：芯片静止放置，up_axis朝上，驱动按1kHz连续读samples个样本，
+ * 估计零偏后在现有补偿值上修正并写入芯片，再读samples/4个样本给出残余零偏。
+ * 采样期间有轴的波动超过阈值时认为没有静止，返回EAGAIN，芯片不改动。
+ * 只能在直接读寄存器模式下进行(没有FIFO/中断采集和运动检测)，否则返回EBUSY。
+ * 零偏和残差为当前量程下的原始值。
+ */
+struct mpu6050_calib {
+	__u16 samples;			/* 输入：样本数 */
+	__u8 up_axis;			/* 输入：MPU6050_UP_* */
+	__u8 reserved;
+	__s16 accel_bias[3];	/* 输出：校准前的零偏(已扣除重力) */
+	__s16 gyro_bias[3];
+	__s16 accel_residual[3];	/* 输出：写入补偿后的残余零偏 */
+	__s16 gyro_residual[3];
+	struct mpu6050_offsets offsets;	/* 输出：写入芯片的补偿值 */
+};
+
+/*
+ * 校准文件：驱动probe时用 request_firmware 加载
+ *   /lib/firmware/mpu6050-<I2C设备名>.cal  例如 mpu6050-1-0068.cal
+ * 按总线号和地址区分，与 /dev/mpu6050-N 的编号无关。
+ * 内容为 struct mpu6050_calib_file，由 mpu6050_calib 工具保存。
+ */
+#define MPU6050_CALIB_MAGIC			0x4243364d	/* "M6CB" */
+#define MPU6050_CALIB_VERSION		1
+
+struct mpu6050_calib_file {
+	__u32 magic;
+	__u32 version;
+	struct mpu6050_offsets offsets;
+};
+
+/*
+ * 带宽、量程和驱动内抽取，也可以通过 /sys/class/mpu6050i2c/mpu6050-N/ 下的
+ * dlpf、gyro_range、accel_range、decimate、rate_hz 属性读写。
+ * 只能在直接读寄存器模式下修改，否则返回EBUSY。
+ *
+ * dlpf为CONFIG寄存器的DLPF_CFG，加速度/陀螺带宽(Hz)：
+ *   0: 260/256(陀螺内部8kHz)  1: 184/188  2: 94/98  3: 44/42  4: 21/20  5: 10/10  6: 5/5
+ * FIFO/中断模式采样率超过1kHz时驱动临时关闭DLPF。
+ *
+ * decimate为N时，驱动把FIFO/数据就绪中断模式下连续N个样本取平均后输出一条
+ * (一阶CIC/box滤波)，时间戳取这N个样本的中点。比如1kHz采样、decimate=20，
+ * 应用收到的是50Hz、已经做过抗混叠平均的数据，read()/poll() 的次数降为1/20。
+ * 如果不需要平均，直接把采样率设低并配合较窄的dlpf，总线流量也会同比例下降。
+ */
+#define MPU6050_GYRO_250DPS			0
+#define MPU6050_GYRO_500DPS			1
+#define MPU6050_GYRO_1000DPS		2
+#define MPU6050_GYRO_2000DPS		3
+#define MPU6050_ACCEL_2G			0
+#define MPU6050_ACCEL_4G			1
+#define MPU6050_ACCEL_8G			2
+#define MPU6050_ACCEL_16G			3
+#define MPU6050_DLPF_MAX			6
+#define MPU6050_DECIMATE_MAX		128
+
+struct mpu6050_filter_config {
+	__u8 dlpf;
+	__u8 gyro_range;		/* MPU6050_GYRO_* */
+	__u8 accel_range;		/* MPU6050_ACCEL_* */
+	__u8 decimate;			/* 1~128，1为不抽取 */
+	__u16 rate_hz;			/* 直接读寄存器模式下的采样率，0为不改；返回当前实际采样率 */
+	__u16 accel_lsb_per_g;	/* 输出：当前量程每g的LSB数 */
+	__u16 gyro_lsb_per_dps_x10;	/* 输出：当前量程每°/s的LSB数 × 10 */
+	__u16 reserved;
+};
+
+#define MPU6050_IOC_CALIBRATE		_IOWR(MPU6050_IOC_MAGIC, 8, struct mpu6050_calib)
+#define MPU6050_IOC_GET_OFFSETS		_IOR(MPU6050_IOC_MAGIC, 9, struct mpu6050_offsets)
+#define MPU6050_IOC_SET_OFFSETS		_IOW(MPU6050_IOC_MAGIC, 10, struct mpu6050_offsets)
+#define MPU6050_IOC_SET_FILTER		_IOWR(MPU6050_IOC_MAGIC, 11, struct mpu6050_filter_config)
+#define MPU6050_IOC_GET_FILTER		_IOR(MPU6050_IOC_MAGIC, 12, struct mpu6050_filter_config)
+
+#endif /* __MPU6050I2C_H */
@@ -0,0 +1,1103 @@
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/cdev.h>
+#include <linux/device.h>
+#include <linux/idr.h>
+#include <linux/kfifo.h>
+#include <linux/kref.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/pm.h>
+#include <linux/pm_wakeup.h>
+#include <linux/rwsem.h>
+#include <linux/timekeeping.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+/***************************************************************
+文件名	  	: qma6100p.c
+描述	   	: QMA6100P 三轴加速度计I2C驱动程序
+			  采样缓存(FIFO水位中断)和any-motion/no-motion判断都在芯片内完成，
+			  SoC只在攒够一批数据或者有运动事件时才被中断唤醒
+其他	   	: 寄存器定义见 mpu6050.h
+***************************************************************/
+#include "mpu6050.h"
+#include "qma6100p_i2c.h"
+
+#define QMA6100P_CNT			2		/* 每个芯片一个数据节点和一个事件节点 */
+#define QMA6100P_NAME			"qma6100p"
+#define QMA6100P_MAX_DEVICES	4
+
+#define QMA6100P_POLL_MIN_MS	5		/* 没有INT引脚时排空周期下限 */
+
+/*
+ * 每个芯片一份。解绑后已打开的文件还可能在用，按引用计数释放：
+ * probe持有一个，每次open一个
+ */
+struct qma6100p_dev {
+	dev_t devid;			/* 数据节点设备号，事件节点为devid + 1 */
+	int id;					/* 实例编号，对应 /dev/qma6100p-N */
+	struct kref kref;
+	struct rw_semaphore remove_sem;	/* ioctl和直接读寄存器持读锁，remove持写锁设置removed */
+	bool removed;			/* 已解绑，文件操作返回ENODEV */
+	struct cdev *cdev;		/* 单独分配，最后一个文件关闭后由内核释放 */
+	struct cdev *event_cdev;
+	struct device *device;
+	struct device *event_device;
+	struct i2c_client *client;
+	char name[16];
+
+	struct mutex lock;			/* 保护寄存器配置和FIFO状态 */
+	struct delayed_work poll_work;	/* 没有INT引脚时定期排空芯片FIFO */
+	wait_queue_head_t wq;		/* 有新记录时唤醒读者 */
+	struct mutex read_lock;		/* kfifo的唯一消费者 */
+	DECLARE_KFIFO_PTR(samples, struct qma6100p_sample);
+	u8 fifo_buf[QMA6100P_FIFO_DEPTH * QMA6100P_FIFO_FRAME];
+	struct qma6100p_config cfg;
+	u64 period_ns;
+	unsigned long poll_delay;
+	bool overflow;				/* 下一条记录带溢出标志 */
+	int irq;					/* INT1引脚中断，0为没有接 */
+	u64 irq_ts;
+	bool wake_armed;			/* 休眠时打开了中断唤醒 */
+
+	struct qma6100p_motion_config motion;
+	wait_queue_head_t event_wq;
+	struct mutex event_lock;
+	DECLARE_KFIFO_PTR(events, struct qma6100p_event);
+	u32 event_seq;
+	bool event_lost;
+};
+
+static dev_t qma6100p_devt;
+static struct class *qma6100p_class;
+static DEFINE_IDA(qma6100p_ida);
+/* open按次设备号找实例，remove时摘掉 */
+static struct qma6100p_dev *qma6100p_devs[QMA6100P_MAX_DEVICES];
+static DEFINE_MUTEX(qma6100p_devs_lock);
+
+/* 输出率档位，MCLK为51.2kHz时的标称值 */
+static const struct {
+	u16 hz;
+	u8 code;
+	u32 period_us;
+} qma6100p_odr[] = {
+	{ 12, QMA6100P_BW_12_5, 80000 },
+	{ 25, QMA6100P_BW_25, 40000 },
+	{ 50, QMA6100P_BW_50, 20000 },
+	{ 100, QMA6100P_BW_100, 10000 },
+	{ 200, QMA6100P_BW_200, 5000 },
+	{ 400, QMA6100P_BW_400, 2500 },
+	{ 800, QMA6100P_BW_800, 1250 },
+	{ 1600, QMA6100P_BW_1600, 625 },
+};
+
+/* 量程，14位输出 */
+static const struct {
+	u8 g;
+	u8 code;
+	u16 lsb_per_g;
+} qma6100p_range[] = {
+	{ 2, QMA6100P_RANGE_2G, 4096 },
+	{ 4, QMA6100P_RANGE_4G, 2048 },
+	{ 8, QMA6100P_RANGE_8G, 1024 },
+	{ 16, QMA6100P_RANGE_16G, 512 },
+	{ 32, QMA6100P_RANGE_32G, 256 },
+};
+
+/*
+ * @description	: 从qma6100p读取多个寄存器数据，从FIFO_DATA连续读取时依次取出FIFO里的帧
+ * @param - dev:  qma6100p设备
+ * @param - reg:  要读取的寄存器首地址
+ * @param - val:  读取到的数据
+ * @param - len:  要读取的数据长度
+ * @return 		: 0 成功;其他 失败
+ */
+static int qma6100p_read_regs(struct qma6100p_dev *dev, u8 reg, void *val, int len)
+{
+	struct i2c_client *client = dev->client;
+	struct i2c_msg msg[2] = {
+		{ .addr = client->addr, .flags = 0, .buf = &reg, .len = 1 },
+		{ .addr = client->addr, .flags = I2C_M_RD, .buf = val, .len = len },
+	};
+	int ret;
+
+	ret = i2c_transfer(client->adapter, msg, 2);
+	if (ret == 2)
+		return 0;
+	dev_err_ratelimited(&client->dev, "i2c rd failed=%d reg=%02x len=%d\n", ret, reg, len);
+	return ret < 0 ? ret : -EREMOTEIO;
+}
+
+/*
+ * @description	: 写一个寄存器
+ * @param - dev:  qma6100p设备
+ * @param - reg:  寄存器地址
+ * @param - val:  要写入的值
+ * @return 		: 0 成功;其他 失败
+ */
+static int qma6100p_write_reg(struct qma6100p_dev *dev, u8 reg, u8 val)
+{
+	return i2c_smbus_write_byte_data(dev->client, reg, val);
+}
+
+/*
+ * @description	: 14位数据左对齐在16位里，低字节在前
+ * @param - p 	: 两字节数据
+ * @return 		: 原始值
+ */
+static s16 qma6100p_raw(const u8 *p)
+{
+	return (s16)(p[1] << 8 | p[0]) >> 2;
+}
+
+/*
+ * @description	: 软复位并进入工作模式，默认±2g、100Hz、INT1高电平锁存
+ * @param - dev:  qma6100p设备
+ * @return 		: 0 成功;其他 失败
+ */
+static int qma6100p_init_chip(struct qma6100p_dev *dev)
+{
+	int ret;
+
+	ret = qma6100p_write_reg(dev, QMA6100P_REG_RESET, QMA6100P_RESET_VALUE);
+	if (ret)
+		return ret;
+	msleep(5);
+	qma6100p_write_reg(dev, QMA6100P_REG_RESET, 0x00);
+	msleep(10);
+
+	ret = qma6100p_write_reg(dev, QMA6100P_REG_POWER_MANAGE,
+							 QMA6100P_MODE_ACTIVE_BIT | QMA6100P_MCLK_51_2K);
+	if (ret)
+		return ret;
+	qma6100p_write_reg(dev, QMA6100P_REG_RANGE, QMA6100P_RANGE_2G);
+	qma6100p_write_reg(dev, QMA6100P_REG_BW_ODR, QMA6100P_BW_100);
+	qma6100p_write_reg(dev, QMA6100P_FIFO_CFG, QMA6100P_FIFO_CFG_BYPASS);
+	/* 中断保持到读状态寄存器，配合IRQF_ONESHOT不会丢 */
+	qma6100p_write_reg(dev, QMA6100P_INTPIN_CFG, QMA6100P_INT1_ACTIVE_HIGH);
+	qma6100p_write_reg(dev, QMA6100P_INT_CFG, QMA6100P_INT_LATCH);
+	qma6100p_write_reg(dev, QMA6100P_INT_EN_0, 0);
+	qma6100p_write_reg(dev, QMA6100P_INT_EN_1, 0);
+	qma6100p_write_reg(dev, QMA6100P_INT_EN_2, 0);
+
+	dev->cfg.rate_hz = 100;
+	dev->cfg.range_g = 2;
+	dev->cfg.lsb_per_g = 4096;
+	dev->cfg.watermark = 0;
+	dev->period_ns = 10 * NSEC_PER_MSEC;
+	return 0;
+}
+
+/*
+ * @description	: 按当前配置打开芯片中断源并映射到INT1，调用者持有dev->lock
+ * @param - dev:  qma6100p设备
+ * @param - fifo: 是否打开FIFO水位/满中断，休眠时只留运动中断
+ * @return 		: 无
+ */
+static void qma6100p_update_int(struct qma6100p_dev *dev, bool fifo)
+{
+	u8 en1 = 0, en2 = 0, map1 = 0;
+
+	if (dev->irq > 0 && fifo && dev->cfg.watermark) {
+		en1 |= QMA6100P_INT_EN_FIFO_WMK | QMA6100P_INT_EN_FIFO_FULL;
+		map1 |= QMA6100P_INT1_MAP_FIFO_WMK | QMA6100P_INT1_MAP_FIFO_FULL;
+	}
+	if (dev->motion.enable & QMA6100P_MOTION_ANY) {
+		en2 |= QMA6100P_INT_EN_AMD_XYZ;
+		map1 |= QMA6100P_INT1_MAP_AMD;
+	}
+	if (dev->motion.enable & QMA6100P_MOTION_NO) {
+		en2 |= QMA6100P_INT_EN_NMD_XYZ;
+		map1 |= QMA6100P_INT1_MAP_NMD;
+	}
+	qma6100p_write_reg(dev, QMA6100P_INT_EN_1, en1);
+	qma6100p_write_reg(dev, QMA6100P_INT_EN_2, en2);
+	qma6100p_write_reg(dev, QMA6100P_INT1_MAP_1, map1);
+}
+
+/*
+ * @description	: 把记录放入驱动缓冲区，满了丢弃新记录并标记下一条
+ * @param - dev:  qma6100p设备
+ * @param - s 	: 记录
+ * @return 		: 无
+ */
+static void qma6100p_push_sample(struct qma6100p_dev *dev, struct qma6100p_sample *s)
+{
+	if (kfifo_is_full(&dev->samples)) {
+		dev->overflow = true;
+		return;
+	}
+	if (dev->overflow) {
+		s->flags |= QMA6100P_SAMPLE_OVERFLOW;
+		dev->overflow = false;
+	}
+	kfifo_put(&dev->samples, *s);
+}
+
+/*
+ * @description	: 排空芯片FIFO，时间戳按输出周期从now倒推。
+ * 				  流模式下FIFO满后覆盖最旧的帧，读到满深度说明可能已经丢了样本。
+ * 				  调用者持有dev->lock
+ * @param - dev:  qma6100p设备
+ * @param - now:  最后一帧的时刻
+ * @return 		: 0 成功;其他 失败
+ */
+static int qma6100p_fifo_drain(struct qma6100p_dev *dev, u64 now)
+{
+	struct qma6100p_sample s;
+	unsigned int frames, i, k;
+	u8 state;
+	int ret;
+
+	ret = qma6100p_read_regs(dev, QMA6100P_FIFO_STATE, &state, 1);
+	if (ret)
+		return ret;
+	frames = min_t(unsigned int, state & QMA6100P_FIFO_STATE_MASK, QMA6100P_FIFO_DEPTH);
+	if (!frames)
+		return 0;
+	if (frames == QMA6100P_FIFO_DEPTH)
+		dev->overflow = true;
+
+	ret = qma6100p_read_regs(dev, QMA6100P_FIFO_DATA, dev->fifo_buf,
+							 frames * QMA6100P_FIFO_FRAME);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < frames; i++) {
+		memset(&s, 0, sizeof(s));
+		for (k = 0; k < 3; k++)
+			s.accel[k] = qma6100p_raw(dev->fifo_buf + i * QMA6100P_FIFO_FRAME + k * 2);
+		s.timestamp_ns = now - (u64)(frames - 1 - i) * dev->period_ns;
+		qma6100p_push_sample(dev, &s);
+	}
+	wake_up_interruptible(&dev->wq);
+	return 0;
+}
+
+/*
+ * @description	: 没有INT引脚时的排空线程
+ * @param - work: 工作项
+ * @return 		: 无
+ */
+static void qma6100p_poll_work(struct work_struct *work)
+{
+	struct qma6100p_dev *dev = container_of(to_delayed_work(work),
+						struct qma6100p_dev, poll_work);
+
+	mutex_lock(&dev->lock);
+	if (dev->cfg.watermark) {
+		if (qma6100p_fifo_drain(dev, ktime_get_boottime_ns()))
+			dev_err_ratelimited(&dev->client->dev, "排空FIFO失败\n");
+		schedule_delayed_work(&dev->poll_work, dev->poll_delay);
+	}
+	mutex_unlock(&dev->lock);
+}
+
+/*
+ * @description	: 记录一个运动事件，调用者持有dev->lock
+ * @param - dev:  qma6100p设备
+ * @param - type: QMA6100P_MOTION_ANY / QMA6100P_MOTION_NO
+ * @param - st0 : INT_STATUS_0
+ * @return 		: 无
+ */
+static void qma6100p_push_event(struct qma6100p_dev *dev, u8 type, u8 st0)
+{
+	struct qma6100p_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.timestamp_ns = dev->irq_ts;
+	ev.seq = ++dev->event_seq;
+	ev.type = type;
+	if (type == QMA6100P_MOTION_ANY) {
+		ev.axis = (st0 & QMA6100P_AMD_X_BIT) ? 0 : (st0 & QMA6100P_AMD_Y_BIT) ? 1 : 2;
+		ev.negative = !!(st0 & QMA6100P_AMD_SIGN_BIT);
+	}
+
+	if (kfifo_is_full(&dev->events)) {
+		dev->event_lost = true;
+		dev_warn_ratelimited(&dev->client->dev, "事件缓冲区满，丢弃事件%u\n", ev.seq);
+		return;
+	}
+	if (dev->event_lost) {
+		ev.flags |= QMA6100P_EVENT_LOST;
+		dev->event_lost = false;
+	}
+	kfifo_put(&dev->events, ev);
+	wake_up_interruptible(&dev->event_wq);
+}
+
+/*
+ * @description	: 中断上半部，只记录时间戳
+ * @param - irq : 中断号
+ * @param - data: qma6100p设备
+ * @return 		: IRQ_WAKE_THREAD
+ */
+static irqreturn_t qma6100p_irq(int irq, void *data)
+{
+	struct qma6100p_dev *dev = data;
+
+	dev->irq_ts = ktime_get_boottime_ns();
+	return IRQ_WAKE_THREAD;
+}
+
+/*
+ * @description	: 中断线程：读INT_STATUS_0~2(同时清锁存的中断)，再按中断源处理
+ * @param - irq : 中断号
+ * @param - data: qma6100p设备
+ * @return 		: IRQ_HANDLED
+ */
+static irqreturn_t qma6100p_irq_thread(int irq, void *data)
+{
+	struct qma6100p_dev *dev = data;
+	u8 st[3];
+
+	mutex_lock(&dev->lock);
+	if (qma6100p_read_regs(dev, QMA6100P_INT_STATUS_0, st, sizeof(st)) == 0) {
+		if (dev->cfg.watermark &&
+			(st[2] & (QMA6100P_FIFO_WMK_BIT | QMA6100P_FIFO_FULL_BIT)))
+			qma6100p_fifo_drain(dev, dev->irq_ts);
+		if ((dev->motion.enable & QMA6100P_MOTION_ANY) &&
+			(st[0] & (QMA6100P_AMD_X_BIT | QMA6100P_AMD_Y_BIT | QMA6100P_AMD_Z_BIT)))
+			qma6100p_push_event(dev, QMA6100P_MOTION_ANY, st[0]);
+		if ((dev->motion.enable & QMA6100P_MOTION_NO) && (st[0] & QMA6100P_NMD_BIT))
+			qma6100p_push_event(dev, QMA6100P_MOTION_NO, st[0]);
+	}
+	mutex_unlock(&dev->lock);
+	return IRQ_HANDLED;
+}
+
+/*
+ * @description	: 按当前量程写运动检测阈值和时长，调用者持有dev->lock。
+ * 				  阈值单位为16个LSB，实际值写回motion
+ * @param - dev:  qma6100p设备
+ * @return 		: 无
+ */
+static void qma6100p_write_motion(struct qma6100p_dev *dev)
+{
+	struct qma6100p_motion_config *m = &dev->motion;
+	unsigned int lsb = dev->cfg.lsb_per_g;
+	unsigned int any, no;
+
+	any = clamp_t(unsigned int, DIV_ROUND_UP(m->any_threshold_mg * lsb, 16 * 1000), 1, 255);
+	no = clamp_t(unsigned int, DIV_ROUND_UP(m->no_threshold_mg * lsb, 16 * 1000), 1, 255);
+	qma6100p_write_reg(dev, QMA6100P_ANY_MOT_TH, any);
+	qma6100p_write_reg(dev, QMA6100P_NO_MOT_TH, no);
+	qma6100p_write_reg(dev, QMA6100P_MOT_CFG_DUR,
+					   (m->no_motion_s - 1) << 2 | (m->any_duration - 1));
+	m->any_threshold_mg = any * 16 * 1000 / lsb;
+	m->no_threshold_mg = no * 16 * 1000 / lsb;
+}
+
+/*
+ * @description	: 设置输出率、量程和FIFO水位
+ * @param - dev:  qma6100p设备
+ * @param - cfg:  配置，按实际值写回
+ * @return 		: 0 成功;其他 失败
+ */
+static int qma6100p_set_config(struct qma6100p_dev *dev, struct qma6100p_config *cfg)
+{
+	unsigned int r, o, poll_ms;
+
+	for (r = 0; r < ARRAY_SIZE(qma6100p_range) && qma6100p_range[r].g != cfg->range_g; r++)
+		;
+	for (o = 0; o < ARRAY_SIZE(qma6100p_odr) && qma6100p_odr[o].hz < cfg->rate_hz; o++)
+		;
+	if (r == ARRAY_SIZE(qma6100p_range) || o == ARRAY_SIZE(qma6100p_odr) || !cfg->rate_hz ||
+		cfg->watermark >= QMA6100P_FIFO_DEPTH)
+		return -EINVAL;
+
+	/* 排空线程在锁内检查watermark，先关掉再等它退出 */
+	mutex_lock(&dev->lock);
+	dev->cfg.watermark = 0;
+	mutex_unlock(&dev->lock);
+	cancel_delayed_work_sync(&dev->poll_work);
+
+	mutex_lock(&dev->lock);
+	qma6100p_write_reg(dev, QMA6100P_REG_RANGE, qma6100p_range[r].code);
+	qma6100p_write_reg(dev, QMA6100P_REG_BW_ODR, qma6100p_odr[o].code);
+	dev->cfg.range_g = qma6100p_range[r].g;
+	dev->cfg.lsb_per_g = qma6100p_range[r].lsb_per_g;
+	dev->cfg.rate_hz = qma6100p_odr[o].hz;
+	dev->period_ns = (u64)qma6100p_odr[o].period_us * NSEC_PER_USEC;
+
+	/* 写FIFO_CFG同时复位芯片FIFO */
+	if (cfg->watermark) {
+		qma6100p_write_reg(dev, QMA6100P_FIFO_WM, cfg->watermark);
+		qma6100p_write_reg(dev, QMA6100P_FIFO_CFG,
+						   QMA6100P_FIFO_CFG_STREAM | QMA6100P_FIFO_CFG_XYZ);
+	} else {
+		qma6100p_write_reg(dev, QMA6100P_FIFO_CFG, QMA6100P_FIFO_CFG_BYPASS);
+	}
+
+	mutex_lock(&dev->read_lock);
+	kfifo_reset(&dev->samples);
+	dev->overflow = false;
+	mutex_unlock(&dev->read_lock);
+
+	dev->cfg.watermark = cfg->watermark;
+	/* 阈值以LSB为单位，量程变了要重算 */
+	if (dev->motion.enable)
+		qma6100p_write_motion(dev);
+	qma6100p_update_int(dev, true);
+
+	/* 没有INT引脚时在攒到一半水位时排空 */
+	if (dev->irq <= 0 && dev->cfg.watermark) {
+		poll_ms = qma6100p_odr[o].period_us * dev->cfg.watermark / 2 / USEC_PER_MSEC;
+		dev->poll_delay = msecs_to_jiffies(max_t(unsigned int, poll_ms, QMA6100P_POLL_MIN_MS));
+		schedule_delayed_work(&dev->poll_work, dev->poll_delay);
+	}
+	*cfg = dev->cfg;
+	mutex_unlock(&dev->lock);
+
+	wake_up_interruptible(&dev->wq);
+	return 0;
+}
+
+/*
+ * @description	: 设置运动检测
+ * @param - dev:  qma6100p设备
+ * @param - m 	: 运动检测配置，按实际值写回
+ * @return 		: 0 成功;其他 失败
+ */
+static int qma6100p_set_motion(struct qma6100p_dev *dev, struct qma6100p_motion_config *m)
+{
+	if (m->enable & ~(QMA6100P_MOTION_ANY | QMA6100P_MOTION_NO))
+		return -EINVAL;
+	if (m->enable) {
+		if (dev->irq <= 0)
+			return -EOPNOTSUPP;
+		if (!m->any_threshold_mg || !m->no_threshold_mg ||
+			m->any_duration < 1 || m->any_duration > 4 ||
+			m->no_motion_s < 1 || m->no_motion_s > 16)
+			return -EINVAL;
+	}
+
+	mutex_lock(&dev->lock);
+	if (m->enable) {
+		dev->motion = *m;
+		dev->motion.reserved = 0;
+		qma6100p_write_motion(dev);
+	} else {
+		dev->motion.enable = 0;
+	}
+	qma6100p_update_int(dev, true);
+	*m = dev->motion;
+	mutex_unlock(&dev->lock);
+	return 0;
+}
+
+/*
+ * @description	: 释放实例，最后一个引用放掉时调用
+ * @param - kref: 实例的引用计数
+ * @return 		: 无
+ */
+static void qma6100p_dev_release(struct kref *kref)
+{
+	struct qma6100p_dev *dev = container_of(kref, struct qma6100p_dev, kref);
+
+	kfifo_free(&dev->events);
+	kfifo_free(&dev->samples);
+	ida_free(&qma6100p_ida, dev->id);
+	kfree(dev);
+}
+
+/*
+ * @description		: 按次设备号找到实例并取得一个引用
+ * @param - inode 	: 设备节点inode
+ * @return 			: 实例，已解绑时返回NULL
+ */
+static struct qma6100p_dev *qma6100p_get_dev(struct inode *inode)
+{
+	struct qma6100p_dev *dev;
+
+	mutex_lock(&qma6100p_devs_lock);
+	dev = qma6100p_devs[MINOR(inode->i_rdev) / QMA6100P_CNT];
+	if (dev)
+		kref_get(&dev->kref);
+	mutex_unlock(&qma6100p_devs_lock);
+	return dev;
+}
+
+/*
+ * @description	: 解绑时从表里摘掉实例，等进行中的ioctl和直接读取结束后
+ * 				  置removed，之后的文件操作都返回ENODEV
+ * @param - dev:  qma6100p设备
+ * @return 		: 无
+ */
+static void qma6100p_unpublish(struct qma6100p_dev *dev)
+{
+	mutex_lock(&qma6100p_devs_lock);
+	qma6100p_devs[dev->id] = NULL;
+	mutex_unlock(&qma6100p_devs_lock);
+
+	down_write(&dev->remove_sem);
+	WRITE_ONCE(dev->removed, true);
+	up_write(&dev->remove_sem);
+}
+
+/*
+ * @description		: 打开设备
+ * @param - inode 	: 传递给驱动的inode
+ * @param - filp 	: 设备文件
+ * @return 			: 0 成功;其他 失败
+ */
+static int qma6100p_open(struct inode *inode, struct file *filp)
+{
+	filp->private_data = qma6100p_get_dev(inode);
+	return filp->private_data ? 0 : -ENODEV;
+}
+
+/*
+ * @description		: FIFO模式的读取，阻塞到至少有一条记录
+ * @param - filp 	: 设备文件
+ * @param - dev 	: qma6100p设备
+ * @param - buf 	: 返回给用户空间的数据缓冲区
+ * @param - cnt 	: 缓冲区长度，至少一条记录
+ * @return 			: 读取的字节数，FIFO被关闭时返回0，解绑时返回ENODEV
+ */
+static ssize_t qma6100p_read_fifo(struct file *filp, struct qma6100p_dev *dev,
+								  char __user *buf, size_t cnt)
+{
+	unsigned int copied;
+	int ret;
+
+	cnt = rounddown(cnt, sizeof(struct qma6100p_sample));
+	if (mutex_lock_interruptible(&dev->read_lock))
+		return -ERESTARTSYS;
+	while (kfifo_is_empty(&dev->samples)) {
+		mutex_unlock(&dev->read_lock);
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(dev->wq, !kfifo_is_empty(&dev->samples) ||
+									   !READ_ONCE(dev->cfg.watermark) ||
+									   READ_ONCE(dev->removed));
+		if (ret)
+			return ret;
+		if (READ_ONCE(dev->removed))
+			return -ENODEV;
+		if (!READ_ONCE(dev->cfg.watermark))
+			return 0;
+		if (mutex_lock_interruptible(&dev->read_lock))
+			return -ERESTARTSYS;
+	}
+	ret = kfifo_to_user(&dev->samples, buf, cnt, &copied);
+	mutex_unlock(&dev->read_lock);
+
+	return ret ? ret : copied;
+}
+
+/*
+ * @description		: 从设备读取数据，FIFO关闭时直接读数据寄存器返回一条记录
+ * @param - filp 	: 要打开的设备文件(文件描述符)
+ * @param - buf 	: 返回给用户空间的数据缓冲区
+ * @param - cnt 	: 要读取的数据长度
+ * @param - offt 	: 相对于文件首地址的偏移
+ * @return 			: 读取的字节数，如果为负值，表示读取失败
+ */
+static ssize_t qma6100p_read(struct file *filp, char __user *buf, size_t cnt, loff_t *off)
+{
+	struct qma6100p_dev *dev = (struct qma6100p_dev *)filp->private_data;
+	struct qma6100p_sample s;
+	u8 data[6];
+	int i, ret;
+
+	if (READ_ONCE(dev->removed))
+		return -ENODEV;
+	if (cnt < sizeof(s))
+		return -EINVAL;
+	if (READ_ONCE(dev->cfg.watermark))
+		return qma6100p_read_fifo(filp, dev, buf, cnt);
+
+	down_read(&dev->remove_sem);
+	if (dev->removed) {
+		up_read(&dev->remove_sem);
+		return -ENODEV;
+	}
+	mutex_lock(&dev->lock);
+	ret = qma6100p_read_regs(dev, QMA6100P_XOUTL, data, sizeof(data));
+	mutex_unlock(&dev->lock);
+	up_read(&dev->remove_sem);
+	if (ret)
+		return ret;
+
+	memset(&s, 0, sizeof(s));
+	s.timestamp_ns = ktime_get_boottime_ns();
+	for (i = 0; i < 3; i++)
+		s.accel[i] = qma6100p_raw(data + i * 2);
+	if (copy_to_user(buf, &s, sizeof(s)))
+		return -EFAULT;
+	return sizeof(s);
+}
+
+/*
+ * @description		: poll，FIFO模式下有记录时可读，直接读寄存器模式总是可读
+ * @param - filp 	: 设备文件
+ * @param - wait 	: poll表
+ * @return 			: 事件掩码
+ */
+static __poll_t qma6100p_poll(struct file *filp, poll_table *wait)
+{
+	struct qma6100p_dev *dev = (struct qma6100p_dev *)filp->private_data;
+
+	poll_wait(filp, &dev->wq, wait);
+	if (READ_ONCE(dev->removed))
+		return EPOLLERR | EPOLLHUP;
+	if (!READ_ONCE(dev->cfg.watermark) || !kfifo_is_empty(&dev->samples))
+		return EPOLLIN | EPOLLRDNORM;
+	return 0;
+}
+
+/*
+ * @description		: ioctl，配置输出率/量程/FIFO和运动检测，调用者持有remove_sem读锁
+ * @param - dev 	: qma6100p设备
+ * @param - cmd 	: QMA6100P_IOC_*
+ * @param - arg 	: 用户空间参数地址
+ * @return 			: 0 成功;其他 失败
+ */
+static long qma6100p_do_ioctl(struct qma6100p_dev *dev, unsigned int cmd, unsigned long arg)
+{
+	void __user *argp = (void __user *)arg;
+	struct qma6100p_config cfg;
+	struct qma6100p_motion_config mot;
+	int ret;
+
+	switch (cmd) {
+	case QMA6100P_IOC_SET_CONFIG:
+		if (copy_from_user(&cfg, argp, sizeof(cfg)))
+			return -EFAULT;
+		ret = qma6100p_set_config(dev, &cfg);
+		if (ret)
+			return ret;
+		return copy_to_user(argp, &cfg, sizeof(cfg)) ? -EFAULT : 0;
+	case QMA6100P_IOC_GET_CONFIG:
+		mutex_lock(&dev->lock);
+		cfg = dev->cfg;
+		mutex_unlock(&dev->lock);
+		return copy_to_user(argp, &cfg, sizeof(cfg)) ? -EFAULT : 0;
+	case QMA6100P_IOC_SET_MOTION:
+		if (copy_from_user(&mot, argp, sizeof(mot)))
+			return -EFAULT;
+		ret = qma6100p_set_motion(dev, &mot);
+		if (ret)
+			return ret;
+		return copy_to_user(argp, &mot, sizeof(mot)) ? -EFAULT : 0;
+	case QMA6100P_IOC_GET_MOTION:
+		mutex_lock(&dev->lock);
+		mot = dev->motion;
+		mutex_unlock(&dev->lock);
+		return copy_to_user(argp, &mot, sizeof(mot)) ? -EFAULT : 0;
+	default:
+		return -ENOTTY;
+	}
+}
+
+/*
+ * @description		: ioctl入口，解绑之后返回ENODEV
+ * @param - filp 	: 设备文件
+ * @param - cmd 	: QMA6100P_IOC_*
+ * @param - arg 	: 用户空间参数地址
+ * @return 			: 0 成功;其他 失败
+ */
+static long qma6100p_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct qma6100p_dev *dev = (struct qma6100p_dev *)filp->private_data;
+	long ret;
+
+	down_read(&dev->remove_sem);
+	ret = dev->removed ? -ENODEV : qma6100p_do_ioctl(dev, cmd, arg);
+	up_read(&dev->remove_sem);
+	return ret;
+}
+
+/*
+ * @description		: 关闭设备，放掉open时取得的引用，数据节点和事件节点共用
+ * @param - inode 	: 传递给驱动的inode
+ * @param - filp 	: 设备文件
+ * @return 			: 0
+ */
+static int qma6100p_release(struct inode *inode, struct file *filp)
+{
+	struct qma6100p_dev *dev = (struct qma6100p_dev *)filp->private_data;
+
+	kref_put(&dev->kref, qma6100p_dev_release);
+	return 0;
+}
+
+static const struct file_operations qma6100p_ops = {
+	.owner = THIS_MODULE,
+	.open = qma6100p_open,
+	.read = qma6100p_read,
+	.poll = qma6100p_poll,
+	.unlocked_ioctl = qma6100p_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.release = qma6100p_release,
+};
+
+/*
+ * @description		: 打开事件节点
+ * @param - inode 	: 传递给驱动的inode
+ * @param - filp 	: 设备文件
+ * @return 			: 0 成功;其他 失败
+ */
+static int qma6100p_event_open(struct inode *inode, struct file *filp)
+{
+	filp->private_data = qma6100p_get_dev(inode);
+	return filp->private_data ? 0 : -ENODEV;
+}
+
+/*
+ * @description		: 从事件节点读取运动事件，阻塞到至少有一个事件
+ * @param - filp 	: 设备文件
+ * @param - buf 	: 返回给用户空间的数据缓冲区
+ * @param - cnt 	: 缓冲区长度，至少一个事件
+ * @param - offt 	: 相对于文件首地址的偏移
+ * @return 			: 读取的字节数，如果为负值，表示读取失败
+ */
+static ssize_t qma6100p_event_read(struct file *filp, char __user *buf, size_t cnt, loff_t *off)
+{
+	struct qma6100p_dev *dev = (struct qma6100p_dev *)filp->private_data;
+	unsigned int copied;
+	int ret;
+
+	if (READ_ONCE(dev->removed))
+		return -ENODEV;
+	if (cnt < sizeof(struct qma6100p_event))
+		return -EINVAL;
+	cnt = rounddown(cnt, sizeof(struct qma6100p_event));
+
+	if (mutex_lock_interruptible(&dev->event_lock))
+		return -ERESTARTSYS;
+	while (kfifo_is_empty(&dev->events)) {
+		mutex_unlock(&dev->event_lock);
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(dev->event_wq, !kfifo_is_empty(&dev->events) ||
+									   READ_ONCE(dev->removed));
+		if (ret)
+			return ret;
+		if (READ_ONCE(dev->removed))
+			return -ENODEV;
+		if (mutex_lock_interruptible(&dev->event_lock))
+			return -ERESTARTSYS;
+	}
+	ret = kfifo_to_user(&dev->events, buf, cnt, &copied);
+	mutex_unlock(&dev->event_lock);
+
+	return ret ? ret : copied;
+}
+
+/*
+ * @description		: 事件节点poll，有事件时可读
+ * @param - filp 	: 设备文件
+ * @param - wait 	: poll表
+ * @return 			: 事件掩码
+ */
+static __poll_t qma6100p_event_poll(struct file *filp, poll_table *wait)
+{
+	struct qma6100p_dev *dev = (struct qma6100p_dev *)filp->private_data;
+
+	poll_wait(filp, &dev->event_wq, wait);
+	if (READ_ONCE(dev->removed))
+		return EPOLLERR | EPOLLHUP;
+	return kfifo_is_empty(&dev->events) ? 0 : EPOLLIN | EPOLLRDNORM;
+}
+
+static const struct file_operations qma6100p_event_ops = {
+	.owner = THIS_MODULE,
+	.open = qma6100p_event_open,
+	.read = qma6100p_event_read,
+	.poll = qma6100p_event_poll,
+	.release = qma6100p_release,
+};
+
+ /*
+  * @description     : i2c驱动的probe函数，每个芯片分配独立的状态，
+  *                    节点为 /dev/qma6100p-N 和 /dev/qma6100p-N-event
+  * @param - client  : i2c设备
+  * @param - id      : i2c设备ID
+  * @return          : 0，成功;其他负值,失败
+  */
+static int qma6100p_probe(struct i2c_client *client, const struct i2c_device_id *id)
+{
+	struct qma6100p_dev *dev;
+	u8 chip_id;
+	int ret;
+
+	/* 解绑后打开的文件可能还在用，不能用devm，按引用计数释放 */
+	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+	if (!dev)
+		return -ENOMEM;
+	kref_init(&dev->kref);
+	init_rwsem(&dev->remove_sem);
+	dev->client = client;
+	i2c_set_clientdata(client, dev);
+	mutex_init(&dev->lock);
+	mutex_init(&dev->read_lock);
+	mutex_init(&dev->event_lock);
+	init_waitqueue_head(&dev->wq);
+	init_waitqueue_head(&dev->event_wq);
+	INIT_DELAYED_WORK(&dev->poll_work, qma6100p_poll_work);
+
+	dev->id = ida_alloc_max(&qma6100p_ida, QMA6100P_MAX_DEVICES - 1, GFP_KERNEL);
+	if (dev->id < 0) {
+		ret = dev->id;
+		kfree(dev);
+		return ret;
+	}
+	snprintf(dev->name, sizeof(dev->name), "qma6100p-%d", dev->id);
+	dev->devid = MKDEV(MAJOR(qma6100p_devt), dev->id * QMA6100P_CNT);
+
+	ret = qma6100p_read_regs(dev, QMA6100P_CHIP_ID, &chip_id, 1);
+	if (ret)
+		goto put_dev;
+	if ((chip_id & 0xf0) != QMA6100P_DEVICE_ID) {
+		dev_err(&client->dev, "芯片ID不对: 0x%02x\n", chip_id);
+		ret = -ENODEV;
+		goto put_dev;
+	}
+	ret = qma6100p_init_chip(dev);
+	if (ret)
+		goto put_dev;
+
+	/* 两个kfifo都在最后一个引用放掉时由 qma6100p_dev_release 释放 */
+	ret = kfifo_alloc(&dev->samples, QMA6100P_SAMPLE_BUF, GFP_KERNEL);
+	if (ret)
+		goto put_dev;
+	ret = kfifo_alloc(&dev->events, QMA6100P_EVENT_BUF, GFP_KERNEL);
+	if (ret)
+		goto put_dev;
+
+	/* INT1引脚，没有接时FIFO靠定时排空，运动检测不可用。不用devm，remove里要在放掉引用之前释放 */
+	dev->irq = client->irq;
+	if (dev->irq > 0) {
+		ret = request_threaded_irq(dev->irq, qma6100p_irq, qma6100p_irq_thread,
+				IRQF_TRIGGER_HIGH | IRQF_ONESHOT, dev->name, dev);
+		if (ret) {
+			dev_warn(&client->dev, "申请中断%d失败(%d)，运动检测不可用\n", dev->irq, ret);
+			dev->irq = 0;
+		} else {
+			/* 运动中断可以把系统从休眠中唤醒，用户可以在sysfs power/wakeup关掉 */
+			device_init_wakeup(&client->dev, true);
+		}
+	}
+
+	/* 关闭文件时内核在release之后还会访问cdev，cdev不能嵌在实例里随实例释放 */
+	dev->cdev = cdev_alloc();
+	dev->event_cdev = cdev_alloc();
+	if (!dev->cdev || !dev->event_cdev) {
+		ret = -ENOMEM;
+		goto put_cdev;
+	}
+	dev->cdev->ops = &qma6100p_ops;
+	dev->cdev->owner = THIS_MODULE;
+	dev->event_cdev->ops = &qma6100p_event_ops;
+	dev->event_cdev->owner = THIS_MODULE;
+	ret = cdev_add(dev->cdev, dev->devid, 1);
+	if (ret)
+		goto put_cdev;
+	ret = cdev_add(dev->event_cdev, dev->devid + 1, 1);
+	if (ret)
+		goto del_cdev;
+
+	mutex_lock(&qma6100p_devs_lock);
+	qma6100p_devs[dev->id] = dev;
+	mutex_unlock(&qma6100p_devs_lock);
+
+	dev->device = device_create(qma6100p_class, &client->dev, dev->devid, dev, "%s", dev->name);
+	if (IS_ERR(dev->device)) {
+		ret = PTR_ERR(dev->device);
+		goto unpublish;
+	}
+	dev->event_device = device_create(qma6100p_class, &client->dev, dev->devid + 1, dev,
+									  "%s-event", dev->name);
+	if (IS_ERR(dev->event_device)) {
+		ret = PTR_ERR(dev->event_device);
+		goto destroy_device;
+	}
+
+	dev_info(&client->dev, "/dev/%s 芯片ID 0x%02x\n", dev->name, chip_id);
+	return 0;
+
+destroy_device:
+	device_destroy(qma6100p_class, dev->devid);
+unpublish:
+	qma6100p_unpublish(dev);
+	cdev_del(dev->event_cdev);
+	cdev_del(dev->cdev);
+	goto release_irq;
+del_cdev:
+	cdev_del(dev->cdev);
+	kobject_put(&dev->event_cdev->kobj);
+	goto release_irq;
+put_cdev:
+	/* 没有cdev_add成功的cdev直接放掉引用 */
+	if (dev->cdev)
+		kobject_put(&dev->cdev->kobj);
+	if (dev->event_cdev)
+		kobject_put(&dev->event_cdev->kobj);
+release_irq:
+	/* 芯片中断源还没打开，中断线程不会访问缓冲区 */
+	if (dev->irq > 0) {
+		device_init_wakeup(&client->dev, false);
+		free_irq(dev->irq, dev);
+	}
+put_dev:
+	kref_put(&dev->kref, qma6100p_dev_release);
+	return ret;
+}
+
+/*
+ * @description     : i2c驱动的remove函数
+ * @param - client 	: i2c设备
+ * @return          : 0，成功;其他负值,失败
+ */
+static int qma6100p_remove(struct i2c_client *client)
+{
+	struct qma6100p_dev *dev = i2c_get_clientdata(client);
+
+	/* 先删除节点，不再有新的打开；等进行中的ioctl结束，已打开的文件之后返回ENODEV */
+	device_destroy(qma6100p_class, dev->devid + 1);
+	device_destroy(qma6100p_class, dev->devid);
+	qma6100p_unpublish(dev);
+	cdev_del(dev->event_cdev);
+	cdev_del(dev->cdev);
+
+	/* 关掉芯片中断源和FIFO，等排空线程结束，free_irq等中断线程结束 */
+	mutex_lock(&dev->lock);
+	dev->cfg.watermark = 0;
+	dev->motion.enable = 0;
+	qma6100p_update_int(dev, false);
+	qma6100p_write_reg(dev, QMA6100P_FIFO_CFG, QMA6100P_FIFO_CFG_BYPASS);
+	mutex_unlock(&dev->lock);
+	cancel_delayed_work_sync(&dev->poll_work);
+	if (dev->irq > 0)
+		free_irq(dev->irq, dev);
+	device_init_wakeup(&client->dev, false);
+
+	/* 进入待机省电 */
+	qma6100p_write_reg(dev, QMA6100P_REG_POWER_MANAGE, QMA6100P_MCLK_51_2K);
+
+	/* 唤醒阻塞在已解绑设备上的读者，缓冲区等最后一个文件关闭后再释放 */
+	wake_up_all(&dev->wq);
+	wake_up_all(&dev->event_wq);
+	kref_put(&dev->kref, qma6100p_dev_release);
+	return 0;
+}
+
+/*
+ * @description	: 系统休眠：芯片保持工作，只留运动中断作为唤醒源，
+ * 				  FIFO中断关掉，否则每攒够一批都会把系统叫醒
+ * @param - d 	: 设备
+ * @return 		: 0
+ */
+static int __maybe_unused qma6100p_suspend(struct device *d)
+{
+	struct qma6100p_dev *dev = i2c_get_clientdata(to_i2c_client(d));
+
+	cancel_delayed_work_sync(&dev->poll_work);
+	mutex_lock(&dev->lock);
+	if (dev->irq > 0)
+		qma6100p_update_int(dev, false);
+	dev->wake_armed = dev->irq > 0 && dev->motion.enable && device_may_wakeup(d) &&
+					  !enable_irq_wake(dev->irq);
+	mutex_unlock(&dev->lock);
+	return 0;
+}
+
+/*
+ * @description	: 系统恢复：恢复FIFO中断或定时排空
+ * @param - d 	: 设备
+ * @return 		: 0
+ */
+static int __maybe_unused qma6100p_resume(struct device *d)
+{
+	struct qma6100p_dev *dev = i2c_get_clientdata(to_i2c_client(d));
+
+	mutex_lock(&dev->lock);
+	if (dev->wake_armed) {
+		disable_irq_wake(dev->irq);
+		dev->wake_armed = false;
+	}
+	if (dev->irq > 0)
+		qma6100p_update_int(dev, true);
+	else if (dev->cfg.watermark)
+		schedule_delayed_work(&dev->poll_work, 0);
+	mutex_unlock(&dev->lock);
+	return 0;
+}
+
+static SIMPLE_DEV_PM_OPS(qma6100p_pm_ops, qma6100p_suspend, qma6100p_resume);
+
+static const struct i2c_device_id qma6100p_id[] = {
+	{ "qma6100p", 0 },
+	{}
+};
+MODULE_DEVICE_TABLE(i2c, qma6100p_id);
+
+static const struct of_device_id qma6100p_of_match[] = {
+	{ .compatible = "qst,qma6100p" },
+	{ /* Sentinel */ }
+};
+MODULE_DEVICE_TABLE(of, qma6100p_of_match);
+
+static struct i2c_driver qma6100p_driver = {
+	.probe = qma6100p_probe,
+	.remove = qma6100p_remove,
+	.driver = {
+		.name = QMA6100P_NAME,
+		.of_match_table = qma6100p_of_match,
+		.pm = &qma6100p_pm_ops,
+	},
+	.id_table = qma6100p_id,
+};
+
+/*
+ * @description	: 驱动入口函数
+ * @param 		: 无
+ * @return 		: 0 成功;其他 失败
+ */
+static int __init qma6100p_init(void)
+{
+	int ret;
+
+	ret = alloc_chrdev_region(&qma6100p_devt, 0, QMA6100P_MAX_DEVICES * QMA6100P_CNT,
+							  QMA6100P_NAME);
+	if (ret)
+		return ret;
+	qma6100p_class = class_create(THIS_MODULE, QMA6100P_NAME);
+	if (IS_ERR(qma6100p_class)) {
+		ret = PTR_ERR(qma6100p_class);
+		goto unregister;
+	}
+
+	ret = i2c_add_driver(&qma6100p_driver);
+	if (ret)
+		goto destroy_class;
+	return 0;
+
+destroy_class:
+	class_destroy(qma6100p_class);
+unregister:
+	unregister_chrdev_region(qma6100p_devt, QMA6100P_MAX_DEVICES * QMA6100P_CNT);
+	return ret;
+}
+
+/*
+ * @description	: 驱动出口函数
+ * @param 		: 无
+ * @return 		: 无
+ */
+static void __exit qma6100p_exit(void)
+{
+	i2c_del_driver(&qma6100p_driver);
+	class_destroy(qma6100p_class);
+	unregister_chrdev_region(qma6100p_devt, QMA6100P_MAX_DEVICES * QMA6100P_CNT);
+	ida_destroy(&qma6100p_ida);
+}
+
+module_init(qma6100p_init);
+module_exit(qma6100p_exit);
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Alen");
+MODULE_DESCRIPTION("QMA6100P accelerometer driver");
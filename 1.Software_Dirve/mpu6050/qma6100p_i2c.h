@@ -0,0 +1,84 @@
+/*
+ * QMA6100P 驱动与应用程序共用的数据结构和ioctl定义
+ *
+ * 每个芯片一组节点，N按probe顺序从0开始编号：
+ *   /dev/qma6100p-N        数据节点，read/poll/ioctl
+ *   /dev/qma6100p-N-event  any-motion/no-motion事件节点
+ */
+#ifndef __QMA6100P_I2C_H
+#define __QMA6100P_I2C_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * read() 返回的记录，加速度为14位原始值，g = accel / lsb_per_g。
+ * FIFO关闭时每次read()读一次数据寄存器；打开时返回芯片FIFO里批量取出的记录。
+ */
+struct qma6100p_sample {
+	__s64 timestamp_ns;		/* 采样时刻，CLOCK_BOOTTIME */
+	__s16 accel[3];
+	__u16 flags;			/* QMA6100P_SAMPLE_* */
+};
+
+/* 本记录之前有样本丢失(芯片FIFO写满后覆盖，或驱动缓冲区满) */
+#define QMA6100P_SAMPLE_OVERFLOW	0x01
+
+/* 驱动缓冲的记录条数 */
+#define QMA6100P_SAMPLE_BUF			1024
+
+/*
+ * 输出率和量程，rate_hz按芯片支持的档位(12/25/50/100/200/400/800/1600)
+ * 向上取整。watermark为芯片FIFO攒够多少帧才通知一次(1~63)，0为关闭FIFO。
+ * 有INT引脚时由水位中断驱动，SoC可以在两次中断之间休眠；
+ * 没有INT引脚时按水位对应的时间定期排空。
+ */
+struct qma6100p_config {
+	__u16 rate_hz;
+	__u8 range_g;			/* 2/4/8/16/32 */
+	__u8 watermark;
+	__u16 lsb_per_g;		/* 输出：当前量程每g的LSB数 */
+	__u16 reserved;
+};
+
+/*
+ * 运动检测，在芯片内完成，事件从 /dev/qma6100p-N-event 读取，需要INT引脚。
+ * any-motion：相邻样本的差值超过any_threshold_mg，连续any_duration个样本。
+ * no-motion：差值一直低于no_threshold_mg，持续no_motion_s秒，适合判断停车。
+ * 阈值步进为16个LSB(±2g量程约3.9mg)，设置后按实际值写回。
+ * 打开运动检测后INT引脚设为唤醒源，系统休眠时有运动也能唤醒。
+ */
+struct qma6100p_motion_config {
+	__u16 any_threshold_mg;
+	__u16 no_threshold_mg;
+	__u8 any_duration;		/* 1~4 */
+	__u8 no_motion_s;		/* 1~16 */
+	__u8 enable;			/* QMA6100P_MOTION_* 组合，0为关闭 */
+	__u8 reserved;
+};
+
+#define QMA6100P_MOTION_ANY			0x01
+#define QMA6100P_MOTION_NO			0x02
+
+struct qma6100p_event {
+	__s64 timestamp_ns;		/* 中断时刻，CLOCK_BOOTTIME */
+	__u32 seq;
+	__u8 type;				/* QMA6100P_MOTION_ANY / QMA6100P_MOTION_NO */
+	__u8 axis;				/* any-motion首个触发轴，0/1/2 = X/Y/Z */
+	__u8 negative;			/* any-motion方向，1为负 */
+	__u8 reserved;
+	__u32 flags;			/* QMA6100P_EVENT_* */
+	__u32 pad;
+};
+
+/* 本事件之前有事件因缓冲区满被丢弃 */
+#define QMA6100P_EVENT_LOST			0x01
+#define QMA6100P_EVENT_BUF			16
+
+#define QMA6100P_IOC_MAGIC			'Q'
+#define QMA6100P_IOC_SET_CONFIG		_IOWR(QMA6100P_IOC_MAGIC, 1, struct qma6100p_config)
+#define QMA6100P_IOC_GET_CONFIG		_IOR(QMA6100P_IOC_MAGIC, 2, struct qma6100p_config)
+#define QMA6100P_IOC_SET_MOTION		_IOWR(QMA6100P_IOC_MAGIC, 3, struct qma6100p_motion_config)
+#define QMA6100P_IOC_GET_MOTION		_IOR(QMA6100P_IOC_MAGIC, 4, struct qma6100p_motion_config)
+
+#endif /* __QMA6100P_I2C_H */
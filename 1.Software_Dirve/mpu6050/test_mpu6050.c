@@ -11,6 +11,12 @@
 #include <sys/time.h>
 #include <signal.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/epoll.h>
+
+#include "mpu6050i2c.h"
 /***************************************************************
 文件名	  	: mpu6050i2cApp.c
 作者	  	: 1997AURORA
@@ -20,6 +26,102 @@
 日志	   	: 初版V1.0 2021/8/8 1997AURORA创建
 ***************************************************************/
 
+#define FIFO_READ_MAX	256
+
+static uint64_t boottime_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+ * @description		: FIFO/数据就绪中断模式测试，阻塞在epoll_wait上，
+ * 					  每秒打印一次收到的记录数、交付延迟和最新样本
+ * @param - fd 		: 设备文件
+ * @param - rate 	: 采样率(Hz)
+ * @param - drdy 	: 1为数据就绪中断模式，0为FIFO模式
+ * @return 			: 0 成功;其他 失败
+ */
+static int record_test(int fd, unsigned int rate, int drdy)
+{
+	static struct mpu6050_sample samples[FIFO_READ_MAX];
+	struct mpu6050_fifo_config cfg;
+	struct epoll_event ev;
+	unsigned long total = 0, reads = 0, lost = 0;
+	uint64_t lat_max = 0;
+	time_t last = time(NULL);
+	uint32_t drdy_rate = rate;
+	ssize_t ret;
+	size_t n, i;
+	int ep;
+
+	if (drdy) {
+		if (ioctl(fd, MPU6050_IOC_SET_DRDY, &drdy_rate) < 0 ||
+			ioctl(fd, MPU6050_IOC_GET_DRDY, &drdy_rate) < 0) {
+			perror("设置数据就绪中断模式失败");
+			return -1;
+		}
+		printf("数据就绪中断模式, 实际采样率 %uHz\n", drdy_rate);
+	} else {
+		memset(&cfg, 0, sizeof(cfg));
+		cfg.rate_hz = rate;
+		cfg.mask = MPU6050_FIFO_ALL;
+		if (ioctl(fd, MPU6050_IOC_SET_FIFO, &cfg) < 0 ||
+			ioctl(fd, MPU6050_IOC_GET_FIFO, &cfg) < 0) {
+			perror("设置FIFO模式失败");
+			return -1;
+		}
+		printf("FIFO模式, 实际采样率 %uHz\n", cfg.rate_hz);
+	}
+
+	ep = epoll_create1(0);
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	if (ep < 0 || epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		perror("epoll");
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	while (1) {
+		if (epoll_wait(ep, &ev, 1, -1) < 0) {
+			perror("epoll_wait");
+			break;
+		}
+		ret = read(fd, samples, sizeof(samples));
+		if (ret < 0) {
+			if (errno == EAGAIN)
+				continue;
+			perror("读取失败");
+			break;
+		}
+		n = ret / sizeof(samples[0]);
+		if (n == 0)
+			continue;
+		/* 交付延迟：最新样本的采样时刻到应用拿到的时间 */
+		if (boottime_ns() - samples[n - 1].timestamp_ns > lat_max)
+			lat_max = boottime_ns() - samples[n - 1].timestamp_ns;
+		for (i = 0; i < n; i++)
+			if (samples[i].flags & MPU6050_SAMPLE_OVERFLOW)
+				lost++;
+		total += n;
+		reads++;
+
+		if (time(NULL) != last) {
+			struct mpu6050_sample *s = &samples[n - 1];
+			last = time(NULL);
+			printf("%lu 条/%lu 次read, 溢出 %lu 次, 最大延迟 %.2fms, 最新 Acc %d %d %d Gyro %d %d %d\n",
+				   total, reads, lost, lat_max / 1e6, s->accel[0], s->accel[1],
+				   s->accel[2], s->gyro[0], s->gyro[1], s->gyro[2]);
+			total = reads = 0;
+			lat_max = 0;
+		}
+	}
+	close(ep);
+	return -1;
+}
+
 /*
  * @description		: main主程序
  * @param - argc 	: argv数组元素个数
@@ -37,8 +139,9 @@ int main(int argc, char *argv[])
 
 	int ret = 0;
 
-	if (argc != 2) {
+	if (argc < 2 || argc > 4) {
 		printf("Error Usage!\r\n");
+		printf("Usage: %s <dev> [采样率Hz [drdy]]\r\n", argv[0]);
 		return -1;
 	}
 
@@ -49,9 +152,16 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	if (argc >= 3) {
+		ret = record_test(fd, strtoul(argv[2], NULL, 0),
+						  argc == 4 && !strcmp(argv[3], "drdy"));
+		close(fd);
+		return ret;
+	}
+
 	while (1) {
 		ret = read(fd, databuf, sizeof(databuf));
-		if(ret == 0) { 			/* 数据读取成功 */
+		if(ret == sizeof(databuf)) {	/* 数据读取成功 */
 			accel_x_adc = databuf[0];
 			accel_y_adc = databuf[1];
 			accel_z_adc = databuf[2];
@@ -67,6 +177,8 @@ int main(int argc, char *argv[])
 			// Temperature is simple so use the datasheet calculation to get deg C.
 			// Note this is chip temperature.
 			printf("Temp. = %f\n", (temp_adc / 340.0) + 36.53);
+		} else if (ret < 0) {
+			perror("读取失败");
 		}
 		usleep(1000000); /*1000ms */
 	}
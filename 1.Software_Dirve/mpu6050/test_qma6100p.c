@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+
+#include "qma6100p_i2c.h"
+/***************************************************************
+描述	   	: qma6100p FIFO批量读取和运动事件测试程序
+用法	   	: test_qma6100p [设备] [输出率Hz] [水位帧数]
+			  设备默认 /dev/qma6100p-0。打开FIFO和any/no-motion检测后
+			  同时等待数据节点和事件节点，每批数据打印一次批量大小和最新样本
+编译	   	: riscv64-buildroot-linux-gnu-gcc -O2 -o test_qma6100p test_qma6100p.c
+***************************************************************/
+
+/*
+ * @description		: main主程序
+ * @param - argc 	: argv数组元素个数
+ * @param - argv 	: 具体参数
+ * @return 			: 0 成功;其他 失败
+ */
+int main(int argc, char *argv[])
+{
+	static struct qma6100p_sample samples[64];
+	const char *devname = argc > 1 ? argv[1] : "/dev/qma6100p-0";
+	struct qma6100p_config cfg;
+	struct qma6100p_motion_config mot;
+	struct qma6100p_event ev;
+	struct pollfd pfd[2];
+	char evname[64];
+	ssize_t ret;
+	int n;
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.rate_hz = argc > 2 ? strtoul(argv[2], NULL, 0) : 100;
+	cfg.watermark = argc > 3 ? strtoul(argv[3], NULL, 0) : 32;
+	cfg.range_g = 2;
+
+	snprintf(evname, sizeof(evname), "%s-event", devname);
+	pfd[0].fd = open(devname, O_RDWR);
+	pfd[1].fd = open(evname, O_RDONLY);
+	if (pfd[0].fd < 0 || pfd[1].fd < 0) {
+		perror("设备打开失败");
+		return -1;
+	}
+	pfd[0].events = pfd[1].events = POLLIN;
+
+	if (ioctl(pfd[0].fd, QMA6100P_IOC_SET_CONFIG, &cfg) < 0) {
+		perror("设置FIFO失败");
+		return -1;
+	}
+	printf("输出率 %uHz, 量程 ±%ug (%u LSB/g), 水位 %u 帧\n",
+		   cfg.rate_hz, cfg.range_g, cfg.lsb_per_g, cfg.watermark);
+
+	memset(&mot, 0, sizeof(mot));
+	mot.any_threshold_mg = 100;
+	mot.any_duration = 2;
+	mot.no_threshold_mg = 50;
+	mot.no_motion_s = 5;
+	mot.enable = QMA6100P_MOTION_ANY | QMA6100P_MOTION_NO;
+	if (ioctl(pfd[0].fd, QMA6100P_IOC_SET_MOTION, &mot) < 0)
+		perror("打开运动检测失败，只测FIFO");
+	else
+		printf("运动检测: any %umg x%u, no %umg %us\n", mot.any_threshold_mg,
+			   mot.any_duration, mot.no_threshold_mg, mot.no_motion_s);
+
+	while (1) {
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			break;
+		}
+		if (pfd[0].revents & POLLIN) {
+			ret = read(pfd[0].fd, samples, sizeof(samples));
+			if (ret > 0) {
+				n = ret / sizeof(samples[0]);
+				printf("批量 %2d 条%s  Acc %6d %6d %6d\n", n,
+					   (samples[0].flags & QMA6100P_SAMPLE_OVERFLOW) ? "(有丢失)" : "",
+					   samples[n - 1].accel[0], samples[n - 1].accel[1], samples[n - 1].accel[2]);
+			}
+		}
+		if (pfd[1].revents & POLLIN) {
+			if (read(pfd[1].fd, &ev, sizeof(ev)) != sizeof(ev))
+				continue;
+			printf("事件 #%u%s: %s", ev.seq,
+				   (ev.flags & QMA6100P_EVENT_LOST) ? "(之前有丢失)" : "",
+				   ev.type == QMA6100P_MOTION_ANY ? "开始运动" : "静止");
+			if (ev.type == QMA6100P_MOTION_ANY)
+				printf(" 轴%c%c", ev.negative ? '-' : '+', "XYZ"[ev.axis % 3]);
+			printf("\n");
+		}
+	}
+
+	close(pfd[1].fd);
+	close(pfd[0].fd);
+	return 0;
+}
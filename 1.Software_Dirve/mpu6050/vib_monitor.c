@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+
+#include "mpu6050i2c.h"
+#include "vib_spectrum.h"
+/***************************************************************
+描述	   	: mpu6050 振动频谱监视
+用法	   	: vib_monitor [设备] [FFT点数] [采样率Hz]
+			  设备默认 /dev/mpu6050-0，FFT点数默认512，采样率默认1000。
+			  FIFO模式只采加速度，50%重叠Welch平均，每秒打印一次
+			  各频带RMS(mg)和每轴峰值频率。
+编译	   	: riscv64-buildroot-linux-gnu-gcc -O2 -o vib_monitor vib_monitor.c vib_spectrum.c -lm
+***************************************************************/
+
+#define READ_MAX	256
+
+/* 倍频程频带，覆盖路面(低频)和车轮/发动机转频 */
+static const struct vib_band bands[] = {
+	{ 1, 5 }, { 5, 10 }, { 10, 20 }, { 20, 40 }, { 40, 80 }, { 80, 160 }, { 160, 500 },
+};
+#define NR_BANDS	(sizeof(bands) / sizeof(bands[0]))
+
+static void on_report(void *ctx, const struct vib_report *r)
+{
+	unsigned int b, axis;
+
+	(void)ctx;
+	printf("%lld.%03lld %u帧%s\n", (long long)(r->timestamp_ns / 1000000000),
+		   (long long)(r->timestamp_ns / 1000000 % 1000), r->frames,
+		   r->lost ? " (有丢失)" : "");
+	for (axis = 0; axis < VIB_AXES; axis++) {
+		printf("  %c RMS %7.1fmg 峰值 %6.1fHz |", "XYZ"[axis], r->rms[axis] * 1000,
+			   r->peak_hz[axis]);
+		for (b = 0; b < NR_BANDS; b++)
+			printf(" %6.1f", sqrtf(r->band[b][axis]) * 1000);
+		printf("\n");
+	}
+}
+
+/*
+ * @description		: main主程序
+ * @param - argc 	: argv数组元素个数
+ * @param - argv 	: 具体参数
+ * @return 			: 0 成功;其他 失败
+ */
+int main(int argc, char *argv[])
+{
+	static struct mpu6050_sample samples[READ_MAX];
+	const char *devname = argc > 1 ? argv[1] : "/dev/mpu6050-0";
+	unsigned int nfft = argc > 2 ? strtoul(argv[2], NULL, 0) : 512;
+	struct mpu6050_filter_config filt;
+	struct mpu6050_fifo_config cfg;
+	struct vib_psd psd;
+	struct pollfd pfd;
+	unsigned int b;
+	ssize_t ret;
+
+	pfd.fd = open(devname, O_RDWR);
+	if (pfd.fd < 0) {
+		perror("设备打开失败");
+		return -1;
+	}
+	pfd.events = POLLIN;
+
+	/* DLPF 184Hz 做抗混叠，不在驱动里抽取 */
+	if (ioctl(pfd.fd, MPU6050_IOC_GET_FILTER, &filt) < 0) {
+		perror("读取滤波配置失败");
+		return -1;
+	}
+	filt.dlpf = 1;
+	filt.decimate = 1;
+	filt.rate_hz = 0;
+	if (ioctl(pfd.fd, MPU6050_IOC_SET_FILTER, &filt) < 0)
+		perror("设置DLPF失败，沿用当前配置");
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.rate_hz = argc > 3 ? strtoul(argv[3], NULL, 0) : 1000;
+	cfg.mask = MPU6050_FIFO_ACCEL;
+	if (ioctl(pfd.fd, MPU6050_IOC_SET_FIFO, &cfg) < 0 ||
+		ioctl(pfd.fd, MPU6050_IOC_GET_FIFO, &cfg) < 0) {
+		perror("设置FIFO模式失败");
+		return -1;
+	}
+	if (vib_psd_init(&psd, cfg.rate_hz, nfft, nfft / 2, 1, filt.accel_lsb_per_g,
+					 on_report, NULL)) {
+		printf("FFT点数应为%d~%d之间的2的幂\n", VIB_FFT_MIN, VIB_FFT_MAX);
+		return -1;
+	}
+	vib_psd_set_bands(&psd, bands, NR_BANDS);
+
+	printf("采样率 %uHz, %u点FFT, 分辨率 %.2fHz, 频带RMS(mg):", cfg.rate_hz, nfft,
+		   (float)cfg.rate_hz / nfft);
+	for (b = 0; b < NR_BANDS; b++)
+		printf(" %g~%g", bands[b].lo_hz, bands[b].hi_hz);
+	printf("Hz\n");
+
+	while (1) {
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			break;
+		}
+		ret = read(pfd.fd, samples, sizeof(samples));
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			perror("读取失败");
+			break;
+		}
+		vib_psd_push(&psd, samples, ret / sizeof(samples[0]));
+	}
+
+	vib_psd_free(&psd);
+	close(pfd.fd);
+	return 0;
+}
@@ -0,0 +1,355 @@
+/*
+ * MPU6050 振动频谱分析库，说明见 vib_spectrum.h
+ *
+ * 编译：
+ *   riscv64-buildroot-linux-gnu-gcc -O2 -c vib_spectrum.c
+ *
+ * 旋转因子、位反转表、窗函数都在初始化时算好，运行时没有三角函数调用。
+ * RV64GC 没有向量扩展，蝶形按标量执行；实部虚部分开存放，
+ * 内层循环没有数据重排，换到带向量单元的核上不用改代码。
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vib_spectrum.h"
+
+/******************************* FFT *******************************/
+
+int vib_fft_init(struct vib_fft *f, unsigned int n)
+{
+	unsigned int m = n / 2, bits = 0, h, j, k, r;
+
+	memset(f, 0, sizeof(*f));
+	if (n < VIB_FFT_MIN || n > VIB_FFT_MAX || (n & (n - 1)))
+		return -1;
+	while ((1u << bits) < m)
+		bits++;
+
+	f->n = n;
+	f->m = m;
+	f->bitrev = malloc(m * sizeof(*f->bitrev));
+	f->tw_re = malloc(m * sizeof(float));
+	f->tw_im = malloc(m * sizeof(float));
+	f->rt_re = malloc(m * sizeof(float));
+	f->rt_im = malloc(m * sizeof(float));
+	f->wr = malloc(m * sizeof(float));
+	f->wi = malloc(m * sizeof(float));
+	if (!f->bitrev || !f->tw_re || !f->tw_im || !f->rt_re || !f->rt_im || !f->wr || !f->wi) {
+		vib_fft_free(f);
+		return -1;
+	}
+
+	for (k = 0; k < m; k++) {
+		for (r = 0, j = 0; j < bits; j++)
+			r |= ((k >> j) & 1) << (bits - 1 - j);
+		f->bitrev[k] = r;
+	}
+	/* 半长为h的一级用 exp(-iπj/h)，j = 0..h-1，按级连续存放 */
+	for (h = 1; h < m; h <<= 1)
+		for (j = 0; j < h; j++) {
+			f->tw_re[h - 1 + j] = (float)cos(M_PI * j / h);
+			f->tw_im[h - 1 + j] = (float)-sin(M_PI * j / h);
+		}
+	for (k = 0; k < m; k++) {
+		f->rt_re[k] = (float)cos(2 * M_PI * k / n);
+		f->rt_im[k] = (float)-sin(2 * M_PI * k / n);
+	}
+	return 0;
+}
+
+void vib_fft_free(struct vib_fft *f)
+{
+	free(f->bitrev);
+	free(f->tw_re);
+	free(f->tw_im);
+	free(f->rt_re);
+	free(f->rt_im);
+	free(f->wr);
+	free(f->wi);
+	memset(f, 0, sizeof(*f));
+}
+
+/*
+ * 一组蝶形：a += w*b，b = a - w*b。a、b是同一组的前后两半，互不重叠，
+ * 四个数组和旋转因子都按下标连续访问
+ */
+static void butterfly(float *restrict ar, float *restrict ai, float *restrict br,
+					  float *restrict bi, const float *restrict wr,
+					  const float *restrict wi, unsigned int h)
+{
+	unsigned int j;
+
+	for (j = 0; j < h; j++) {
+		float tr = br[j] * wr[j] - bi[j] * wi[j];
+		float ti = br[j] * wi[j] + bi[j] * wr[j];
+
+		br[j] = ar[j] - tr;
+		bi[j] = ai[j] - ti;
+		ar[j] += tr;
+		ai[j] += ti;
+	}
+}
+
+void vib_fft_complex(const struct vib_fft *f, float *re, float *im)
+{
+	unsigned int m = f->m, h, j, k;
+	float t;
+
+	for (k = 0; k < m; k++) {
+		j = f->bitrev[k];
+		if (j > k) {
+			t = re[k]; re[k] = re[j]; re[j] = t;
+			t = im[k]; im[k] = im[j]; im[j] = t;
+		}
+	}
+
+	/* 第一级旋转因子都是1，不用乘 */
+	for (k = 0; k < m; k += 2) {
+		float r1 = re[k + 1], i1 = im[k + 1];
+
+		re[k + 1] = re[k] - r1;
+		im[k + 1] = im[k] - i1;
+		re[k] += r1;
+		im[k] += i1;
+	}
+	for (h = 2; h < m; h <<= 1)
+		for (k = 0; k < m; k += 2 * h)
+			butterfly(re + k, im + k, re + k + h, im + k + h,
+					  f->tw_re + h - 1, f->tw_im + h - 1, h);
+}
+
+/*
+ * 偶数点放实部、奇数点放虚部做 m 点复数FFT得到 Z，再拆分：
+ *   E[k] = (Z[k] + conj(Z[m-k])) / 2
+ *   O[k] = (Z[k] - conj(Z[m-k])) / 2i
+ *   X[k] = E[k] + exp(-2πik/n) * O[k]
+ */
+void vib_fft_real(struct vib_fft *f, const float *x, float *re, float *im)
+{
+	unsigned int m = f->m, k;
+	float *wr = f->wr, *wi = f->wi;
+
+	for (k = 0; k < m; k++) {
+		wr[k] = x[2 * k];
+		wi[k] = x[2 * k + 1];
+	}
+	vib_fft_complex(f, wr, wi);
+
+	re[0] = wr[0] + wi[0];
+	im[0] = 0.0f;
+	re[m] = wr[0] - wi[0];
+	im[m] = 0.0f;
+	for (k = 1; k < m; k++) {
+		float ar = wr[k], ai = wi[k];
+		float br = wr[m - k], bi = -wi[m - k];
+		float er = 0.5f * (ar + br), ei = 0.5f * (ai + bi);
+		float o_r = 0.5f * (ai - bi), o_i = -0.5f * (ar - br);
+
+		re[k] = er + f->rt_re[k] * o_r - f->rt_im[k] * o_i;
+		im[k] = ei + f->rt_re[k] * o_i + f->rt_im[k] * o_r;
+	}
+}
+
+/******************************* Welch PSD *******************************/
+
+int vib_psd_init(struct vib_psd *p, float sample_hz, unsigned int n, unsigned int hop,
+				 float report_hz, float lsb_per_g, vib_report_fn report, void *ctx)
+{
+	unsigned int bins = n / 2 + 1, i;
+	double s2 = 0;
+
+	memset(p, 0, sizeof(*p));
+	if (sample_hz <= 0 || report_hz <= 0 || lsb_per_g <= 0 || !hop || hop > n || !report)
+		return -1;
+	if (vib_fft_init(&p->fft, n))
+		return -1;
+
+	p->n = n;
+	p->hop = hop;
+	p->fs = sample_hz;
+	p->report_samples = (unsigned int)lrintf(sample_hz / report_hz);
+	if (!p->report_samples)
+		p->report_samples = 1;
+	p->lsb_per_g = lsb_per_g;
+	p->report = report;
+	p->ctx = ctx;
+
+	p->window = malloc(n * sizeof(float));
+	p->frame = malloc(n * sizeof(float));
+	p->re = malloc(bins * sizeof(float));
+	p->im = malloc(bins * sizeof(float));
+	if (!p->window || !p->frame || !p->re || !p->im)
+		goto fail;
+	for (i = 0; i < VIB_AXES; i++) {
+		p->hist[i] = calloc(2 * n, sizeof(float));
+		p->acc[i] = calloc(bins, sizeof(float));
+		p->psd[i] = calloc(bins, sizeof(float));
+		if (!p->hist[i] || !p->acc[i] || !p->psd[i])
+			goto fail;
+	}
+
+	/* 周期Hann窗，50%重叠时各帧权重之和为常数 */
+	for (i = 0; i < n; i++) {
+		p->window[i] = (float)(0.5 - 0.5 * cos(2 * M_PI * i / n));
+		s2 += (double)p->window[i] * p->window[i];
+	}
+	/* 单边谱：2|X|^2 / (fs * Σw^2)，原始值换算成g */
+	p->scale = (float)(2.0 / (sample_hz * s2 * lsb_per_g * lsb_per_g));
+	return 0;
+
+fail:
+	vib_psd_free(p);
+	return -1;
+}
+
+void vib_psd_free(struct vib_psd *p)
+{
+	unsigned int i;
+
+	vib_fft_free(&p->fft);
+	free(p->window);
+	free(p->frame);
+	free(p->re);
+	free(p->im);
+	for (i = 0; i < VIB_AXES; i++) {
+		free(p->hist[i]);
+		free(p->acc[i]);
+		free(p->psd[i]);
+	}
+	memset(p, 0, sizeof(*p));
+}
+
+void vib_psd_set_bands(struct vib_psd *p, const struct vib_band *b, unsigned int nr)
+{
+	if (nr > VIB_MAX_BANDS)
+		nr = VIB_MAX_BANDS;
+	memcpy(p->bands, b, nr * sizeof(*b));
+	p->nr_bands = nr;
+}
+
+/* 历史缓冲清空，已经累加的帧保留 */
+static void restart_history(struct vib_psd *p)
+{
+	p->pos = 0;
+	p->filled = 0;
+	p->since_frame = 0;
+}
+
+void vib_psd_reset(struct vib_psd *p)
+{
+	unsigned int i;
+
+	restart_history(p);
+	p->since_report = 0;
+	p->lost = 0;
+	p->frames = 0;
+	for (i = 0; i < VIB_AXES; i++)
+		memset(p->acc[i], 0, (p->n / 2 + 1) * sizeof(float));
+}
+
+/* 最近 n 个样本去均值、加窗、FFT，|X|^2 累加 */
+static void psd_frame(struct vib_psd *p)
+{
+	unsigned int n = p->n, bins = n / 2 + 1, i, axis;
+
+	for (axis = 0; axis < VIB_AXES; axis++) {
+		const float *x = p->hist[axis] + p->pos;
+		float *acc = p->acc[axis];
+		double sum = 0;
+		float mean;
+
+		for (i = 0; i < n; i++)
+			sum += x[i];
+		mean = (float)(sum / n);
+		for (i = 0; i < n; i++)
+			p->frame[i] = (x[i] - mean) * p->window[i];
+
+		vib_fft_real(&p->fft, p->frame, p->re, p->im);
+		for (i = 0; i < bins; i++)
+			acc[i] += p->re[i] * p->re[i] + p->im[i] * p->im[i];
+	}
+	p->frames++;
+}
+
+static void psd_report(struct vib_psd *p, int64_t timestamp_ns)
+{
+	unsigned int bins = p->n / 2 + 1, i, b, axis;
+	struct vib_report r;
+	float df = p->fs / p->n;
+
+	memset(&r, 0, sizeof(r));
+	r.timestamp_ns = timestamp_ns;
+	r.frames = p->frames;
+	r.lost = p->lost;
+	r.bins = bins;
+	r.df = df;
+
+	for (axis = 0; axis < VIB_AXES; axis++) {
+		float *psd = p->psd[axis], *acc = p->acc[axis];
+		float k = p->scale / p->frames, total = 0, peak = 0;
+
+		for (i = 0; i < bins; i++) {
+			psd[i] = acc[i] * k;
+			acc[i] = 0;
+		}
+		/* 直流和奈奎斯特频点在单边谱中不翻倍 */
+		psd[0] *= 0.5f;
+		psd[bins - 1] *= 0.5f;
+
+		for (i = 1; i < bins; i++) {
+			total += psd[i];
+			if (psd[i] > peak) {
+				peak = psd[i];
+				r.peak_hz[axis] = i * df;
+			}
+		}
+		r.rms[axis] = sqrtf(total * df);
+		r.psd[axis] = psd;
+
+		for (b = 0; b < p->nr_bands; b++) {
+			float e = 0;
+
+			for (i = 0; i < bins; i++)
+				if (i * df >= p->bands[b].lo_hz && i * df < p->bands[b].hi_hz)
+					e += psd[i];
+			r.band[b][axis] = e * df;
+		}
+	}
+
+	p->frames = 0;
+	p->lost = 0;
+	p->report(p->ctx, &r);
+}
+
+void vib_psd_push(struct vib_psd *p, const struct mpu6050_sample *s, size_t n)
+{
+	unsigned int axis;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		/* 丢过样本，前后不连续，不能拼成一帧 */
+		if (s[i].flags & MPU6050_SAMPLE_OVERFLOW) {
+			p->lost++;
+			restart_history(p);
+		}
+		for (axis = 0; axis < VIB_AXES; axis++) {
+			p->hist[axis][p->pos] = s[i].accel[axis];
+			p->hist[axis][p->pos + p->n] = s[i].accel[axis];
+		}
+		if (++p->pos == p->n)
+			p->pos = 0;
+		if (p->filled < p->n)
+			p->filled++;
+
+		if (++p->since_frame >= p->hop && p->filled == p->n) {
+			p->since_frame = 0;
+			psd_frame(p);
+		}
+		if (++p->since_report >= p->report_samples) {
+			p->since_report = 0;
+			if (p->frames)
+				psd_report(p, s[i].timestamp_ns);
+		}
+	}
+}
@@ -0,0 +1,112 @@
+/*
+ * MPU6050 振动频谱分析库(用户态)
+ *
+ * 输入为驱动FIFO/数据就绪中断模式输出的 struct mpu6050_sample 流，
+ * 对三轴加速度做Welch功率谱估计：
+ *   每轴保留最近 n 个样本，每 hop 个样本取一帧，去均值、加Hann窗、
+ *   实数FFT，|X|^2 累加到平均谱；每 report_samples 个样本(默认1秒)
+ *   输出一次报告，含平均功率谱密度和各频带能量，然后清零重新累加。
+ *
+ * 功率谱为单边谱，单位 g^2/Hz；频带能量为频带内PSD乘以频率分辨率之和，
+ * 单位 g^2，即该频带的均方值，开方就是频带RMS。所有频带能量之和约等于
+ * 去掉直流后信号的方差(Parseval)。
+ *
+ * FFT：n 点实数序列打包成 n/2 点复数序列做基2 FFT，再拆出实数谱。
+ * 实部、虚部分开存放，旋转因子按级连续存放，蝶形内层循环是对连续数组的
+ * 同一运算，编译器可以直接向量化(有向量扩展的目标加 -O3 即可)。
+ *
+ * 典型用途：
+ *   路面粗糙度  看垂直轴 1~80Hz 频带能量
+ *   车轮/发动机不平衡  看转频附近窄带能量和峰值频率
+ */
+#ifndef __VIB_SPECTRUM_H
+#define __VIB_SPECTRUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mpu6050i2c.h"
+
+#define VIB_FFT_MIN			16
+#define VIB_FFT_MAX			8192
+#define VIB_MAX_BANDS		16
+#define VIB_AXES			3
+
+/* n 点实数FFT，n为2的幂，VIB_FFT_MIN~VIB_FFT_MAX */
+struct vib_fft {
+	unsigned int n;
+	unsigned int m;			/* 复数FFT点数 n/2 */
+	uint16_t *bitrev;		/* m 点位反转序 */
+	float *tw_re, *tw_im;	/* 各级旋转因子，第h级(半长h)从下标h-1开始，共m-1个 */
+	float *rt_re, *rt_im;	/* 拆分实数谱用的 exp(-2πik/n)，k = 0..m-1 */
+	float *wr, *wi;			/* m 点工作区 */
+};
+
+int vib_fft_init(struct vib_fft *f, unsigned int n);
+void vib_fft_free(struct vib_fft *f);
+/* m 点原位复数FFT(正变换，不归一化) */
+void vib_fft_complex(const struct vib_fft *f, float *re, float *im);
+/* n 点实数FFT，输出 0..n/2 共 n/2+1 个频点 */
+void vib_fft_real(struct vib_fft *f, const float *x, float *re, float *im);
+
+struct vib_band {
+	float lo_hz;			/* 含 */
+	float hi_hz;			/* 不含 */
+};
+
+struct vib_report {
+	int64_t timestamp_ns;	/* 最后一个样本的时刻 */
+	unsigned int frames;	/* 本次平均的帧数 */
+	unsigned int lost;		/* 本周期内带 MPU6050_SAMPLE_OVERFLOW 的样本数 */
+	unsigned int bins;		/* psd[] 每轴频点数 n/2+1 */
+	float df;				/* 频率分辨率 Hz */
+	const float *psd[VIB_AXES];		/* g^2/Hz，下一次报告前有效 */
+	float band[VIB_MAX_BANDS][VIB_AXES];	/* g^2 */
+	float rms[VIB_AXES];	/* 去直流后的总RMS，g */
+	float peak_hz[VIB_AXES];	/* 最大PSD所在频率(不含直流) */
+};
+
+typedef void (*vib_report_fn)(void *ctx, const struct vib_report *r);
+
+struct vib_psd {
+	struct vib_fft fft;
+	unsigned int n, hop;
+	unsigned int report_samples;
+	float fs;
+	float scale;			/* |X|^2 -> 单边PSD 的系数 */
+	float lsb_per_g;
+	float *window;
+	float *hist[VIB_AXES];	/* 长度 2n 的历史缓冲，后一半镜像前一半，取帧不用回绕 */
+	unsigned int pos;		/* 下一个样本写入位置 0..n-1 */
+	unsigned int filled;	/* 历史缓冲中的有效样本数，最多 n */
+	unsigned int since_frame;
+	unsigned int since_report;
+	unsigned int lost;
+	float *frame, *re, *im;
+	float *acc[VIB_AXES];	/* |X|^2 累加 */
+	float *psd[VIB_AXES];	/* 上次报告的结果 */
+	unsigned int frames;
+	struct vib_band bands[VIB_MAX_BANDS];
+	unsigned int nr_bands;
+	vib_report_fn report;
+	void *ctx;
+};
+
+/*
+ * sample_hz   采样率，与驱动实际采样率一致
+ * n           帧长(FFT点数)，2的幂；1kHz下512点分辨率约2Hz
+ * hop         帧移，n/2 为50%重叠
+ * report_hz   每秒报告次数，通常为1
+ * lsb_per_g   加速度灵敏度，MPU6050_IOC_GET_FILTER 的 accel_lsb_per_g
+ */
+int vib_psd_init(struct vib_psd *p, float sample_hz, unsigned int n, unsigned int hop,
+				 float report_hz, float lsb_per_g, vib_report_fn report, void *ctx);
+void vib_psd_free(struct vib_psd *p);
+/* 设置频带，超过 VIB_MAX_BANDS 的部分忽略 */
+void vib_psd_set_bands(struct vib_psd *p, const struct vib_band *b, unsigned int nr);
+/* 喂入样本，每凑够一次报告就调用一次回调 */
+void vib_psd_push(struct vib_psd *p, const struct mpu6050_sample *s, size_t n);
+/* 清空历史和累加，采样中断(丢样本、改采样率)后调用 */
+void vib_psd_reset(struct vib_psd *p);
+
+#endif /* __VIB_SPECTRUM_H */
@@ -2,35 +2,120 @@
 #include <linux/i2c.h>
 #include <linux/delay.h>
 #include <linux/cdev.h>
+#include <linux/kfifo.h>
+#include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
 #include <linux/device.h>
 #include <linux/fs.h>
 #include <linux/slab.h>
 #include <linux/mutex.h>
 #include <linux/uaccess.h>
-#include <linux/timer.h>
 #include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/ktime.h>
+#include <linux/timekeeping.h>
+#include <linux/firmware.h>
+#include <linux/notifier.h>
+#include <linux/math64.h>
+
+#include "bme280.h"
+#include "sgp30.h"
 
 #define DRIVER_NAME "sgp30"
 #define SGP30_INIT_CMD 0x2003
 #define SGP30_MEASURE_CMD 0x2008
+#define SGP30_MEASURE_RAW_CMD 0x2050
+#define SGP30_GET_BASELINE_CMD 0x2015
+#define SGP30_SET_BASELINE_CMD 0x201E
+#define SGP30_SET_HUMIDITY_CMD 0x2061
 #define DEV_NAME "sgp30"
 #define DEV_CLASS "sgp30_class"
-#define UPDATE_INTERVAL 1000 // 1秒更新间隔
-
+#define UPDATE_INTERVAL 1000 // 1秒更新间隔，片内动态基线算法要求按1Hz测量
+#define SGP30_WARMUP_SAMPLES 15 // 上电后前15秒固定输出400ppm/0ppb
+#define SGP30_STALE_MS (3 * UPDATE_INTERVAL) // 超过这个时间没有成功测量，read()返回错误
+
+/*
+ * 基线保存/恢复：
+ * 冷启动后片内算法要学习12小时基线才可靠，之后每小时取一次基线；
+ * 从文件恢复了基线的，运行1小时后就开始取。取到的基线缓存在
+ * /sys/class/sgp30_class/sgp30/baseline 并通知poll，由用户态的
+ * sgp30_baseline 工具写到 /lib/firmware/sgp30-<I2C设备名>.bl，
+ * 下次probe时用request_firmware读回，在Init_air_quality之后立即写入芯片。
+ * 文件为一行文本 "co2基线 tvoc基线 保存时的UTC秒数"，超过7天的基线按手册不再恢复。
+ */
+#define SGP30_BASELINE_COLD_SAMPLES (12 * 3600)
+#define SGP30_BASELINE_WARM_SAMPLES 3600
+#define SGP30_BASELINE_INTERVAL 3600
+#define SGP30_BASELINE_MAX_AGE (7 * 24 * 3600)
+
+/*
+ * 湿度补偿：订阅bme280的样本，换算成绝对湿度(8.8定点g/m^3)，
+ * 在下一次测量前用Set_absolute_humidity写入芯片。每个测量周期最多写一次，
+ * 与上次写入的值相差不到 SGP30_AH_DEADBAND 时不写，没有多余的总线传输。
+ * bme280没有加载时每隔 SGP30_HUB_RETRY 次测量重试一次订阅。
+ */
+#define SGP30_AH_DEADBAND 4     // 1/256 g/m^3，25℃下约0.07%RH
+#define SGP30_HUB_RETRY 10
+
+static bool hum_comp = true;
+module_param(hum_comp, bool, 0444);
+MODULE_PARM_DESC(hum_comp, "用BME280的温湿度做湿度补偿");
+
+/* 解绑后已打开的文件还可能在用，按引用计数释放：probe持有一个，每个打开的文件一个 */
 struct sgp30_device {
     struct i2c_client *client;
-    struct cdev cdev;
+    struct kref kref;
+    bool removed;               // 已解绑，文件操作返回ENODEV
+    struct cdev *cdev;          // 单独分配，最后一个文件关闭后由内核释放
     dev_t devno;
     struct class *class;
     struct device *device;
     struct mutex lock;
+    struct mutex cmd_lock;      // 串行化I2C命令，测量和基线读写不能交叉
     uint16_t co2;
     uint16_t tvoc;
     bool ready;
-    struct timer_list update_timer;
-    struct delayed_work init_work;
+    u64 timestamp_ns;           // 最近一次成功测量的时刻，CLOCK_BOOTTIME
+    u32 seq;                    // 成功测量次数，0为还没有数据
+    int err;                    // 最近一次测量的错误码
+    unsigned int samples;
+    unsigned long next_due;     // 下一次测量的jiffies，按固定节拍推进，不累积漂移
+    wait_queue_head_t wq;
+    struct delayed_work sample_work;
+    u32 next_baseline;          // 测量序号达到这个值时取一次基线
+    bool baseline_valid;
+    uint16_t baseline_co2;
+    uint16_t baseline_tvoc;
+    time64_t baseline_time;     // 取基线时的UTC秒数
+    struct notifier_block hum_nb;
+    int (*hum_unregister)(struct notifier_block *nb);   // 非NULL表示已订阅bme280
+    uint16_t hum_pending;       // bme280最新样本换算的绝对湿度，8.8定点g/m^3，0为没有
+    uint16_t hum_sent;          // 最近一次写入芯片的值，0为没写过
+    bool baseline_restored;
+    /* 记录模式的文件，采样工作向每个文件的kfifo投递记录 */
+    spinlock_t rec_lock;
+    struct list_head rec_files;
+    unsigned int rec_users;     // 记录模式的文件数，非0时每次测量附带原始信号
+};
+
+/* 每个打开的文件记录自己读到的测量序号，poll据此判断有没有新数据 */
+struct sgp30_file {
+    struct sgp30_device *dev;
+    u32 seq;
+    u32 mode;                   // SGP30_READ_*
+    u32 watermark;
+    bool overflow;              // 有记录被丢弃，下一条记录带上标志
+    struct mutex read_lock;     // kfifo的唯一消费者，同时保护模式切换
+    DECLARE_KFIFO_PTR(fifo, struct sgp30_record);
+    struct list_head node;
 };
 
+/* open时找实例用，remove时清空，sgp30_devs_lock保护 */
+static struct sgp30_device *sgp30_dev;
+static DEFINE_MUTEX(sgp30_devs_lock);
+
 /* CRC校验函数 */
 static uint8_t sgp30_crc(const uint8_t *data, size_t len)
 {
@@ -112,79 +197,496 @@ static int sgp30_i2c_read(struct i2c_client *client, uint16_t *co2, uint16_t *tv
     return 0;
 }
 
-/* 定时器回调函数 */
-static void update_data(struct timer_list *t)
+/* 读原始信号：Measure_raw_signals 后等25ms，返回 H2、Ethanol 两个字，各带CRC */
+static int sgp30_read_raw(struct i2c_client *client, uint16_t *h2, uint16_t *ethanol)
 {
-    struct sgp30_device *dev = from_timer(dev, t, update_timer);
-    uint16_t co2, tvoc;
+    uint8_t tx_buf[2] = {SGP30_MEASURE_RAW_CMD >> 8, SGP30_MEASURE_RAW_CMD & 0xFF};
+    uint8_t rx_buf[6];
+    int ret, i;
+
+    ret = i2c_master_send(client, tx_buf, sizeof(tx_buf));
+    if (ret < 0)
+        return ret;
+    msleep(25);
+    ret = i2c_master_recv(client, rx_buf, sizeof(rx_buf));
+    if (ret < 0)
+        return ret;
+
+    for (i = 0; i < 2; i++)
+        if (sgp30_crc(&rx_buf[i*3], 2) != rx_buf[i*3 + 2])
+            return -EIO;
+
+    *h2 = (rx_buf[0] << 8) | rx_buf[1];
+    *ethanol = (rx_buf[3] << 8) | rx_buf[4];
+    return 0;
+}
+
+/* 读基线：Get_baseline 后等10ms，返回 CO2eq、TVOC 两个字，各带CRC */
+static int sgp30_get_baseline(struct i2c_client *client, uint16_t *co2, uint16_t *tvoc)
+{
+    uint8_t tx_buf[2] = {SGP30_GET_BASELINE_CMD >> 8, SGP30_GET_BASELINE_CMD & 0xFF};
+    uint8_t rx_buf[6];
+    int ret, i;
+
+    ret = i2c_master_send(client, tx_buf, sizeof(tx_buf));
+    if (ret < 0)
+        return ret;
+    msleep(10);
+    ret = i2c_master_recv(client, rx_buf, sizeof(rx_buf));
+    if (ret < 0)
+        return ret;
+
+    for (i = 0; i < 2; i++)
+        if (sgp30_crc(&rx_buf[i*3], 2) != rx_buf[i*3 + 2])
+            return -EIO;
+
+    *co2 = (rx_buf[0] << 8) | rx_buf[1];
+    *tvoc = (rx_buf[3] << 8) | rx_buf[4];
+    return 0;
+}
+
+/* 写基线：参数顺序是 TVOC 在前、CO2eq 在后，与读出的顺序相反 */
+static int sgp30_set_baseline(struct i2c_client *client, uint16_t co2, uint16_t tvoc)
+{
+    uint8_t tx_buf[8] = {
+        SGP30_SET_BASELINE_CMD >> 8, SGP30_SET_BASELINE_CMD & 0xFF,
+        tvoc >> 8, tvoc & 0xFF, 0,
+        co2 >> 8, co2 & 0xFF, 0,
+    };
+    int ret;
+
+    tx_buf[4] = sgp30_crc(&tx_buf[2], 2);
+    tx_buf[7] = sgp30_crc(&tx_buf[5], 2);
+    ret = i2c_master_send(client, tx_buf, sizeof(tx_buf));
+    if (ret < 0)
+        return ret;
+    msleep(10);
+    return 0;
+}
+
+/* 写绝对湿度，8.8定点g/m^3，0为关闭补偿 */
+static int sgp30_set_humidity(struct i2c_client *client, uint16_t ah)
+{
+    uint8_t tx_buf[5] = {
+        SGP30_SET_HUMIDITY_CMD >> 8, SGP30_SET_HUMIDITY_CMD & 0xFF,
+        ah >> 8, ah & 0xFF, 0,
+    };
     int ret;
 
-    if (!dev->ready)
+    tx_buf[4] = sgp30_crc(&tx_buf[2], 2);
+    ret = i2c_master_send(client, tx_buf, sizeof(tx_buf));
+    if (ret < 0)
+        return ret;
+    msleep(10);
+    return 0;
+}
+
+/* 饱和水汽压(0.1Pa)，Magnus公式 611.2*exp(17.62T/(243.12+T))，-40~85℃每1℃一项 */
+static const uint32_t sgp30_svp[] = {
+    190, 211, 234, 259, 286, 316, 348, 384,
+    423, 465, 512, 562, 617, 676, 741, 811,
+    887, 970, 1059, 1155, 1260, 1372, 1494, 1625,
+    1766, 1919, 2083, 2259, 2448, 2652, 2870, 3105,
+    3356, 3625, 3913, 4222, 4552, 4904, 5281, 5683,
+    6112, 6569, 7057, 7576, 8129, 8717, 9343, 10008,
+    10714, 11464, 12260, 13105, 14000, 14948, 15953, 17017,
+    18142, 19333, 20591, 21921, 23326, 24809, 26374, 28025,
+    29766, 31601, 33533, 35569, 37711, 39966, 42337, 44830,
+    47450, 50203, 53094, 56128, 59313, 62653, 66156, 69827,
+    73675, 77704, 81924, 86341, 90963, 95797, 100852, 106137,
+    111659, 117427, 123452, 129741, 136304, 143152, 150294, 157742,
+    165504, 173593, 182020, 190796, 199933, 209443, 219338, 229632,
+    240337, 251467, 263035, 275056, 287543, 300512, 313977, 327954,
+    342458, 357506, 373114, 389299, 406077, 423468, 441487, 460155,
+    479489, 499508, 520232, 541681, 563875, 586834,
+};
+#define SGP30_SVP_TMIN (-40 * 100)
+#define SGP30_SVP_TMAX ((ARRAY_SIZE(sgp30_svp) - 1 - 40) * 100)
+
+/*
+ * 绝对湿度 AH = 2.1668 * e / T (g/m^3，e为水汽分压Pa，T为K)，e = RH * es
+ * temp: 0.01℃，hum: %RH的Q22.10(与bme280_data一致)，返回8.8定点g/m^3
+ * 代入单位后 AH*256 = es(0.1Pa) * hum * 0.05417 / (temp + 27315)
+ */
+static uint16_t sgp30_abs_humidity(s32 temp, u32 hum)
+{
+    u32 idx, frac;
+    u64 es, num, den;
+
+    temp = clamp_t(s32, temp, SGP30_SVP_TMIN, SGP30_SVP_TMAX - 1);
+    idx = (temp - SGP30_SVP_TMIN) / 100;
+    frac = (temp - SGP30_SVP_TMIN) % 100;
+    es = sgp30_svp[idx] + (sgp30_svp[idx + 1] - sgp30_svp[idx]) * frac / 100;
+    hum = min_t(u32, hum, 100 << 10);
+
+    num = es * hum * 5417;
+    den = (u64)(temp + 27315) * 100000;
+    num = div64_u64(num + den / 2, den);
+    if (num > 0xFFFF)
+        return 0xFFFF;
+    /* 0会关闭芯片的湿度补偿，极干燥时用最小值代替 */
+    return num ? num : 1;
+}
+
+/* bme280采样线程里调用，只换算和记录，总线操作留给采样工作 */
+static int sgp30_hum_notify(struct notifier_block *nb, unsigned long event, void *data)
+{
+    struct sgp30_device *dev = container_of(nb, struct sgp30_device, hum_nb);
+    const struct bme280_data *d = data;
+
+    if (event != BME280_EVENT_SAMPLE)
+        return NOTIFY_DONE;
+    WRITE_ONCE(dev->hum_pending, sgp30_abs_humidity(d->temp, d->hum));
+    return NOTIFY_OK;
+}
+
+/* 用symbol_get订阅bme280，bme280没加载时什么也不做，不产生模块依赖 */
+static void sgp30_hum_attach(struct sgp30_device *dev)
+{
+    int (*reg)(struct notifier_block *nb);
+    int (*unreg)(struct notifier_block *nb);
+
+    reg = symbol_get(bme280_register_notifier);
+    if (!reg)
         return;
+    unreg = symbol_get(bme280_unregister_notifier);
+    if (unreg) {
+        dev->hum_nb.notifier_call = sgp30_hum_notify;
+        if (reg(&dev->hum_nb) == 0) {
+            dev->hum_unregister = unreg;
+            dev_info(&dev->client->dev, "已订阅BME280，启用湿度补偿\n");
+        } else {
+            symbol_put(bme280_unregister_notifier);
+        }
+    }
+    symbol_put(bme280_register_notifier);
+}
 
-    ret = sgp30_i2c_read(dev->client, &co2, &tvoc);
-    if (!ret) {
-        mutex_lock(&dev->lock);
-        dev->co2 = co2;
-        dev->tvoc = tvoc;
-        mutex_unlock(&dev->lock);
+static void sgp30_hum_detach(struct sgp30_device *dev)
+{
+    if (!dev->hum_unregister)
+        return;
+    dev->hum_unregister(&dev->hum_nb);
+    dev->hum_unregister = NULL;
+    symbol_put(bme280_unregister_notifier);
+}
+
+/* 绝对湿度有变化时在测量前写入，调用者持有cmd_lock */
+static void sgp30_hum_update(struct sgp30_device *dev)
+{
+    uint16_t ah = READ_ONCE(dev->hum_pending);
+    int ret;
+
+    if (!ah || abs((int)ah - (int)dev->hum_sent) < SGP30_AH_DEADBAND)
+        return;
+    ret = sgp30_set_humidity(dev->client, ah);
+    if (ret) {
+        dev_warn_ratelimited(&dev->client->dev, "写入绝对湿度失败: %d\n", ret);
+        return;
     }
+    WRITE_ONCE(dev->hum_sent, ah);
+}
+
+/* 从 /lib/firmware/sgp30-<I2C设备名>.bl 恢复基线，必须紧跟在初始化命令之后 */
+static bool sgp30_restore_baseline(struct sgp30_device *dev)
+{
+    struct device *d = &dev->client->dev;
+    const struct firmware *fw;
+    unsigned int co2, tvoc;
+    long long saved;
+    time64_t now;
+    char name[48];
+    char *text;
+    int ret;
 
-    mod_timer(&dev->update_timer, jiffies + msecs_to_jiffies(UPDATE_INTERVAL));
+    snprintf(name, sizeof(name), "sgp30-%s.bl", dev_name(d));
+    if (firmware_request_nowarn(&fw, name, d))
+        return false;
+
+    text = kmemdup_nul(fw->data, fw->size, GFP_KERNEL);
+    release_firmware(fw);
+    if (!text)
+        return false;
+    ret = sscanf(text, "%x %x %lld", &co2, &tvoc, &saved);
+    kfree(text);
+    if (ret != 3 || co2 > 0xFFFF || tvoc > 0xFFFF) {
+        dev_warn(d, "%s 格式错误，忽略\n", name);
+        return false;
+    }
+
+    /* 系统时间还没同步(早于保存时间)时无法判断新旧，照常恢复 */
+    now = ktime_get_real_seconds();
+    if (now > saved && now - saved > SGP30_BASELINE_MAX_AGE) {
+        dev_info(d, "基线已保存 %lld 天，超过7天不再恢复\n", (now - saved) / 86400);
+        return false;
+    }
+
+    if (sgp30_set_baseline(dev->client, co2, tvoc)) {
+        dev_err(d, "写入基线失败\n");
+        return false;
+    }
+    dev_info(d, "已恢复基线 CO2eq 0x%04x TVOC 0x%04x\n", co2, tvoc);
+    return true;
 }
 
+/* 向记录模式的文件投递记录；缓冲区满时丢弃新记录，不去动消费者一侧 */
+static void sgp30_record_push(struct sgp30_device *dev, const struct sgp30_record *rec)
+{
+    struct sgp30_file *f;
+    struct sgp30_record r;
+
+    spin_lock(&dev->rec_lock);
+    list_for_each_entry(f, &dev->rec_files, node) {
+        if (kfifo_is_full(&f->fifo)) {
+            f->overflow = true;
+            continue;
+        }
+        r = *rec;
+        if (f->overflow)
+            r.flags |= SGP30_REC_OVERFLOW;
+        f->overflow = false;
+        kfifo_put(&f->fifo, r);
+    }
+    spin_unlock(&dev->rec_lock);
+}
 
-/* 初始化工作队列 */
-static void init_work_handler(struct work_struct *work)
+/* 采样工作：每秒测量一次，结果缓存起来，read()直接返回缓存 */
+static void sgp30_sample_work(struct work_struct *work)
 {
-    struct sgp30_device *dev = container_of(work, struct sgp30_device, init_work.work);
+    struct sgp30_device *dev = container_of(work, struct sgp30_device, sample_work.work);
+    struct sgp30_record rec = {0};
     uint16_t co2, tvoc;
+    long delay;
     int ret;
 
+    if (hum_comp && !dev->hum_unregister && dev->seq % SGP30_HUB_RETRY == 0)
+        sgp30_hum_attach(dev);
+
+    mutex_lock(&dev->cmd_lock);
+    sgp30_hum_update(dev);
     ret = sgp30_i2c_read(dev->client, &co2, &tvoc);
-    if (ret) {
-        schedule_delayed_work(&dev->init_work, msecs_to_jiffies(1500));
-        return;
+    /* 原始信号只给记录模式用，没有这样的读者时不占总线 */
+    if (!ret && READ_ONCE(dev->rec_users) &&
+        !sgp30_read_raw(dev->client, &rec.h2, &rec.ethanol))
+        rec.flags |= SGP30_REC_RAW;
+    mutex_unlock(&dev->cmd_lock);
+
+    mutex_lock(&dev->lock);
+    dev->err = ret;
+    if (!ret) {
+        dev->co2 = co2;
+        dev->tvoc = tvoc;
+        dev->timestamp_ns = ktime_get_boottime_ns();
+        dev->seq++;
+        /* 预热期间输出固定值，TVOC变为非0或过了预热时间即就绪 */
+        if (!dev->ready && (tvoc != 0 || ++dev->samples >= SGP30_WARMUP_SAMPLES)) {
+            dev->ready = true;
+            dev_info(&dev->client->dev, "传感器就绪\n");
+        }
+
+        rec.timestamp_ns = dev->timestamp_ns;
+        rec.seq = dev->seq;
+        rec.co2 = co2;
+        rec.tvoc = tvoc;
+        rec.abs_humidity = dev->hum_sent;
+        if (!dev->ready)
+            rec.flags |= SGP30_REC_WARMUP;
+        if (dev->baseline_restored)
+            rec.flags |= SGP30_REC_BASELINE;
+    }
+    mutex_unlock(&dev->lock);
+    if (!ret) {
+        sgp30_record_push(dev, &rec);
+        wake_up_interruptible(&dev->wq);
     }
 
-    if (tvoc == 0) {
-        schedule_delayed_work(&dev->init_work, msecs_to_jiffies(1500));
-        return;
+    /* 基线学习够了，每小时取一次，通知用户态保存 */
+    if (!ret && dev->seq >= dev->next_baseline) {
+        mutex_lock(&dev->cmd_lock);
+        ret = sgp30_get_baseline(dev->client, &co2, &tvoc);
+        mutex_unlock(&dev->cmd_lock);
+        if (!ret) {
+            mutex_lock(&dev->lock);
+            dev->baseline_co2 = co2;
+            dev->baseline_tvoc = tvoc;
+            dev->baseline_time = ktime_get_real_seconds();
+            dev->baseline_valid = true;
+            dev->next_baseline = dev->seq + SGP30_BASELINE_INTERVAL;
+            mutex_unlock(&dev->lock);
+            sysfs_notify(&dev->device->kobj, NULL, "baseline");
+        } else {
+            dev_warn_ratelimited(&dev->client->dev, "读取基线失败: %d\n", ret);
+        }
+    }
+
+    /* 按固定节拍排下一次，工作被推迟太多时重新对齐 */
+    dev->next_due += msecs_to_jiffies(UPDATE_INTERVAL);
+    delay = (long)(dev->next_due - jiffies);
+    if (delay < 0) {
+        dev->next_due = jiffies;
+        delay = 0;
     }
+    schedule_delayed_work(&dev->sample_work, delay);
+}
 
-    dev->ready = true;
-    dev_info(&dev->client->dev, "传感器就绪\n");
+/* 最后一个引用放掉时释放实例 */
+static void sgp30_dev_release(struct kref *kref)
+{
+    kfree(container_of(kref, struct sgp30_device, kref));
 }
 
 /* 文件操作函数 */
 static int sgp30_open(struct inode *inode, struct file *filp)
 {
-    struct sgp30_device *dev = container_of(inode->i_cdev, struct sgp30_device, cdev);
-    filp->private_data = dev;
+    struct sgp30_device *dev;
+    struct sgp30_file *f;
+
+    f = kzalloc(sizeof(*f), GFP_KERNEL);
+    if (!f)
+        return -ENOMEM;
+
+    mutex_lock(&sgp30_devs_lock);
+    dev = sgp30_dev;
+    if (dev)
+        kref_get(&dev->kref);
+    mutex_unlock(&sgp30_devs_lock);
+    if (!dev) {
+        kfree(f);
+        return -ENODEV;
+    }
+    f->dev = dev;
+    f->mode = SGP30_READ_TEXT;
+    f->watermark = 1;
+    mutex_init(&f->read_lock);
+    INIT_LIST_HEAD(&f->node);
+    filp->private_data = f;
     return 0;
 }
 
 static int sgp30_release(struct inode *inode, struct file *filp)
 {
+    struct sgp30_file *f = filp->private_data;
+    struct sgp30_device *dev = f->dev;
+
+    spin_lock(&dev->rec_lock);
+    if (f->mode == SGP30_READ_RECORDS)
+        dev->rec_users--;
+    list_del(&f->node);
+    spin_unlock(&dev->rec_lock);
+    kfifo_free(&f->fifo);
+    kfree(f);
+    kref_put(&dev->kref, sgp30_dev_release);
     return 0;
 }
 
+/* 切换文件的read()模式，记录缓冲在第一次进入记录模式时分配 */
+static int sgp30_set_read_mode(struct sgp30_file *f, u32 mode)
+{
+    struct sgp30_device *dev = f->dev;
+    int ret = 0;
+
+    if (mode != SGP30_READ_TEXT && mode != SGP30_READ_RECORDS)
+        return -EINVAL;
+
+    mutex_lock(&f->read_lock);
+    if (mode == f->mode)
+        goto out;
+    if (mode == SGP30_READ_RECORDS && !kfifo_initialized(&f->fifo)) {
+        ret = kfifo_alloc(&f->fifo, SGP30_RECORD_BUF, GFP_KERNEL);
+        if (ret)
+            goto out;
+    }
+
+    spin_lock(&dev->rec_lock);
+    if (mode == SGP30_READ_RECORDS) {
+        kfifo_reset(&f->fifo);
+        f->overflow = false;
+        list_add_tail(&f->node, &dev->rec_files);
+        dev->rec_users++;
+    } else {
+        list_del_init(&f->node);
+        dev->rec_users--;
+    }
+    f->mode = mode;
+    spin_unlock(&dev->rec_lock);
+out:
+    mutex_unlock(&f->read_lock);
+    return ret;
+}
+
+static bool sgp30_records_ready(struct sgp30_file *f)
+{
+    return kfifo_len(&f->fifo) >= READ_ONCE(f->watermark);
+}
+
+/* 记录模式：一次返回缓冲区里能放下的所有整条记录 */
+static ssize_t sgp30_read_records(struct file *filp, struct sgp30_file *f,
+                                  char __user *buf, size_t count)
+{
+    struct sgp30_device *dev = f->dev;
+    unsigned int copied;
+    int ret;
+
+    if (count < sizeof(struct sgp30_record))
+        return -EINVAL;
+
+    mutex_lock(&f->read_lock);
+    while (!sgp30_records_ready(f)) {
+        mutex_unlock(&f->read_lock);
+        if (filp->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(dev->wq, sgp30_records_ready(f) ||
+                                       READ_ONCE(dev->removed));
+        if (ret)
+            return ret;
+        if (READ_ONCE(dev->removed))
+            return -ENODEV;
+        mutex_lock(&f->read_lock);
+    }
+
+    ret = kfifo_to_user(&f->fifo, buf, count, &copied);
+    if (!ret)
+        f->seq = READ_ONCE(dev->seq);
+    mutex_unlock(&f->read_lock);
+    return ret ? ret : copied;
+}
+
 static ssize_t sgp30_read(struct file *filp, char __user *buf,
                          size_t count, loff_t *fpos)
 {
-    struct sgp30_device *dev = filp->private_data;
+    struct sgp30_file *f = filp->private_data;
+    struct sgp30_device *dev = f->dev;
     char data_str[32];
     int ret, len;
 
-    mutex_lock(&dev->lock);
-    ret = sgp30_i2c_read(dev->client, &dev->co2, &dev->tvoc); // 使用重命名的函数
-    mutex_unlock(&dev->lock);
+    if (READ_ONCE(dev->removed))
+        return -ENODEV;
+    if (READ_ONCE(f->mode) == SGP30_READ_RECORDS)
+        return sgp30_read_records(filp, f, buf, count);
+
+    /* 只有上电后第一次测量之前需要等，之后总是立即返回最新缓存 */
+    if (!READ_ONCE(dev->seq)) {
+        if (filp->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(dev->wq, READ_ONCE(dev->seq) ||
+                                       READ_ONCE(dev->removed));
+        if (ret)
+            return ret;
+        if (READ_ONCE(dev->removed))
+            return -ENODEV;
+    }
 
-    if (ret < 0)
+    mutex_lock(&dev->lock);
+    if (dev->err && ktime_get_boottime_ns() - dev->timestamp_ns >
+        (u64)SGP30_STALE_MS * NSEC_PER_MSEC) {
+        ret = dev->err;
+        mutex_unlock(&dev->lock);
         return ret;
-
+    }
     len = snprintf(data_str, sizeof(data_str), "%d %d\n", dev->co2, dev->tvoc);
-    
+    f->seq = dev->seq;
+    mutex_unlock(&dev->lock);
+
     if (count < len)
         return -EINVAL;
     
@@ -194,11 +696,120 @@ static ssize_t sgp30_read(struct file *filp, char __user *buf,
     return len;
 }
 
+/*
+ * baseline 属性：
+ *   读  "co2基线 tvoc基线 UTC秒数"，还没取到可信基线时返回ENODATA
+ *   写  "co2基线 tvoc基线"(十六进制)，立即写入芯片，一小时后重新取基线
+ */
+static ssize_t baseline_show(struct device *d, struct device_attribute *attr, char *buf)
+{
+    struct sgp30_device *dev = dev_get_drvdata(d);
+    ssize_t ret;
+
+    mutex_lock(&dev->lock);
+    if (dev->baseline_valid)
+        ret = sysfs_emit(buf, "0x%04x 0x%04x %lld\n", dev->baseline_co2,
+                         dev->baseline_tvoc, (long long)dev->baseline_time);
+    else
+        ret = -ENODATA;
+    mutex_unlock(&dev->lock);
+    return ret;
+}
+
+static ssize_t baseline_store(struct device *d, struct device_attribute *attr,
+                              const char *buf, size_t count)
+{
+    struct sgp30_device *dev = dev_get_drvdata(d);
+    unsigned int co2, tvoc;
+    int ret;
+
+    if (sscanf(buf, "%x %x", &co2, &tvoc) != 2 || co2 > 0xFFFF || tvoc > 0xFFFF)
+        return -EINVAL;
+
+    mutex_lock(&dev->cmd_lock);
+    ret = sgp30_set_baseline(dev->client, co2, tvoc);
+    mutex_unlock(&dev->cmd_lock);
+    if (ret)
+        return ret;
+
+    mutex_lock(&dev->lock);
+    dev->next_baseline = dev->seq + SGP30_BASELINE_WARM_SAMPLES;
+    mutex_unlock(&dev->lock);
+    return count;
+}
+static DEVICE_ATTR_RW(baseline);
+
+/* 最近一次写入芯片的绝对湿度(g/m^3)，还没有湿度补偿时返回ENODATA */
+static ssize_t absolute_humidity_show(struct device *d, struct device_attribute *attr,
+                                      char *buf)
+{
+    struct sgp30_device *dev = dev_get_drvdata(d);
+    uint16_t ah = READ_ONCE(dev->hum_sent);
+
+    if (!ah)
+        return -ENODATA;
+    return sysfs_emit(buf, "%u.%03u\n", ah >> 8, ((ah & 0xFF) * 1000 + 128) >> 8);
+}
+static DEVICE_ATTR_RO(absolute_humidity);
+
+static struct attribute *sgp30_attrs[] = {
+    &dev_attr_baseline.attr,
+    &dev_attr_absolute_humidity.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(sgp30);
+
+/* 文本模式：有比本文件上次读到的更新的测量结果时可读；记录模式：攒够watermark条 */
+static __poll_t sgp30_poll(struct file *filp, poll_table *wait)
+{
+    struct sgp30_file *f = filp->private_data;
+    struct sgp30_device *dev = f->dev;
+
+    poll_wait(filp, &dev->wq, wait);
+    if (READ_ONCE(dev->removed))
+        return EPOLLERR | EPOLLHUP;
+    if (READ_ONCE(f->mode) == SGP30_READ_RECORDS) {
+        if (sgp30_records_ready(f))
+            return EPOLLIN | EPOLLRDNORM;
+    } else if (READ_ONCE(dev->seq) != READ_ONCE(f->seq)) {
+        return EPOLLIN | EPOLLRDNORM;
+    }
+    return 0;
+}
+
+static long sgp30_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+    struct sgp30_file *f = filp->private_data;
+    u32 val;
+
+    if (READ_ONCE(f->dev->removed))
+        return -ENODEV;
+
+    switch (cmd) {
+    case SGP30_IOC_SET_READ_MODE:
+        if (get_user(val, (u32 __user *)arg))
+            return -EFAULT;
+        return sgp30_set_read_mode(f, val);
+    case SGP30_IOC_SET_WATERMARK:
+        if (get_user(val, (u32 __user *)arg))
+            return -EFAULT;
+        if (val < 1 || val > SGP30_RECORD_BUF)
+            return -EINVAL;
+        WRITE_ONCE(f->watermark, val);
+        wake_up_interruptible(&f->dev->wq);
+        return 0;
+    default:
+        return -ENOTTY;
+    }
+}
+
 static const struct file_operations sgp30_fops = {
     .owner = THIS_MODULE,
     .open = sgp30_open,
     .release = sgp30_release,
     .read = sgp30_read,
+    .poll = sgp30_poll,
+    .unlocked_ioctl = sgp30_ioctl,
 };
 
 /* 探测函数 */
@@ -208,17 +819,29 @@ static int sgp30_probe(struct i2c_client *client, const struct i2c_device_id *id
     uint16_t co2, tvoc;
     int ret;
 
-    dev = devm_kzalloc(&client->dev, sizeof(*dev), GFP_KERNEL);
+    /* 解绑后打开的文件可能还在用，不能用devm */
+    dev = kzalloc(sizeof(*dev), GFP_KERNEL);
     if (!dev)
         return -ENOMEM;
 
+    kref_init(&dev->kref);
     dev->client = client;
     mutex_init(&dev->lock);
+    mutex_init(&dev->cmd_lock);
+    spin_lock_init(&dev->rec_lock);
+    INIT_LIST_HEAD(&dev->rec_files);
+    init_waitqueue_head(&dev->wq);
     i2c_set_clientdata(client, dev);
     dev->ready = false;
 
-    /* 初始化传感器 */
+    /* 初始化传感器，有保存的基线就马上恢复，省掉12小时的学习期 */
     sgp30_start(client);
+    msleep(10);
+    dev->baseline_restored = sgp30_restore_baseline(dev);
+    if (dev->baseline_restored)
+        dev->next_baseline = SGP30_BASELINE_WARM_SAMPLES;
+    else
+        dev->next_baseline = SGP30_BASELINE_COLD_SAMPLES;
 
     /* 等待传感器就绪 */
     // while (1) {
@@ -235,7 +858,7 @@ static int sgp30_probe(struct i2c_client *client, const struct i2c_device_id *id
     /* 注册字符设备 */
     if ((ret = alloc_chrdev_region(&dev->devno, 0, 1, DEV_NAME)) < 0) {
         dev_err(&client->dev, "设备号分配失败\n");
-        return ret;
+        goto put_dev;
     }
 
     dev->class = class_create(THIS_MODULE, DEV_CLASS);
@@ -244,31 +867,47 @@ static int sgp30_probe(struct i2c_client *client, const struct i2c_device_id *id
         goto chrdev_err;
     }
 
-    cdev_init(&dev->cdev, &sgp30_fops);
-    if ((ret = cdev_add(&dev->cdev, dev->devno, 1)) < 0)
+    /* 关闭文件时内核在release之后还会访问cdev，cdev不能嵌在实例里随实例释放 */
+    dev->cdev = cdev_alloc();
+    if (!dev->cdev) {
+        ret = -ENOMEM;
         goto class_err;
+    }
+    dev->cdev->ops = &sgp30_fops;
+    dev->cdev->owner = THIS_MODULE;
+    if ((ret = cdev_add(dev->cdev, dev->devno, 1)) < 0) {
+        kobject_put(&dev->cdev->kobj);
+        goto class_err;
+    }
+    mutex_lock(&sgp30_devs_lock);
+    sgp30_dev = dev;
+    mutex_unlock(&sgp30_devs_lock);
 
-    dev->device = device_create(dev->class, NULL, dev->devno, NULL, DEV_NAME);
+    dev->device = device_create_with_groups(dev->class, &client->dev, dev->devno, dev,
+                                            sgp30_groups, DEV_NAME);
     if (IS_ERR(dev->device)) {
         ret = PTR_ERR(dev->device);
         goto cdev_err;
     }
-    /* 初始化定时器和工作队列 */
-    timer_setup(&dev->update_timer, update_data, 0);
-    INIT_DELAYED_WORK(&dev->init_work, init_work_handler);
-    
-    /* 启动初始化检测 */
-    schedule_delayed_work(&dev->init_work, msecs_to_jiffies(100));
+    /* 启动1Hz采样，第一次测量在初始化命令之后1秒 */
+    INIT_DELAYED_WORK(&dev->sample_work, sgp30_sample_work);
+    dev->next_due = jiffies + msecs_to_jiffies(UPDATE_INTERVAL);
+    schedule_delayed_work(&dev->sample_work, msecs_to_jiffies(UPDATE_INTERVAL));
 
     dev_info(&client->dev, "驱动加载成功\n");
     return 0;
 
 cdev_err:
-    cdev_del(&dev->cdev);
+    mutex_lock(&sgp30_devs_lock);
+    sgp30_dev = NULL;
+    mutex_unlock(&sgp30_devs_lock);
+    cdev_del(dev->cdev);
 class_err:
     class_destroy(dev->class);
 chrdev_err:
     unregister_chrdev_region(dev->devno, 1);
+put_dev:
+    kref_put(&dev->kref, sgp30_dev_release);
     return ret;
 }
 
@@ -276,14 +915,23 @@ static int sgp30_remove(struct i2c_client *client)
 {
     struct sgp30_device *dev = i2c_get_clientdata(client);
 
-    del_timer_sync(&dev->update_timer);
-    cancel_delayed_work_sync(&dev->init_work);
+    cancel_delayed_work_sync(&dev->sample_work);
+    sgp30_hum_detach(dev);
     device_destroy(dev->class, dev->devno);
+
+    /* 不再有新的打开，已打开的文件之后返回ENODEV，阻塞的读者被唤醒 */
+    mutex_lock(&sgp30_devs_lock);
+    sgp30_dev = NULL;
+    mutex_unlock(&sgp30_devs_lock);
+    WRITE_ONCE(dev->removed, true);
+    wake_up_all(&dev->wq);
+
     class_destroy(dev->class);
-    cdev_del(&dev->cdev);
+    cdev_del(dev->cdev);
     unregister_chrdev_region(dev->devno, 1);
 
     dev_info(&client->dev, "设备已卸载\n");
+    kref_put(&dev->kref, sgp30_dev_release);
     return 0;
 }
 
@@ -0,0 +1,47 @@
+/*
+ * SGP30 驱动与应用程序共用的数据结构和ioctl定义
+ */
+#ifndef __SGP30_H
+#define __SGP30_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/* read() 模式，按文件设置，默认文本 */
+#define SGP30_READ_TEXT         0   /* 每次返回最新一次测量 "co2 tvoc\n" */
+#define SGP30_READ_RECORDS      1   /* 每次返回尽可能多的 sgp30_record */
+
+/*
+ * 记录模式下 read() 返回的定长记录，每秒一条。
+ * 有记录模式的文件打开时，驱动在每次IAQ测量后再测一次原始信号
+ * (Measure_raw_signals 0x2050，多约25ms总线占用)，h2/ethanol 有效并带 SGP30_REC_RAW。
+ */
+struct sgp30_record {
+    __u64 timestamp_ns;     /* 测量完成时刻，CLOCK_BOOTTIME */
+    __u32 seq;              /* 测量序号，与文本模式/poll 同一序号空间 */
+    __u16 co2;              /* CO2eq，ppm */
+    __u16 tvoc;             /* TVOC，ppb */
+    __u16 h2;               /* 原始信号，无单位 */
+    __u16 ethanol;
+    __u16 abs_humidity;     /* 当前生效的绝对湿度补偿，8.8定点g/m^3，0为未补偿 */
+    __u16 flags;            /* SGP30_REC_* */
+};
+
+/* 本记录之前有记录因缓冲区满被丢弃 */
+#define SGP30_REC_OVERFLOW      0x01
+/* 预热期间，CO2eq/TVOC 为固定值 400/0 */
+#define SGP30_REC_WARMUP        0x02
+/* h2/ethanol 有效 */
+#define SGP30_REC_RAW           0x04
+/* 基线是从保存的文件恢复的，不需要12小时学习 */
+#define SGP30_REC_BASELINE      0x08
+
+/* 每个文件的记录缓冲深度，1Hz测量可以缓存1分钟 */
+#define SGP30_RECORD_BUF        64
+
+#define SGP30_IOC_MAGIC         'S'
+#define SGP30_IOC_SET_READ_MODE _IOW(SGP30_IOC_MAGIC, 1, __u32)
+/* 记录模式下阻塞读取/poll 等到至少 watermark 条记录，1~SGP30_RECORD_BUF */
+#define SGP30_IOC_SET_WATERMARK _IOW(SGP30_IOC_MAGIC, 2, __u32)
+
+#endif /* __SGP30_H */
@@ -0,0 +1,115 @@
+/*
+ * SGP30 基线保存工具
+ *
+ * 驱动每小时从芯片取一次基线，更新 /sys/class/sgp30_class/sgp30/baseline
+ * 并通知poll；本工具常驻等待通知，把基线写到 <固件目录>/sgp30-<I2C设备名>.bl
+ * (默认 /lib/firmware)，驱动下次probe时自动恢复。
+ *
+ * 用法：
+ *   sgp30_baseline [固件目录]        常驻，每次有新基线就保存
+ *   sgp30_baseline -1 [固件目录]     有可信基线就保存一次后退出(关机脚本里用)
+ *
+ * 编译：
+ *   riscv64-buildroot-linux-gnu-gcc -O2 -o sgp30_baseline sgp30_baseline.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <libgen.h>
+#include <limits.h>
+
+#define SYSFS_DIR "/sys/class/sgp30_class/sgp30"
+
+/* 由类设备的 device 链接找到I2C设备名，例如 1-0058 */
+static int i2c_name(char *out, size_t len)
+{
+    char link[PATH_MAX];
+    ssize_t n = readlink(SYSFS_DIR "/device", link, sizeof(link) - 1);
+
+    if (n < 0)
+        return -1;
+    link[n] = '\0';
+    snprintf(out, len, "%s", basename(link));
+    return 0;
+}
+
+/* 先写临时文件再rename，掉电时不会留下半个文件 */
+static int save(const char *path, const char *line)
+{
+    char tmp[PATH_MAX];
+    int fd, ok;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    ok = write(fd, line, strlen(line)) == (ssize_t)strlen(line) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp, path) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int once = argc > 1 && !strcmp(argv[1], "-1");
+    const char *fwdir = argc > 1 + once ? argv[1 + once] : "/lib/firmware";
+    char name[64], path[PATH_MAX], line[64];
+    struct pollfd pfd;
+    ssize_t n;
+
+    if (i2c_name(name, sizeof(name))) {
+        perror("查找SGP30设备失败");
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/sgp30-%s.bl", fwdir, name);
+
+    pfd.fd = open(SYSFS_DIR "/baseline", O_RDONLY);
+    if (pfd.fd < 0) {
+        perror("打开baseline属性失败");
+        return -1;
+    }
+    pfd.events = POLLPRI | POLLERR;
+
+    while (1) {
+        /* sysfs属性每次都要从头读，读过之后poll才会等下一次通知 */
+        lseek(pfd.fd, 0, SEEK_SET);
+        n = read(pfd.fd, line, sizeof(line) - 1);
+        if (n > 0) {
+            line[n] = '\0';
+            if (save(path, line) < 0) {
+                perror(path);
+                return -1;
+            }
+            printf("已保存 %s: %s", path, line);
+        } else if (errno == ENODATA) {
+            printf("芯片还在学习基线%s\n", once ? "，没有可保存的基线" : "，等待...");
+            if (once) {
+                close(pfd.fd);
+                return 1;
+            }
+        } else {
+            perror("读取基线失败");
+            return -1;
+        }
+        if (once)
+            break;
+
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+    }
+
+    close(pfd.fd);
+    return 0;
+}
@@ -1,25 +1,93 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/ioctl.h>
 
-int main() {
+#include "sgp30.h"
+
+/* 记录模式：攒够watermark条再一次读出，不做文本格式化和解析 */
+static int record_test(int fd, unsigned int watermark)
+{
+    struct sgp30_record recs[SGP30_RECORD_BUF];
+    unsigned int mode = SGP30_READ_RECORDS;
+    ssize_t ret;
+    size_t i, n;
+
+    if (ioctl(fd, SGP30_IOC_SET_READ_MODE, &mode) < 0 ||
+        ioctl(fd, SGP30_IOC_SET_WATERMARK, &watermark) < 0) {
+        perror("设置记录模式失败");
+        return -1;
+    }
+
+    while (1) {
+        ret = read(fd, recs, sizeof(recs));
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("读取失败");
+            return -1;
+        }
+        n = ret / sizeof(recs[0]);
+        printf("一次读到 %zu 条记录\n", n);
+        for (i = 0; i < n; i++) {
+            struct sgp30_record *r = &recs[i];
+            printf("  #%u %llu.%03llu CO2eq %u ppm TVOC %u ppb",
+                   r->seq, (unsigned long long)(r->timestamp_ns / 1000000000),
+                   (unsigned long long)(r->timestamp_ns / 1000000 % 1000), r->co2, r->tvoc);
+            if (r->flags & SGP30_REC_RAW)
+                printf(" H2 %u Ethanol %u", r->h2, r->ethanol);
+            if (r->abs_humidity)
+                printf(" AH %.2fg/m3", r->abs_humidity / 256.0);
+            printf("%s%s%s\n", (r->flags & SGP30_REC_WARMUP) ? " 预热中" : "",
+                   (r->flags & SGP30_REC_BASELINE) ? " 已恢复基线" : "",
+                   (r->flags & SGP30_REC_OVERFLOW) ? " (之前有丢失)" : "");
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
     int fd = open("/dev/sgp30", O_RDONLY);
     if (fd < 0) {
         perror("打开设备失败");
         return -1;
     }
 
+    /* test_sgp30 -r [条数]：记录模式，默认攒10条读一次 */
+    if (argc > 1 && !strcmp(argv[1], "-r")) {
+        int ret = record_test(fd, argc > 2 ? (unsigned int)atoi(argv[2]) : 10);
+        close(fd);
+        return ret;
+    }
+
+    /* 驱动每秒测量一次，poll等到有新结果再读，read()本身不阻塞在I2C上 */
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
     char buffer[64];
     while (1)
     {
-        ssize_t ret = read(fd, buffer, sizeof(buffer));
+        int n = poll(&pfd, 1, 5000);
+        if (n == 0) {
+            printf("5秒内没有新的测量结果\n");
+            continue;
+        } else if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll失败");
+            break;
+        }
+        ssize_t ret = read(fd, buffer, sizeof(buffer) - 1);
         if (ret > 0) {
+            buffer[ret] = '\0';
             printf("传感器数据: %s", buffer);
         } else {
             perror("读取失败");
+            sleep(1);
         }
-        sleep(1);
     }
     close(fd);
     return 0;
-}
\ No newline at end of file
+}
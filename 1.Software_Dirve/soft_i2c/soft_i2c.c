@@ -0,0 +1,186 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/gpio.h>
+#include <linux/i2c.h>
+#include <linux/i2c-algo-bit.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+/*
+ * GPIO模拟的I2C总线，注册为标准i2c_adapter(i2c-algo-bit)。
+ * 挂在这条总线上的传感器都按普通i2c_client驱动，由适配器统一做总线互斥，
+ * 不再需要每个驱动各自实现一份起始/停止/恢复时序。
+ *
+ * 例：insmod soft_i2c.ko bus_khz=400 devices=bme280@0x76,sgp30@0x58
+ */
+
+#define DRIVER_NAME "soft_i2c"
+#define SOFT_I2C_MAX_CLIENTS 8
+
+static int scl_gpio = 36;
+module_param(scl_gpio, int, 0444);
+MODULE_PARM_DESC(scl_gpio, "SCL引脚GPIO编号");
+
+static int sda_gpio = 61;
+module_param(sda_gpio, int, 0444);
+MODULE_PARM_DESC(sda_gpio, "SDA引脚GPIO编号");
+
+static unsigned int bus_khz = 100;
+module_param(bus_khz, uint, 0444);
+MODULE_PARM_DESC(bus_khz, "总线频率(kHz)，100为标准模式，400为快速模式");
+
+static bool scl_open_drain = true;
+module_param(scl_open_drain, bool, 0444);
+MODULE_PARM_DESC(scl_open_drain, "SCL按开漏方式驱动并回读，支持从机时钟拉伸");
+
+static unsigned int stretch_ms = 100;
+module_param(stretch_ms, uint, 0444);
+MODULE_PARM_DESC(stretch_ms, "等待从机释放SCL(时钟拉伸)的超时(ms)");
+
+static int bus_nr = -1;
+module_param(bus_nr, int, 0444);
+MODULE_PARM_DESC(bus_nr, "指定总线号，-1为自动分配");
+
+static char *devices = "bme280@0x76";
+module_param(devices, charp, 0444);
+MODULE_PARM_DESC(devices, "在总线上实例化的设备，格式 name@addr[,name@addr...]");
+
+static struct i2c_algo_bit_data bit_data;
+static struct i2c_adapter adapter;
+static struct i2c_client *clients[SOFT_I2C_MAX_CLIENTS];
+static int nr_clients;
+
+/* 开漏模拟：输出高电平时释放引脚，由上拉电阻拉高 */
+static void soft_i2c_setsda(void *data, int state) {
+    if (state)
+        gpio_direction_input(sda_gpio);
+    else
+        gpio_direction_output(sda_gpio, 0);
+}
+
+static void soft_i2c_setscl(void *data, int state) {
+    if (scl_open_drain) {
+        if (state)
+            gpio_direction_input(scl_gpio);
+        else
+            gpio_direction_output(scl_gpio, 0);
+    } else {
+        gpio_set_value(scl_gpio, state);
+    }
+}
+
+static int soft_i2c_getsda(void *data) {
+    return gpio_get_value(sda_gpio);
+}
+
+static int soft_i2c_getscl(void *data) {
+    return gpio_get_value(scl_gpio);
+}
+
+/* 按 devices 参数实例化设备，单个设备失败不影响总线 */
+static void soft_i2c_add_devices(void) {
+    char *list, *cur, *entry, *at;
+    struct i2c_board_info info;
+    struct i2c_client *client;
+    u16 addr;
+
+    if (!devices || !*devices)
+        return;
+
+    list = kstrdup(devices, GFP_KERNEL);
+    if (!list)
+        return;
+
+    cur = list;
+    while ((entry = strsep(&cur, ",")) != NULL) {
+        if (nr_clients >= SOFT_I2C_MAX_CLIENTS)
+            break;
+        at = strchr(entry, '@');
+        if (!at || at == entry || kstrtou16(at + 1, 0, &addr)) {
+            pr_warn(DRIVER_NAME ": 无效的设备描述 '%s'\n", entry);
+            continue;
+        }
+        *at = '\0';
+
+        memset(&info, 0, sizeof(info));
+        strscpy(info.type, entry, I2C_NAME_SIZE);
+        info.addr = addr;
+        client = i2c_new_client_device(&adapter, &info);
+        if (IS_ERR(client)) {
+            pr_warn(DRIVER_NAME ": 实例化 %s@0x%02x 失败: %ld\n",
+                    entry, addr, PTR_ERR(client));
+            continue;
+        }
+        clients[nr_clients++] = client;
+    }
+    kfree(list);
+}
+
+static int __init soft_i2c_init(void) {
+    int ret;
+
+    if (!bus_khz || bus_khz > 400) {
+        pr_err(DRIVER_NAME ": 不支持的总线频率 %ukHz\n", bus_khz);
+        return -EINVAL;
+    }
+
+    if ((ret = gpio_request(scl_gpio, "soft_i2c_scl")) != 0)
+        return ret;
+    if ((ret = gpio_request(sda_gpio, "soft_i2c_sda")) != 0)
+        goto free_scl;
+
+    /* 空闲状态两根线都为高 */
+    gpio_direction_input(sda_gpio);
+    if (scl_open_drain)
+        gpio_direction_input(scl_gpio);
+    else
+        gpio_direction_output(scl_gpio, 1);
+
+    bit_data.setsda = soft_i2c_setsda;
+    bit_data.setscl = soft_i2c_setscl;
+    bit_data.getsda = soft_i2c_getsda;
+    /* 推挽输出的SCL无法回读，algo-bit此时不等待时钟拉伸 */
+    bit_data.getscl = scl_open_drain ? soft_i2c_getscl : NULL;
+    /* 半个时钟周期(us)：100kHz为5us，400kHz取algo-bit快速模式下限2us */
+    bit_data.udelay = DIV_ROUND_UP(500, bus_khz);
+    bit_data.timeout = msecs_to_jiffies(stretch_ms);
+
+    adapter.owner = THIS_MODULE;
+    adapter.class = I2C_CLASS_HWMON;
+    adapter.algo_data = &bit_data;
+    adapter.nr = bus_nr;
+    snprintf(adapter.name, sizeof(adapter.name), "soft-i2c gpio%d/gpio%d",
+             scl_gpio, sda_gpio);
+
+    ret = bus_nr >= 0 ? i2c_bit_add_numbered_bus(&adapter) :
+                        i2c_bit_add_bus(&adapter);
+    if (ret)
+        goto free_sda;
+
+    soft_i2c_add_devices();
+
+    pr_info(DRIVER_NAME ": %s 注册为 i2c-%d, %ukHz\n",
+            adapter.name, adapter.nr, 500 / bit_data.udelay);
+    return 0;
+
+free_sda:
+    gpio_free(sda_gpio);
+free_scl:
+    gpio_free(scl_gpio);
+    return ret;
+}
+
+static void __exit soft_i2c_exit(void) {
+    while (nr_clients > 0)
+        i2c_unregister_device(clients[--nr_clients]);
+    i2c_del_adapter(&adapter);
+    gpio_free(sda_gpio);
+    gpio_free(scl_gpio);
+}
+
+module_init(soft_i2c_init);
+module_exit(soft_i2c_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Alen");
+MODULE_DESCRIPTION("GPIO模拟I2C总线(i2c-algo-bit)");
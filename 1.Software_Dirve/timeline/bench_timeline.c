@@ -0,0 +1,164 @@
+/*
+ * 时间线引擎自测与调度精度测试，不需要硬件，可在PC上运行
+ *
+ * 1. 插值和步进速度求解的正确性
+ * 2. 三条假轨道(两条采样轨道 + 一条分段轨道)跑一个3秒场景：
+ *    每个关键帧时刻都被执行且值等于关键帧值，统计调度延迟和同一时刻
+ *    执行器之间的偏差。假执行器忙等约20us，模拟一次sysfs写。
+ *    舵机关键帧不在20ms网格上，关键帧时刻额外更新一次，之后从关键帧重新按周期排。
+ *
+ * 编译：
+ *   gcc -O2 -I../motor -o bench_timeline bench_timeline.c timeline.c -lm
+ *   riscv64-buildroot-linux-gnu-gcc -O2 -I../motor -o bench_timeline bench_timeline.c timeline.c -lm
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "timeline.h"
+
+#define MAX_LOG     1024
+
+struct fake {
+    uint64_t work_ns;
+    unsigned int n;
+    struct tl_sample log[MAX_LOG];
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int fake_apply(void *ctx, const struct tl_sample *s)
+{
+    struct fake *f = ctx;
+    uint64_t end = now_ns() + f->work_ns;
+
+    if (f->n < MAX_LOG)
+        f->log[f->n++] = *s;
+    while (now_ns() < end)
+        ;
+    return 0;
+}
+
+/* 关键帧时刻在日志里出现且值正确 */
+static int keys_hit(const struct tl_track *t, const struct fake *f)
+{
+    unsigned int i, j;
+
+    for (i = 0; i < t->nkeys; i++) {
+        for (j = 0; j < f->n; j++)
+            if (f->log[j].t_ns == t->keys[i].t_ms * 1000000ULL)
+                break;
+        if (j == f->n || fabs(f->log[j].value - t->keys[i].value) > 1e-9)
+            return 0;
+    }
+    return 1;
+}
+
+static const struct tl_key fan_keys[] = {
+    { 0, 30 }, { 1000, 80 }, { 2000, 80 }, { 3000, 0 },
+};
+static const struct tl_key servo_keys[] = {
+    { 0, 0 }, { 250, 40 }, { 1000, 40 }, { 1250, -40 }, { 2750, -40 }, { 3000, 0 },
+};
+static const struct tl_key flap_keys[] = {
+    { 0, 0 }, { 1000, 1019 }, { 2000, -1019 }, { 3000, 0 },
+};
+
+int main(void)
+{
+    static struct fake fan, servo, flap;
+    struct tl_track t_fan = {
+        .name = "fan", .keys = fan_keys, .nkeys = 4, .interp = TL_LINEAR,
+        .period_ns = 10000000, .apply = fake_apply, .ctx = &fan,
+    };
+    struct tl_track t_servo = {
+        .name = "servo", .keys = servo_keys, .nkeys = 6, .interp = TL_LINEAR,
+        .period_ns = 20000000, .apply = fake_apply, .ctx = &servo,
+    };
+    struct tl_track t_flap = {
+        .name = "flap", .keys = flap_keys, .nkeys = 4, .interp = TL_LINEAR,
+        .apply = fake_apply, .ctx = &flap,
+    };
+    struct tl_track t_step = {
+        .name = "step", .keys = fan_keys, .nkeys = 4, .interp = TL_STEP,
+    };
+    struct tl_timeline tl;
+    uint32_t v;
+    double T;
+    unsigned int i;
+    int errors = 0, ok;
+
+    /* 插值 */
+    printf("线性插值: 0s %.1f 0.5s %.1f 1.5s %.1f 2.5s %.1f 9s %.1f (期望 30 55 80 40 0)\n",
+           tl_track_value(&t_fan, 0), tl_track_value(&t_fan, 500000000),
+           tl_track_value(&t_fan, 1500000000), tl_track_value(&t_fan, 2500000000ULL),
+           tl_track_value(&t_fan, 9000000000ULL));
+    if (tl_track_value(&t_fan, 0) != 30 || tl_track_value(&t_fan, 500000000) != 55 ||
+        tl_track_value(&t_fan, 1500000000) != 80 || tl_track_value(&t_fan, 2500000000ULL) != 40 ||
+        tl_track_value(&t_fan, 9000000000ULL) != 0)
+        errors++;
+    printf("阶跃保持: 0.999s %.1f 1s %.1f (期望 30 80)\n",
+           tl_track_value(&t_step, 999000000), tl_track_value(&t_step, 1000000000));
+    if (tl_track_value(&t_step, 999000000) != 30 || tl_track_value(&t_step, 1000000000) != 80)
+        errors++;
+
+    /* 步进速度：匀速，梯形 T = d/v + v/a 反算，加速度不够时无解 */
+    v = tl_stepper_speed(1000, 1000000000, 0);
+    printf("匀速 1000步/1s: %u 步/s (期望 1000)\n", v);
+    if (v != 1000)
+        errors++;
+    v = tl_stepper_speed(1500, 2000000000, 2000);
+    T = v ? 1500.0 / v + (double)v / 2000 : 0;
+    printf("梯形 1500步/2s: %u 步/s，反算到达时间 %.4fs (期望 2.0000)\n", v, T);
+    if (fabs(T - 2.0) >= 0.002)
+        errors++;
+    v = tl_stepper_speed(4000, 1000000000, 1000);
+    printf("加速度不够 4000步/1s: %u 步/s (期望 0)\n", v);
+    if (v != 0)
+        errors++;
+
+    /* 调度 */
+    fan.work_ns = servo.work_ns = 20000;
+    flap.work_ns = 5000;
+    tl_init(&tl);
+    if (tl_add_track(&tl, &t_fan) || tl_add_track(&tl, &t_servo) || tl_add_track(&tl, &t_flap)) {
+        printf("添加轨道失败\n");
+        return 1;
+    }
+    if (tl_run(&tl, NULL) != 0) {
+        printf("tl_run 失败\n");
+        errors++;
+    }
+    tl_print_stats(&tl);
+
+    /* 每个关键帧都在准确的调度时刻执行，值等于关键帧值 */
+    ok = keys_hit(&t_fan, &fan) && keys_hit(&t_servo, &servo) && keys_hit(&t_flap, &flap);
+    printf("关键帧: %s\n", ok ? "全部按时执行" : "有关键帧没有在调度时刻执行或值不对");
+    errors += !ok;
+    /* 分段轨道只在关键帧执行并给出到下一帧的时间和目标 */
+    printf("分段轨道: 执行 %u 次 (期望 4)，首次 dt %llu ns 目标 %.1f (期望 1000000000 1019)\n",
+           flap.n, (unsigned long long)flap.log[0].dt_ns, flap.log[0].target);
+    if (flap.n != 4 || flap.log[0].dt_ns != 1000000000 || flap.log[0].target != 1019 ||
+        flap.log[3].dt_ns != 0)
+        errors++;
+    /* 采样轨道按周期更新，没有丢点 */
+    ok = fan.n == 301;
+    for (i = 1; ok && i < fan.n; i++)
+        ok = fan.log[i].t_ns - fan.log[i - 1].t_ns == 10000000;
+    printf("采样轨道: 执行 %u 次 (期望 301)%s\n", fan.n, ok ? "" : "，间隔不是10ms或丢点");
+    errors += !ok;
+    if (tl.skew_max_ns >= 1000000)
+        printf("注意：执行器间最大偏差超过1ms，系统负载过高或没有实时优先级\n");
+
+    if (errors)
+        printf("\n%d 项校验不通过\n", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,354 @@
+/*
+ * 多执行器运动时间线，见 timeline.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include "motor.h"
+#include "timeline.h"
+
+#define TL_MS(ms)   ((uint64_t)(ms) * 1000000ULL)
+
+static uint64_t tl_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void tl_init(struct tl_timeline *tl)
+{
+    memset(tl, 0, sizeof(*tl));
+}
+
+int tl_add_track(struct tl_timeline *tl, struct tl_track *t)
+{
+    unsigned int i;
+
+    if (tl->ntracks >= TL_MAX_TRACKS || !t->nkeys || !t->apply)
+        return -EINVAL;
+    for (i = 1; i < t->nkeys; i++)
+        if (t->keys[i].t_ms <= t->keys[i - 1].t_ms)
+            return -EINVAL;
+    tl->tracks[tl->ntracks++] = t;
+    return 0;
+}
+
+/* 第k帧与下一帧之间 t_ns 处的值 */
+static double tl_interp(const struct tl_track *t, unsigned int k, uint64_t t_ns)
+{
+    const struct tl_key *a = &t->keys[k], *b = a + 1;
+    uint64_t ta = TL_MS(a->t_ms);
+
+    if (t->interp == TL_STEP || k + 1 >= t->nkeys || t_ns <= ta)
+        return a->value;
+    return a->value + (b->value - a->value) * (double)(t_ns - ta) / (double)(TL_MS(b->t_ms) - ta);
+}
+
+double tl_track_value(const struct tl_track *t, uint64_t t_ns)
+{
+    unsigned int k = 0;
+
+    while (k + 1 < t->nkeys && TL_MS(t->keys[k + 1].t_ms) <= t_ns)
+        k++;
+    return tl_interp(t, k, t_ns);
+}
+
+/* 执行一条轨道在调度时刻 sched 的更新并安排下一次，*done_ns 为apply返回的相对时刻 */
+static int tl_fire(struct tl_track *t, uint64_t sched, uint64_t t0, uint64_t *done_ns)
+{
+    struct tl_sample s;
+    uint64_t now, lag, next, next_key;
+    int last, ret;
+
+    while (t->k + 1 < t->nkeys && TL_MS(t->keys[t->k + 1].t_ms) <= sched)
+        t->k++;
+    last = t->k + 1 >= t->nkeys;
+    next_key = last ? sched : TL_MS(t->keys[t->k + 1].t_ms);
+
+    s.t_ns = sched;
+    s.value = tl_interp(t, t->k, sched);
+    if (last || t->interp == TL_STEP) {
+        s.target = s.value;
+        s.dt_ns = 0;
+    } else {
+        s.target = t->keys[t->k + 1].value;
+        s.dt_ns = next_key - sched;
+    }
+
+    ret = t->apply(t->ctx, &s);
+    now = tl_now() - t0;
+    lag = now > sched ? now - sched : 0;
+    t->updates++;
+    t->lag_sum_ns += lag;
+    if (lag > t->lag_max_ns)
+        t->lag_max_ns = lag;
+    if (ret < 0)
+        t->errors++;
+    *done_ns = now;
+
+    if (last) {
+        t->done = 1;
+    } else if (!t->period_ns) {
+        t->next_ns = next_key;
+    } else {
+        /* 落后超过一个周期时不补发已经过去的插值点，但关键帧一定执行 */
+        next = sched + t->period_ns;
+        if (next < now) {
+            t->skipped += (now - next) / t->period_ns + 1;
+            next += ((now - next) / t->period_ns + 1) * t->period_ns;
+        }
+        t->next_ns = next < next_key ? next : next_key;
+    }
+    return ret;
+}
+
+int tl_run(struct tl_timeline *tl, volatile sig_atomic_t *stop)
+{
+    uint64_t t0, next, abs_ns, done, first, last;
+    struct tl_track *t;
+    struct timespec ts;
+    unsigned int i, n;
+    int errors = 0;
+
+    tl->skew_max_ns = 0;
+    tl->skew_sum_ns = 0;
+    tl->skew_count = 0;
+    for (i = 0; i < tl->ntracks; i++) {
+        t = tl->tracks[i];
+        t->k = 0;
+        t->next_ns = TL_MS(t->keys[0].t_ms);
+        t->done = 0;
+        t->updates = t->errors = t->skipped = 0;
+        t->lag_sum_ns = t->lag_max_ns = 0;
+    }
+
+    t0 = tl_now() + TL_START_DELAY_NS;
+    while (!stop || !*stop) {
+        next = UINT64_MAX;
+        for (i = 0; i < tl->ntracks; i++) {
+            t = tl->tracks[i];
+            if (!t->done && t->next_ns < next)
+                next = t->next_ns;
+        }
+        if (next == UINT64_MAX)
+            break;
+
+        /* 绝对时刻睡眠，被信号打断就回去检查stop */
+        abs_ns = t0 + next;
+        ts.tv_sec = abs_ns / 1000000000ULL;
+        ts.tv_nsec = abs_ns % 1000000000ULL;
+        if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+            continue;
+
+        n = 0;
+        first = UINT64_MAX;
+        last = 0;
+        for (i = 0; i < tl->ntracks; i++) {
+            t = tl->tracks[i];
+            if (t->done || t->next_ns != next)
+                continue;
+            if (tl_fire(t, next, t0, &done) < 0)
+                errors++;
+            if (done < first)
+                first = done;
+            if (done > last)
+                last = done;
+            n++;
+        }
+        if (n > 1) {
+            tl->skew_sum_ns += last - first;
+            if (last - first > tl->skew_max_ns)
+                tl->skew_max_ns = last - first;
+            tl->skew_count++;
+        }
+    }
+    return errors;
+}
+
+void tl_print_stats(const struct tl_timeline *tl)
+{
+    const struct tl_track *t;
+    unsigned int i;
+
+    for (i = 0; i < tl->ntracks; i++) {
+        t = tl->tracks[i];
+        printf("%-8s 更新 %5u 次, 延迟 平均 %6.1fus 最大 %7.1fus, 跳过 %u, 出错 %u\n",
+               t->name, t->updates, t->updates ? t->lag_sum_ns / 1e3 / t->updates : 0.0,
+               t->lag_max_ns / 1e3, t->skipped, t->errors);
+    }
+    if (tl->skew_count)
+        printf("同时刻执行器间偏差 平均 %.1fus 最大 %.1fus (%u 个时刻)\n",
+               tl->skew_sum_ns / 1e3 / tl->skew_count, tl->skew_max_ns / 1e3, tl->skew_count);
+}
+
+static int tl_sysfs_write(const char *dir, const char *attr, const char *val)
+{
+    char path[256];
+    int fd, ret = 0;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, attr);
+    fd = open(path, O_WRONLY);
+    if (fd < 0)
+        return -errno;
+    if (write(fd, val, strlen(val)) < 0)
+        ret = -errno;
+    close(fd);
+    return ret;
+}
+
+int tl_pwm_open(struct tl_pwm *p, const char *path, uint32_t period_ns, uint32_t duty_ns)
+{
+    char chip[256], buf[32];
+    const char *name = strrchr(path, '/');
+    int ret;
+
+    /* 通道没导出时写 pwmchipN/export，通道号取路径最后的 pwmM */
+    if (access(path, F_OK) && name && !strncmp(name, "/pwm", 4)) {
+        snprintf(chip, sizeof(chip), "%.*s", (int)(name - path), path);
+        tl_sysfs_write(chip, "export", name + 4);
+    }
+
+    tl_sysfs_write(path, "enable", "0");
+    /* 旧占空比可能大于新周期，先清零 */
+    tl_sysfs_write(path, "duty_cycle", "0");
+    snprintf(buf, sizeof(buf), "%u", period_ns);
+    if ((ret = tl_sysfs_write(path, "period", buf)) < 0)
+        return ret;
+    snprintf(buf, sizeof(buf), "%u", duty_ns);
+    if ((ret = tl_sysfs_write(path, "duty_cycle", buf)) < 0)
+        return ret;
+    tl_sysfs_write(path, "polarity", "normal");
+    if ((ret = tl_sysfs_write(path, "enable", "1")) < 0)
+        return ret;
+
+    snprintf(chip, sizeof(chip), "%s/duty_cycle", path);
+    p->duty_fd = open(chip, O_WRONLY);
+    if (p->duty_fd < 0)
+        return -errno;
+    p->period_ns = period_ns;
+    p->duty_ns = duty_ns;
+    return 0;
+}
+
+int tl_pwm_set_duty(struct tl_pwm *p, uint32_t duty_ns)
+{
+    char buf[16];
+    int n;
+
+    if (duty_ns > p->period_ns)
+        duty_ns = p->period_ns;
+    if (duty_ns == p->duty_ns)
+        return 0;
+    n = snprintf(buf, sizeof(buf), "%u", duty_ns);
+    if (pwrite(p->duty_fd, buf, n, 0) < 0)
+        return -errno;
+    p->duty_ns = duty_ns;
+    return 0;
+}
+
+void tl_pwm_close(struct tl_pwm *p)
+{
+    if (p->duty_fd >= 0)
+        close(p->duty_fd);
+    p->duty_fd = -1;
+}
+
+int tl_fan_apply(void *ctx, const struct tl_sample *s)
+{
+    struct tl_pwm *p = ctx;
+    double pct = s->value < 0 ? 0 : s->value > 100 ? 100 : s->value;
+
+    return tl_pwm_set_duty(p, (uint32_t)(pct * p->period_ns / 100 + 0.5));
+}
+
+int tl_servo360_apply(void *ctx, const struct tl_sample *s)
+{
+    double v = s->value < -100 ? -100 : s->value > 100 ? 100 : s->value;
+    double span = v >= 0 ? TL_SERVO_MAX_NS - TL_SERVO_MID_NS : TL_SERVO_MID_NS - TL_SERVO_MIN_NS;
+
+    return tl_pwm_set_duty(ctx, (uint32_t)lround(TL_SERVO_MID_NS + v * span / 100));
+}
+
+uint32_t tl_stepper_speed(uint32_t steps, uint64_t dt_ns, uint32_t accel)
+{
+    double T = dt_ns / 1e9, a = accel, disc, v;
+
+    if (!dt_ns)
+        return 0;
+    if (!accel) {
+        v = steps / T;
+    } else {
+        disc = a * a * T * T - 4 * a * steps;
+        if (disc < 0)
+            return 0;
+        v = (a * T - sqrt(disc)) / 2;
+    }
+    if (v >= UINT32_MAX)
+        return UINT32_MAX;
+    return v < 1 ? 1 : (uint32_t)ceil(v);
+}
+
+int tl_stepper_open(struct tl_stepper *s, const char *dev, uint32_t max_speed, uint32_t accel)
+{
+    struct step_motor_status st;
+
+    s->fd = open(dev, O_RDWR);
+    if (s->fd < 0)
+        return -errno;
+    if (ioctl(s->fd, CMD_STEPMOTOR_STATUS, &st) < 0) {
+        close(s->fd);
+        s->fd = -1;
+        return -errno;
+    }
+    s->position = st.position;
+    s->max_speed = max_speed > STEP_MOTOR_MAX_SPEED ? STEP_MOTOR_MAX_SPEED : max_speed;
+    s->accel = accel;
+    s->late = 0;
+    return 0;
+}
+
+void tl_stepper_close(struct tl_stepper *s)
+{
+    if (s->fd >= 0)
+        close(s->fd);
+    s->fd = -1;
+}
+
+int tl_stepper_apply(void *ctx, const struct tl_sample *smp)
+{
+    struct tl_stepper *s = ctx;
+    struct step_motor_move m;
+    int32_t goal;
+    uint32_t v;
+
+    /* 线性：在到下一帧的时间内走到下一帧的位置；阶跃：按限速走到本帧位置 */
+    goal = (int32_t)lround(smp->dt_ns ? smp->target : smp->value);
+    if (goal == s->position)
+        return 0;
+
+    memset(&m, 0, sizeof(m));
+    m.steps = goal > s->position ? goal - s->position : s->position - goal;
+    m.direction = goal > s->position;
+    m.max_speed = s->max_speed;
+    m.accel = s->accel;
+    if (smp->dt_ns) {
+        v = tl_stepper_speed(m.steps, smp->dt_ns, s->accel);
+        if (!v || v > s->max_speed)
+            s->late++;
+        else
+            m.max_speed = v;
+    }
+    if (ioctl(s->fd, CMD_STEPMOTOR_MOVE, &m) < 0)
+        return -errno;
+    s->position = goal;
+    return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * 多执行器运动时间线(用户态)
+ *
+ * 步进电机(/dev/step_motor)、360度舵机(pwm1)、风扇(pwm0)等执行器各是一条
+ * 轨道，轨道上是 (时刻, 值) 关键帧。一个线程在同一个 CLOCK_MONOTONIC 时钟上
+ * 按绝对时刻睡眠，到点把所有同一时刻的轨道连续执行完，不再是每个执行器
+ * 一个进程各自 sleep，多个执行器之间的偏差只剩几次系统调用的时间。
+ *
+ * 两种轨道：
+ *   采样轨道(period_ns > 0)：舵机、风扇这类只能设定当前值的执行器。
+ *     关键帧之间按 period_ns 插值更新，关键帧时刻一定会更新一次。
+ *   分段轨道(period_ns = 0)：步进电机这类自己按时序走完一段的执行器。
+ *     只在关键帧时刻调用一次，同时给出下一帧的值和间隔，由执行器自己
+ *     在这段时间内走到(TL_LINEAR)；TL_STEP 表示尽快走到本帧的值。
+ *
+ * 调度时刻是相对 tl_run 开始的理想时刻，从不在实际执行时刻上累加，
+ * 某一次执行晚了不会把后面的关键帧一起推后。
+ */
+#ifndef __TIMELINE_H
+#define __TIMELINE_H
+
+#include <stdint.h>
+#include <signal.h>
+
+#define TL_MAX_TRACKS       8
+/* tl_run 开始后先留出的准备时间，第一批关键帧在同一时刻执行 */
+#define TL_START_DELAY_NS   10000000ULL
+
+enum tl_interp {
+    TL_STEP,                /* 保持上一帧的值 */
+    TL_LINEAR,              /* 相邻两帧之间线性插值 */
+};
+
+struct tl_key {
+    uint32_t t_ms;          /* 相对场景开始的时刻，严格递增 */
+    double value;
+};
+
+/* 交给执行器的一次更新 */
+struct tl_sample {
+    uint64_t t_ns;          /* 调度时刻，相对场景开始 */
+    double value;           /* 本时刻的值(采样轨道为插值后的值) */
+    double target;          /* 下一帧的值；TL_STEP 轨道和最后一帧时等于value */
+    uint64_t dt_ns;         /* 到下一帧的间隔；TL_STEP 轨道和最后一帧时为0 */
+};
+
+struct tl_track {
+    const char *name;
+    const struct tl_key *keys;
+    unsigned int nkeys;
+    enum tl_interp interp;
+    uint64_t period_ns;     /* 采样轨道的更新周期，0为分段轨道 */
+    int (*apply)(void *ctx, const struct tl_sample *s);
+    void *ctx;
+
+    /* 运行状态和统计，tl_run 开始时清零 */
+    unsigned int k;         /* 最后一个不晚于当前调度时刻的关键帧 */
+    uint64_t next_ns;
+    int done;
+    unsigned int updates;
+    unsigned int errors;    /* apply 返回负值的次数 */
+    unsigned int skipped;   /* 落后太多而跳过的插值点 */
+    uint64_t lag_sum_ns;    /* apply 返回时刻相对调度时刻 */
+    uint64_t lag_max_ns;
+};
+
+struct tl_timeline {
+    struct tl_track *tracks[TL_MAX_TRACKS];
+    unsigned int ntracks;
+    /* 同一调度时刻有多条轨道时，最晚与最早完成的apply之差 */
+    uint64_t skew_max_ns;
+    uint64_t skew_sum_ns;
+    unsigned int skew_count;
+};
+
+void tl_init(struct tl_timeline *tl);
+int tl_add_track(struct tl_timeline *tl, struct tl_track *t);
+/* 轨道在相对时刻 t_ns 的值，第一帧之前为第一帧的值 */
+double tl_track_value(const struct tl_track *t, uint64_t t_ns);
+/* 执行到所有轨道的最后一帧，*stop 非0时提前返回；返回出错的apply次数 */
+int tl_run(struct tl_timeline *tl, volatile sig_atomic_t *stop);
+void tl_print_stats(const struct tl_timeline *tl);
+
+/* sysfs PWM 通道，duty_cycle 保持打开，每次更新只有一次pwrite */
+struct tl_pwm {
+    int duty_fd;
+    uint32_t period_ns;
+    uint32_t duty_ns;       /* 上次写入的值，相同时不再写 */
+};
+
+/* path 如 /sys/class/pwm/pwmchip0/pwm0，没导出时自动导出，设置周期和初始占空比后使能 */
+int tl_pwm_open(struct tl_pwm *p, const char *path, uint32_t period_ns, uint32_t duty_ns);
+int tl_pwm_set_duty(struct tl_pwm *p, uint32_t duty_ns);
+void tl_pwm_close(struct tl_pwm *p);
+
+/* 风扇：值为转速百分比 0~100，ctx 为 struct tl_pwm */
+int tl_fan_apply(void *ctx, const struct tl_sample *s);
+
+/* 360度舵机：值为 -100~100，正为顺时针，0停止；20ms周期，0.5~2.5ms脉宽 */
+#define TL_SERVO_PERIOD_NS  20000000
+#define TL_SERVO_MID_NS     1500000
+#define TL_SERVO_MIN_NS     500000
+#define TL_SERVO_MAX_NS     2500000
+int tl_servo360_apply(void *ctx, const struct tl_sample *s);
+
+/*
+ * 步进电机：值为绝对位置(半步)。每个关键帧发一次 CMD_STEPMOTOR_MOVE，
+ * 驱动里排队由hrtimer执行，上一段没走完时新段接在后面，不会丢步。
+ */
+struct tl_stepper {
+    int fd;
+    int32_t position;       /* 已下发的目标位置 */
+    uint32_t max_speed;     /* 半步/秒，TL_STEP 用它，也是 TL_LINEAR 的上限 */
+    uint32_t accel;         /* 半步/秒^2，0为匀速 */
+    unsigned int late;      /* 按限速/加速度赶不上下一帧的段数 */
+};
+
+/* 打开设备并读取驱动里的当前位置作为起点 */
+int tl_stepper_open(struct tl_stepper *s, const char *dev, uint32_t max_speed, uint32_t accel);
+void tl_stepper_close(struct tl_stepper *s);
+int tl_stepper_apply(void *ctx, const struct tl_sample *s);
+/*
+ * steps 步在 dt_ns 内走完需要的最高速度：匀速为 steps/T；梯形曲线
+ * T = steps/v + v/a，取较小的根 v = (aT - sqrt(a^2T^2 - 4a*steps))/2。
+ * 无解(加速度不够)返回0
+ */
+uint32_t tl_stepper_speed(uint32_t steps, uint64_t dt_ns, uint32_t accel);
+
+#endif /* __TIMELINE_H */
@@ -0,0 +1,126 @@
+/*
+ * 出风口扫风场景：风门步进电机、360度舵机、风扇在同一条时间线上联动
+ *
+ * 0~2s   风门转到 +90度，舵机顺时针加速，风扇从30%升到80%
+ * 2~3s   停在 +90度，舵机减速停止
+ * 3~7s   风门扫到 -90度，舵机逆时针
+ * 7~8s   停在 -90度，舵机减速停止
+ * 8~10s  风门回到中间，风扇降回30%
+ *
+ * 用法：vent_sweep [循环次数]，默认1次，0为一直循环，Ctrl+C 停止
+ *   风门位置是驱动里的绝对位置，启动前风门应在中间并已 SET_POSITION 为0。
+ *   能拿到实时优先级时用 SCHED_FIFO 运行，结束打印每个执行器的调度延迟
+ *   和同一时刻执行器之间的偏差。
+ *
+ * 编译：
+ *   riscv64-buildroot-linux-gnu-gcc -O2 -I../motor -o vent_sweep vent_sweep.c timeline.c -lm
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "motor.h"
+#include "timeline.h"
+
+#define STEP_MOTOR_DEV  "/dev/step_motor"
+#define FAN_PWM         "/sys/class/pwm/pwmchip0/pwm0"
+#define SERVO_PWM       "/sys/class/pwm/pwmchip0/pwm1"
+#define FAN_PERIOD_NS   2000000     /* 500Hz，与 control_fan_pwm0.sh 相同 */
+
+/* 28BYJ-48 输出轴一圈约4076半步，90度约1019 */
+static const struct tl_key flap_keys[] = {
+    { 0, 0 }, { 2000, 1019 }, { 3000, 1019 }, { 7000, -1019 }, { 8000, -1019 }, { 10000, 0 },
+};
+static const struct tl_key servo_keys[] = {
+    { 0, 0 }, { 500, 40 }, { 2000, 40 }, { 2500, 0 }, { 3000, 0 }, { 3500, -40 },
+    { 7000, -40 }, { 7500, 0 }, { 10000, 0 },
+};
+static const struct tl_key fan_keys[] = {
+    { 0, 30 }, { 2000, 80 }, { 8000, 80 }, { 10000, 30 },
+};
+
+#define NKEYS(k)    (sizeof(k) / sizeof((k)[0]))
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 1;
+    struct tl_stepper flap;
+    struct tl_pwm fan, servo;
+    struct tl_track t_flap = {
+        .name = "flap", .keys = flap_keys, .nkeys = NKEYS(flap_keys),
+        .interp = TL_LINEAR, .apply = tl_stepper_apply, .ctx = &flap,
+    };
+    /* 舵机PWM周期20ms，更新再快也没有意义 */
+    struct tl_track t_servo = {
+        .name = "servo", .keys = servo_keys, .nkeys = NKEYS(servo_keys),
+        .interp = TL_LINEAR, .period_ns = TL_SERVO_PERIOD_NS,
+        .apply = tl_servo360_apply, .ctx = &servo,
+    };
+    struct tl_track t_fan = {
+        .name = "fan", .keys = fan_keys, .nkeys = NKEYS(fan_keys),
+        .interp = TL_LINEAR, .period_ns = 20000000,
+        .apply = tl_fan_apply, .ctx = &fan,
+    };
+    struct sched_param sp = { .sched_priority = 50 };
+    struct tl_timeline tl;
+    int i, ret;
+
+    if ((ret = tl_stepper_open(&flap, STEP_MOTOR_DEV, 1500, 2000)) < 0) {
+        fprintf(stderr, "打开 %s 失败: %s\n", STEP_MOTOR_DEV, strerror(-ret));
+        return 1;
+    }
+    if ((ret = tl_pwm_open(&fan, FAN_PWM, FAN_PERIOD_NS, 0)) < 0) {
+        fprintf(stderr, "初始化风扇PWM失败: %s\n", strerror(-ret));
+        return 1;
+    }
+    if ((ret = tl_pwm_open(&servo, SERVO_PWM, TL_SERVO_PERIOD_NS, TL_SERVO_MID_NS)) < 0) {
+        fprintf(stderr, "初始化舵机PWM失败: %s\n", strerror(-ret));
+        return 1;
+    }
+    printf("风门起始位置 %d\n", flap.position);
+
+    tl_init(&tl);
+    tl_add_track(&tl, &t_flap);
+    tl_add_track(&tl, &t_servo);
+    tl_add_track(&tl, &t_fan);
+
+    /* 实时优先级和锁内存都是尽力而为，拿不到只是抖动大一些 */
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0 || sched_setscheduler(0, SCHED_FIFO, &sp) < 0)
+        printf("没有实时优先级，按普通进程运行\n");
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    for (i = 0; !stop && (loops == 0 || i < loops); i++) {
+        ret = tl_run(&tl, &stop);
+        printf("第 %d 轮%s\n", i + 1, stop ? "(中断)" : "");
+        tl_print_stats(&tl);
+        if (ret)
+            printf("执行器出错 %d 次\n", ret);
+        if (flap.late)
+            printf("风门有 %u 段按限速赶不上关键帧\n", flap.late);
+    }
+
+    /* 中断时风门减速停下并清掉排队的段，正常结束等最后一段走完 */
+    if (stop)
+        ioctl(flap.fd, CMD_STEPMOTOR_STOP, STEP_MOTOR_STOP_DECEL);
+    ioctl(flap.fd, CMD_STEPMOTOR_WAIT);
+    tl_pwm_set_duty(&servo, TL_SERVO_MID_NS);
+    tl_pwm_set_duty(&fan, 0);
+
+    tl_stepper_close(&flap);
+    tl_pwm_close(&servo);
+    tl_pwm_close(&fan);
+    return 0;
+}
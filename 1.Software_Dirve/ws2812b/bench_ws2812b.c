@@ -0,0 +1,171 @@
+/*
+ * WS2812B 编码测试：各编码的时序检查、编码正确性、帧长和编码耗时
+ *
+ * 不需要硬件，可在PC上运行：
+ *   1. 按数据手册 ±150ns 检查各编码在标称时钟下的时序，并扫描出时序合格的SPI时钟范围
+ *   2. 把发送缓冲按高电平宽度解码回颜色，与帧缓冲比较；8位编码再与旧的逐位编码比较
+ *   3. 每种编码的帧字节数、线上传输时间、帧率上限、默认spidev缓冲能带的LED数
+ *   4. 整帧重新编码的耗时
+ *
+ * 编译：
+ *   gcc -O2 -o bench_ws2812b bench_ws2812b.c ws2812b.c -lm
+ *   riscv64-buildroot-linux-gnu-gcc -O2 -o bench_ws2812b bench_ws2812b.c ws2812b.c -lm
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include "ws2812b.h"
+
+#define LEDS            300
+#define ROUNDS          2000
+#define SPIDEV_BUFSIZ   4096
+
+// 原来 main.c 里的逐位编码，作为对照
+static void rgb_to_spi(uint8_t r, uint8_t g, uint8_t b, uint8_t *spi_buf) {
+    uint8_t grb[3] = {g, r, b};
+    for (int i = 0; i < 24; i++) {
+        uint8_t bit = (grb[i / 8] >> (7 - (i % 8))) & 0x01;
+        spi_buf[i] = bit ? 0x7C : 0x60;
+    }
+}
+
+// 按每位的高电平宽度把发送缓冲解码回GRB
+static int decode_matches(const struct ws2812b *s) {
+    const struct ws2812b_enc_info *e = ws2812b_enc_info(s->enc);
+    int h0 = __builtin_popcount(e->zero), h1 = __builtin_popcount(e->one);
+    size_t pos = s->reset_bytes * 8;
+    uint8_t v;
+
+    for (unsigned int i = 0; i < s->count * 3; i++) {
+        v = 0;
+        for (int b = 0; b < 8; b++) {
+            int high = 0;
+            for (unsigned int k = 0; k < e->bits; k++, pos++)
+                high += (s->tx[pos / 8] >> (7 - pos % 8)) & 1;
+            if (high != h0 && high != h1)
+                return 0;
+            v = v << 1 | (high == h1);
+        }
+        if (v != s->grb[i])
+            return 0;
+    }
+    return 1;
+}
+
+static void fill_random(struct ws2812b *s) {
+    for (unsigned int i = 0; i < s->count; i++)
+        ws2812b_set(s, i, rand(), rand(), rand());
+}
+
+int main(void) {
+    struct ws2812b s;
+    struct ws2812b_timing t;
+    uint8_t ref[24];
+    struct timespec t0, t1;
+    double wire_us;
+    uint32_t lo, hi, hz;
+    int errors = 0, ok, ret;
+
+    printf("数据手册: T0H %d T1H %d T0L %d T1L %d ±%dns\n\n", WS2812B_T0H_NS, WS2812B_T1H_NS,
+           WS2812B_T0L_NS, WS2812B_T1L_NS, WS2812B_TOL_NS);
+    for (int enc = 0; enc < WS2812B_ENC_COUNT; enc++) {
+        const struct ws2812b_enc_info *e = ws2812b_enc_info(enc);
+
+        ok = ws2812b_check_timing(enc, 0, &t) == 0;
+        // 3位/4位编码在标称时钟下必须合格，8位编码只做参考
+        if (!ok && enc != WS2812B_ENC_8BIT)
+            errors++;
+        printf("%s @%.1fMHz: T0H %u T1H %u T0L %u~%u T1L %u~%u 位周期 %uns, 余量 %dns%s\n",
+               e->name, e->speed_hz / 1e6, t.t0h_ns, t.t1h_ns, t.t0l_min_ns, t.t0l_max_ns,
+               t.t1l_min_ns, t.t1l_max_ns, t.bit_ns, t.margin_ns, ok ? "" : " (超出容差)");
+        lo = hi = 0;
+        for (hz = 1000000; hz <= 10000000; hz += 10000) {
+            if (ws2812b_check_timing(enc, hz, &t) == 0) {
+                if (!lo)
+                    lo = hz;
+                hi = hz;
+            }
+        }
+        if (lo)
+            printf("        时序合格的SPI时钟 %.2f ~ %.2fMHz\n", lo / 1e6, hi / 1e6);
+        else
+            printf("        1~10MHz 内没有时序合格的SPI时钟\n");
+    }
+    ret = ws2812b_open_enc(&s, NULL, LEDS, WS2812B_ENC_3BIT, 4000000);
+    printf("3bit @4MHz 打开返回 %d (期望 %d)\n\n", ret, -ERANGE);
+    if (ret != -ERANGE)
+        errors++;
+
+    srand(1);
+    for (int enc = 0; enc < WS2812B_ENC_COUNT; enc++) {
+        const struct ws2812b_enc_info *e = ws2812b_enc_info(enc);
+
+        if (enc == WS2812B_ENC_8BIT)
+            ok = ws2812b_open(&s, NULL, LEDS) == 0;
+        else
+            ok = ws2812b_open_enc(&s, NULL, LEDS, enc, 0) == 0;
+        if (!ok) {
+            printf("%s 打开失败\n", e->name);
+            errors++;
+            continue;
+        }
+        fill_random(&s);
+        ws2812b_commit(&s);
+        // 再改一部分像素，检查只编码改动区间时其余数据没被破坏
+        for (int i = 0; i < 50; i++)
+            ws2812b_set(&s, rand() % LEDS, rand(), rand(), rand());
+        ws2812b_commit(&s);
+        if (!decode_matches(&s)) {
+            printf("%s 发送缓冲解码回的颜色与帧缓冲不一致\n", e->name);
+            errors++;
+        }
+        if (enc == WS2812B_ENC_8BIT) {
+            ok = 1;
+            for (unsigned int i = 0; ok && i < s.count; i++) {
+                rgb_to_spi(s.grb[i * 3 + 1], s.grb[i * 3], s.grb[i * 3 + 2], ref);
+                ok = !memcmp(ref, s.tx + s.reset_bytes + i * 24, 24);
+            }
+            if (!ok) {
+                printf("8bit 与旧的逐位编码结果不同\n");
+                errors++;
+            }
+        }
+
+        // 整帧重新编码：两种颜色交替，每次都是全部像素改动
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int r = 0; r < ROUNDS; r++) {
+            ws2812b_fill(&s, r & 1 ? 0x12 : 0xED, r & 1 ? 0x34 : 0xCB, r & 1 ? 0x56 : 0xA9);
+            ws2812b_commit(&s);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        wire_us = s.tx_len * 8.0 / s.speed_hz * 1e6;
+        printf("%s: %d LED 帧 %zu 字节(复位 %zu x2)，线上 %.2fms，帧率上限 %.0ffps，"
+               "默认spidev缓冲可带 %zu LED，整帧设置+编码 %.1fus\n",
+               e->name, LEDS, s.tx_len, s.reset_bytes, wire_us / 1000, 1e6 / wire_us,
+               (SPIDEV_BUFSIZ - 2 * s.reset_bytes) / s.bytes_per_led,
+               ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / ROUNDS / 1000);
+        ws2812b_close(&s);
+    }
+
+    // 对照：旧的逐位编码整帧
+    {
+        static uint8_t buf[LEDS * 24];
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int r = 0; r < ROUNDS; r++) {
+            for (int i = 0; i < LEDS; i++)
+                rgb_to_spi(r, i, r ^ i, buf + i * 24);
+            __asm__ volatile("" : : "r"(buf) : "memory");
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        printf("旧逐位编码: %d LED 整帧编码 %.1fus\n", LEDS,
+               ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / ROUNDS / 1000);
+    }
+
+    if (errors)
+        printf("\n%d 项校验不通过\n", errors);
+    return errors ? 1 : 0;
+}
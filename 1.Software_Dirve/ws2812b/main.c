@@ -4,76 +4,24 @@
 #include <fcntl.h>
 #include <string.h>
 #include <stdint.h>
-#include <sys/ioctl.h>
-#include <linux/spi/spidev.h>
+
+#include "ws2812b.h"
 
 #define SPI_DEVICE    "/dev/spidev1.0"
 #define LED_COUNT     10       // 总共10个LED灯珠
-#define SPI_SPEED_HZ  8000000  // 8 MHz
-#define SPI_BITS      8
-#define SPI_MODE      SPI_MODE_0
-#define RESET_DELAY   64       // Reset信号长度
-
-// WS2812B协议参数
-#define T0H  0x60  // '0' bit: 01100000
-#define T1H  0x7C  // '1' bit: 01111100
-
-int spi_fd;
-
-// 将RGB转换为WS2812B的SPI数据格式
-void rgb_to_spi(uint8_t r, uint8_t g, uint8_t b, uint8_t *spi_buf) {
-    uint8_t grb[3] = {g, r, b};  // WS2812B使用GRB顺序
-    for (int i = 0; i < 24; i++) {
-        uint8_t bit = (grb[i / 8] >> (7 - (i % 8))) & 0x01;
-        spi_buf[i] = bit ? T1H : T0H;
-    }
-}
-
-// 初始化SPI
-int init_spi() {
-    uint8_t mode = SPI_MODE;
-    uint8_t bits = SPI_BITS;  // 将宏定义赋值给变量
-    uint32_t speed = SPI_SPEED_HZ;
 
-    if ((spi_fd = open(SPI_DEVICE, O_RDWR)) < 0) {
-        perror("Failed to open SPI device");
-        return -1;
-    }
-
-    if (ioctl(spi_fd, SPI_IOC_WR_MODE, &mode) < 0 ||
-        ioctl(spi_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||  // 使用变量地址
-        ioctl(spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
-        perror("Failed to set SPI parameters");
-        close(spi_fd);
-        return -1;
-    }
+static struct ws2812b strip;
 
-    return 0;
-}
-
-// 控制单个LED
+// 控制单个LED，立即发送
 void set_led(int led_pos, uint8_t r, uint8_t g, uint8_t b) {
-    static uint8_t led_data[LED_COUNT][24] = {0};
-    uint8_t output_buf[RESET_DELAY + (LED_COUNT * 24) + RESET_DELAY];
-    uint8_t reset_buf[RESET_DELAY] = {0};
-
-    if (led_pos >= 0 && led_pos < LED_COUNT) {
-        rgb_to_spi(r, g, b, led_data[led_pos]);
-    }
-
-    memset(output_buf, 0x00, sizeof(output_buf));
-    memcpy(output_buf + RESET_DELAY, led_data, sizeof(led_data));
-    
-    write(spi_fd, reset_buf, sizeof(reset_buf));
-    write(spi_fd, output_buf, sizeof(output_buf));
-    write(spi_fd, reset_buf, sizeof(reset_buf));
+    ws2812b_set(&strip, led_pos, r, g, b);
+    ws2812b_commit(&strip);
 }
 
-// 清除所有LED
+// 清除所有LED，只发送一帧
 void clear_all() {
-    for (int i = 0; i < LED_COUNT; i++) {
-        set_led(i, 0x00, 0x00, 0x00);
-    }
+    ws2812b_clear(&strip);
+    ws2812b_commit(&strip);
 }
 // 渐变红绿蓝效果
 void gradient_rgb_effect() {
@@ -86,9 +34,8 @@ void gradient_rgb_effect() {
         for (uint8_t s = 0; s < steps; s++) {
             uint8_t r = 255 * (steps - s) / steps;
             uint8_t g = 255 * s / steps;
-            for (int i = 0; i < LED_COUNT; i++) {
-                set_led(i, r, g, 0);
-            }
+            ws2812b_fill(&strip, r, g, 0);
+            ws2812b_commit(&strip);
             usleep(delay_ms * 1000);
         }
         
@@ -96,9 +43,8 @@ void gradient_rgb_effect() {
         for (uint8_t s = 0; s < steps; s++) {
             uint8_t g = 255 * (steps - s) / steps;
             uint8_t b = 255 * s / steps;
-            for (int i = 0; i < LED_COUNT; i++) {
-                set_led(i, 0, g, b);
-            }
+            ws2812b_fill(&strip, 0, g, b);
+            ws2812b_commit(&strip);
             usleep(delay_ms * 1000);
         }
         
@@ -106,16 +52,28 @@ void gradient_rgb_effect() {
         for (uint8_t s = 0; s < steps; s++) {
             uint8_t b = 255 * (steps - s) / steps;
             uint8_t r = 255 * s / steps;
-            for (int i = 0; i < LED_COUNT; i++) {
-                set_led(i, r, 0, b);
-            }
+            ws2812b_fill(&strip, r, 0, b);
+            ws2812b_commit(&strip);
             usleep(delay_ms * 1000);
         }
     }
 }
 
-int main() {
-    if (init_spi() < 0) return 1;
+// 用法: ws2812b_demo [8|4|3]，选择每个WS2812B位用几个SPI位编码，默认8
+int main(int argc, char *argv[]) {
+    int bits = argc > 1 ? atoi(argv[1]) : 8;
+    int ret;
+
+    if (bits == 3)
+        ret = ws2812b_open_enc(&strip, SPI_DEVICE, LED_COUNT, WS2812B_ENC_3BIT, 0);
+    else if (bits == 4)
+        ret = ws2812b_open_enc(&strip, SPI_DEVICE, LED_COUNT, WS2812B_ENC_4BIT, 0);
+    else
+        ret = ws2812b_open(&strip, SPI_DEVICE, LED_COUNT);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to open SPI device: %s\n", strerror(-ret));
+        return 1;
+    }
 
     clear_all();
 
@@ -127,6 +85,6 @@ int main() {
     sleep(1);
 
     clear_all();
-    close(spi_fd);
+    ws2812b_close(&strip);
     return 0;
 }
\ No newline at end of file
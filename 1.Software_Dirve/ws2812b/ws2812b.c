@@ -0,0 +1,271 @@
+/*
+ * WS2812B 灯带帧缓冲，见 ws2812b.h
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+
+#include "ws2812b.h"
+
+static const struct ws2812b_enc_info ws2812b_encs[WS2812B_ENC_COUNT] = {
+    // '0' bit: 01100000，'1' bit: 01111100
+    [WS2812B_ENC_8BIT] = { "8bit", 8, 0x60, 0x7C, 8000000 },
+    [WS2812B_ENC_4BIT] = { "4bit", 4, 0x8, 0xE, 3200000 },
+    [WS2812B_ENC_3BIT] = { "3bit", 3, 0x4, 0x6, 2400000 },
+};
+
+// 颜色字节 -> bits个SPI字节，高位先发
+static uint8_t ws2812b_lut[WS2812B_ENC_COUNT][256][8];
+
+const struct ws2812b_enc_info *ws2812b_enc_info(enum ws2812b_encoding enc) {
+    return enc < WS2812B_ENC_COUNT ? &ws2812b_encs[enc] : NULL;
+}
+
+static void ws2812b_lut_init(enum ws2812b_encoding enc) {
+    static int done[WS2812B_ENC_COUNT];
+    const struct ws2812b_enc_info *e = &ws2812b_encs[enc];
+    uint64_t acc;
+
+    if (done[enc])
+        return;
+    for (int v = 0; v < 256; v++) {
+        acc = 0;
+        for (int i = 7; i >= 0; i--)
+            acc = acc << e->bits | ((v >> i) & 1 ? e->one : e->zero);
+        for (unsigned int j = 0; j < e->bits; j++)
+            ws2812b_lut[enc][v][j] = acc >> (8 * (e->bits - 1 - j));
+    }
+    done[enc] = 1;
+}
+
+// 码型拆成 开头低电平位数、高电平位数、结尾低电平位数，高电平必须连续
+static int ws2812b_pattern(uint8_t p, unsigned int bits, unsigned int *lead,
+                           unsigned int *high, unsigned int *tail) {
+    unsigned int i = bits;
+
+    *lead = *high = *tail = 0;
+    while (i && !((p >> (i - 1)) & 1)) {
+        (*lead)++;
+        i--;
+    }
+    while (i && ((p >> (i - 1)) & 1)) {
+        (*high)++;
+        i--;
+    }
+    while (i && !((p >> (i - 1)) & 1)) {
+        (*tail)++;
+        i--;
+    }
+    return i || !*high ? -EINVAL : 0;
+}
+
+static int32_t ws2812b_margin(double ns, int nominal) {
+    return WS2812B_TOL_NS - (int32_t)lround(fabs(ns - nominal));
+}
+
+int ws2812b_check_timing(enum ws2812b_encoding enc, uint32_t speed_hz, struct ws2812b_timing *t) {
+    const struct ws2812b_enc_info *e = ws2812b_enc_info(enc);
+    unsigned int l0, h0, t0, l1, h1, t1;
+    int32_t m[6];
+    double tb;
+
+    if (!e || ws2812b_pattern(e->zero, e->bits, &l0, &h0, &t0) ||
+        ws2812b_pattern(e->one, e->bits, &l1, &h1, &t1))
+        return -EINVAL;
+    if (!speed_hz)
+        speed_hz = e->speed_hz;
+    tb = 1e9 / speed_hz;
+
+    // 低电平一直延续到下一位的高电平开始
+    t->t0h_ns = lround(h0 * tb);
+    t->t1h_ns = lround(h1 * tb);
+    t->t0l_min_ns = lround((t0 + (l0 < l1 ? l0 : l1)) * tb);
+    t->t0l_max_ns = lround((t0 + (l0 > l1 ? l0 : l1)) * tb);
+    t->t1l_min_ns = lround((t1 + (l0 < l1 ? l0 : l1)) * tb);
+    t->t1l_max_ns = lround((t1 + (l0 > l1 ? l0 : l1)) * tb);
+    t->bit_ns = lround(e->bits * tb);
+
+    m[0] = ws2812b_margin(h0 * tb, WS2812B_T0H_NS);
+    m[1] = ws2812b_margin(h1 * tb, WS2812B_T1H_NS);
+    m[2] = ws2812b_margin((t0 + l0) * tb, WS2812B_T0L_NS);
+    m[3] = ws2812b_margin((t0 + l1) * tb, WS2812B_T0L_NS);
+    m[4] = ws2812b_margin((t1 + l0) * tb, WS2812B_T1L_NS);
+    m[5] = ws2812b_margin((t1 + l1) * tb, WS2812B_T1L_NS);
+    t->margin_ns = m[0];
+    for (int i = 1; i < 6; i++)
+        if (m[i] < t->margin_ns)
+            t->margin_ns = m[i];
+    return t->margin_ns < 0 ? -ERANGE : 0;
+}
+
+static int ws2812b_setup(struct ws2812b *s, const char *dev, unsigned int count,
+                         enum ws2812b_encoding enc, uint32_t speed_hz) {
+    const struct ws2812b_enc_info *e = ws2812b_enc_info(enc);
+    uint8_t mode = SPI_MODE_0;
+    uint8_t bits = 8;
+
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+    if (!e)
+        return -EINVAL;
+    s->count = count;
+    s->enc = enc;
+    s->bits = e->bits;
+    s->speed_hz = speed_hz ? speed_hz : e->speed_hz;
+    s->bytes_per_led = 3 * e->bits;
+    s->reset_bytes = ((uint64_t)s->speed_hz * WS2812B_RESET_US + 7999999) / 8000000;
+    s->tx_len = s->reset_bytes + (size_t)count * s->bytes_per_led + s->reset_bytes;
+    s->grb = calloc(count, 3);
+    s->tx = calloc(1, s->tx_len);
+    if (!count || !s->grb || !s->tx) {
+        ws2812b_close(s);
+        return -ENOMEM;
+    }
+
+    // 第一次commit编码并发送全黑帧，之后只编码变化的像素
+    ws2812b_lut_init(enc);
+    s->dirty_lo = 0;
+    s->dirty_hi = count;
+
+    if (!dev)
+        return 0;
+    if ((s->fd = open(dev, O_RDWR)) < 0 ||
+        ioctl(s->fd, SPI_IOC_WR_MODE, &mode) < 0 ||
+        ioctl(s->fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+        ioctl(s->fd, SPI_IOC_WR_MAX_SPEED_HZ, &s->speed_hz) < 0) {
+        int err = -errno;
+
+        ws2812b_close(s);
+        return err;
+    }
+    return 0;
+}
+
+int ws2812b_open(struct ws2812b *s, const char *dev, unsigned int count) {
+    return ws2812b_setup(s, dev, count, WS2812B_ENC_8BIT, 0);
+}
+
+int ws2812b_open_enc(struct ws2812b *s, const char *dev, unsigned int count,
+                     enum ws2812b_encoding enc, uint32_t speed_hz) {
+    struct ws2812b_timing t;
+    int ret;
+
+    if ((ret = ws2812b_check_timing(enc, speed_hz, &t)) < 0) {
+        memset(s, 0, sizeof(*s));
+        s->fd = -1;
+        return ret;
+    }
+    return ws2812b_setup(s, dev, count, enc, speed_hz);
+}
+
+void ws2812b_close(struct ws2812b *s) {
+    if (s->fd >= 0)
+        close(s->fd);
+    free(s->grb);
+    free(s->tx);
+    s->fd = -1;
+    s->grb = NULL;
+    s->tx = NULL;
+}
+
+void ws2812b_set(struct ws2812b *s, unsigned int idx, uint8_t r, uint8_t g, uint8_t b) {
+    uint8_t *p;
+
+    if (idx >= s->count)
+        return;
+    p = s->grb + idx * 3;
+    if (p[0] == g && p[1] == r && p[2] == b)
+        return;
+    p[0] = g;  // WS2812B使用GRB顺序
+    p[1] = r;
+    p[2] = b;
+    if (idx < s->dirty_lo || s->dirty_lo >= s->dirty_hi)
+        s->dirty_lo = idx;
+    if (idx + 1 > s->dirty_hi)
+        s->dirty_hi = idx + 1;
+}
+
+void ws2812b_fill(struct ws2812b *s, uint8_t r, uint8_t g, uint8_t b) {
+    for (unsigned int i = 0; i < s->count; i++)
+        ws2812b_set(s, i, r, g, b);
+}
+
+void ws2812b_clear(struct ws2812b *s) {
+    ws2812b_fill(s, 0, 0, 0);
+}
+
+static void ws2812b_encode(struct ws2812b *s, unsigned int lo, unsigned int hi) {
+    const uint8_t (*lut)[8] = ws2812b_lut[s->enc];
+    const uint8_t *src = s->grb + lo * 3, *end = s->grb + hi * 3;
+    uint8_t *dst = s->tx + s->reset_bytes + (size_t)lo * s->bytes_per_led;
+
+    // 拷贝长度写成常数，每个颜色字节一次定长存储
+    switch (s->bits) {
+    case 3:
+        for (; src < end; dst += 3)
+            memcpy(dst, lut[*src++], 3);
+        break;
+    case 4:
+        for (; src < end; dst += 4)
+            memcpy(dst, lut[*src++], 4);
+        break;
+    default:
+        for (; src < end; dst += 8)
+            memcpy(dst, lut[*src++], 8);
+        break;
+    }
+}
+
+static int ws2812b_transfer(struct ws2812b *s) {
+    struct spi_ioc_transfer tr;
+
+    if (s->fd < 0) {
+        s->commits++;
+        return 0;
+    }
+    memset(&tr, 0, sizeof(tr));
+    tr.tx_buf = (uintptr_t)s->tx;
+    tr.len = s->tx_len;
+    tr.speed_hz = s->speed_hz;
+    tr.bits_per_word = 8;
+    if (ioctl(s->fd, SPI_IOC_MESSAGE(1), &tr) < 0)
+        return -errno;
+    s->commits++;
+    return 0;
+}
+
+int ws2812b_commit(struct ws2812b *s) {
+    unsigned int lo = s->dirty_lo, hi = s->dirty_hi;
+    int ret;
+
+    if (lo >= hi) {
+        s->skipped++;
+        return 0;
+    }
+    ws2812b_encode(s, lo, hi);
+    s->dirty_lo = s->count;
+    s->dirty_hi = 0;
+
+    // 发送失败时保留改动区间，下次commit重发
+    if ((ret = ws2812b_transfer(s)) < 0) {
+        s->dirty_lo = lo;
+        s->dirty_hi = hi;
+        return ret;
+    }
+    return 1;
+}
+
+int ws2812b_refresh(struct ws2812b *s) {
+    int ret = ws2812b_commit(s);
+
+    if (ret == 0) {
+        s->skipped--;
+        ret = ws2812b_transfer(s);
+    }
+    return ret < 0 ? ret : 1;
+}
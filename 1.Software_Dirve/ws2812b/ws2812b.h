@@ -0,0 +1,113 @@
+/*
+ * WS2812B 灯带帧缓冲(用户态，spidev)
+ *
+ * 用法：ws2812b_set/fill/clear 任意修改像素，最后 ws2812b_commit 一次，
+ * 整条灯带作为一个 SPI_IOC_MESSAGE 传输发出。没有像素变化时commit直接返回，
+ * 不占用总线。
+ *
+ * 编码：每个WS2812B位用n个SPI位表示，一个颜色字节展开成n个SPI字节，
+ * 查256项的表，一次拷贝n字节；只重新编码上次commit之后改动过的像素区间，
+ * 其余沿用发送缓冲里的数据。
+ *
+ *   编码   SPI时钟   '0'      '1'      字节/LED  300LED帧长
+ *   8位    8MHz      0x60     0x7C     24        7.2ms
+ *   4位    3.2MHz    1000     1110     12        9.0ms
+ *   3位    2.4MHz    100      110      9         9.0ms
+ *
+ * 8位编码每位只有1us，T1H 625ns 比数据手册下限650ns短25ns，现有灯带实测
+ * 可用，保留为 ws2812b_open 的默认编码。3位/4位编码每位1.25us，各项时间都在
+ * 数据手册容差内，总线数据量和缓冲内存只有8位编码的3/8和1/2，同样的spidev
+ * 消息长度能带更多LED，SPI时钟低，对走线和电平转换的要求也低。
+ * 帧长由WS2812B协议决定(每位1.25us)，不会因为编码更紧凑而缩短。
+ * ws2812b_open_enc 打开前先按实际SPI时钟检查时序。
+ *
+ * spidev 单个消息的长度受模块参数 bufsiz 限制(默认4096字节，8位编码约160个LED，
+ * 3位编码约450个LED)，更长的灯带需要在内核命令行加 spidev.bufsiz=65536，
+ * 否则commit返回EMSGSIZE。
+ *
+ * 编译：
+ *   riscv64-buildroot-linux-gnu-gcc -O2 -o ws2812b_demo main.c ws2812b.c -lm
+ */
+#ifndef __WS2812B_H
+#define __WS2812B_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 帧前后的低电平，大于50us的复位时间 */
+#define WS2812B_RESET_US        64
+
+/* 数据手册时序，各项容差 ±150ns */
+#define WS2812B_T0H_NS          400
+#define WS2812B_T1H_NS          800
+#define WS2812B_T0L_NS          850
+#define WS2812B_T1L_NS          450
+#define WS2812B_TOL_NS          150
+
+enum ws2812b_encoding {
+    WS2812B_ENC_8BIT,
+    WS2812B_ENC_4BIT,
+    WS2812B_ENC_3BIT,
+    WS2812B_ENC_COUNT,
+};
+
+struct ws2812b_enc_info {
+    const char *name;
+    unsigned int bits;          /* 每个WS2812B位的SPI位数，也是每个颜色字节的SPI字节数 */
+    uint8_t zero, one;          /* 低bits位有效，高位先发 */
+    uint32_t speed_hz;          /* 标称SPI时钟 */
+};
+
+const struct ws2812b_enc_info *ws2812b_enc_info(enum ws2812b_encoding enc);
+
+/*
+ * 在 speed_hz 下各项时间的实际范围。低电平时间包含下一位开头的低电平，
+ * 下一位是0或1时可能不同，所以是范围
+ */
+struct ws2812b_timing {
+    uint32_t t0h_ns, t1h_ns;
+    uint32_t t0l_min_ns, t0l_max_ns;
+    uint32_t t1l_min_ns, t1l_max_ns;
+    uint32_t bit_ns;
+    int32_t margin_ns;          /* 离容差边界最近的距离，负数为超出 */
+};
+
+/* 都在容差内返回0，否则返回-ERANGE；speed_hz 为0时用标称时钟 */
+int ws2812b_check_timing(enum ws2812b_encoding enc, uint32_t speed_hz, struct ws2812b_timing *t);
+
+struct ws2812b {
+    int fd;
+    unsigned int count;
+    enum ws2812b_encoding enc;
+    unsigned int bits;
+    uint32_t speed_hz;
+    size_t bytes_per_led;
+    size_t reset_bytes;
+    uint8_t *grb;               /* 帧缓冲，每个LED按G、R、B顺序3字节 */
+    uint8_t *tx;                /* 复位 + count*bytes_per_led + 复位，常驻 */
+    size_t tx_len;
+    unsigned int dirty_lo;      /* 待编码像素区间 [dirty_lo, dirty_hi)，空区间表示没有改动 */
+    unsigned int dirty_hi;
+    unsigned int commits;       /* 实际发出的帧数 */
+    unsigned int skipped;       /* 没有改动而跳过的commit次数 */
+};
+
+/* 打开并配置spidev，8位编码；dev 为NULL时只建缓冲不发送(测试编码用) */
+int ws2812b_open(struct ws2812b *s, const char *dev, unsigned int count);
+/*
+ * 指定编码和SPI时钟(0为标称值)，时序超出数据手册容差时返回-ERANGE。
+ * 控制器实际分频得到的时钟可能低于请求值，这时按实际时钟传入再检查
+ */
+int ws2812b_open_enc(struct ws2812b *s, const char *dev, unsigned int count,
+                     enum ws2812b_encoding enc, uint32_t speed_hz);
+void ws2812b_close(struct ws2812b *s);
+
+void ws2812b_set(struct ws2812b *s, unsigned int idx, uint8_t r, uint8_t g, uint8_t b);
+void ws2812b_fill(struct ws2812b *s, uint8_t r, uint8_t g, uint8_t b);
+void ws2812b_clear(struct ws2812b *s);
+/* 有改动时编码改动区间并整帧发送一次，返回1；没有改动返回0；出错返回负errno */
+int ws2812b_commit(struct ws2812b *s);
+/* 不管有没有改动都重发整帧，比如灯带重新上电后 */
+int ws2812b_refresh(struct ws2812b *s);
+
+#endif /* __WS2812B_H */